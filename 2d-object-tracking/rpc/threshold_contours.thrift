@@ -29,12 +29,26 @@ struct Particle {
   2: Rect pose
 }
 
+struct StageTiming {
+  1: i64 count,
+  2: double meanDuration,
+  3: double minDuration,
+  4: double maxDuration,
+  5: list<i64> histogram
+}
+
+exception InvalidArgument {
+  1: string message
+}
+
 
 service ThresholdContours {
 
   void initThresholdProcessor(1: list<Threshold> thresholds)
+    throws (1: InvalidArgument error)
   list<list<Rect>> getThresholdRects()
   void initTarget(1: Target targetData)
   list<double> computeDistance(1: list<Target> targets,
                                2: list<Particle> particles)
+  map<string, StageTiming> getStageTimings()
 }
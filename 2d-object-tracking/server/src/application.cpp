@@ -19,6 +19,7 @@
 
 #include <glipf/sources/v4l2-camera.h>
 #include <glipf/sources/opencv-video-source.h>
+#include <glipf/utils/server-config.h>
 
 #include "threshold-contours-handler.h"
 
@@ -26,6 +27,8 @@
 using glipf::sources::FrameSource;
 using glipf::sources::OpenCvVideoSource;
 using glipf::sources::V4L2Camera;
+using glipf::utils::readCaptureResolution;
+using glipf::utils::readMorphologyConfig;
 
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
@@ -46,12 +49,14 @@ int main() {
   boost::property_tree::read_json(ifs, config);
   vector<GLfloat> intrinsicsData, extrinsicsData;
   boost::optional<string> videoFileName = config.get_optional<string>("videoFile");
+  bool useGpuComponentExtraction =
+      config.get<string>("componentExtraction", "contours") == "gpu";
   std::unique_ptr<FrameSource> frameSource;
 
   if (videoFileName)
     frameSource.reset(new OpenCvVideoSource(*videoFileName));
   else
-    frameSource.reset(new V4L2Camera(std::make_pair(640, 480)));
+    frameSource.reset(new V4L2Camera(readCaptureResolution(config)));
 
   for (auto& val : config.get_child("intrinsics"))
     intrinsicsData.push_back(val.second.get_value<GLfloat>());
@@ -72,7 +77,9 @@ int main() {
 
   // Configure and start Thrift RPC server
   boost::shared_ptr<ThresholdContoursHandler> handler(new ThresholdContoursHandler(std::move(frameSource),
-                                                                                   expandedProjectionMatrix));
+                                                                                   expandedProjectionMatrix,
+                                                                                   readMorphologyConfig(config),
+                                                                                   useGpuComponentExtraction));
   boost::shared_ptr<TProcessor> processor(new glipf::ThresholdContoursProcessor(handler));
   boost::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
 
@@ -6,9 +6,14 @@
 #include <opencv2/opencv.hpp>
 
 
+using glipf::processors::ConnectedComponentsProcessor;
 using glipf::processors::ForegroundHistogramProcessor;
 using glipf::processors::GlesProcessor;
+using glipf::processors::getNumbers;
+using glipf::processors::MaskPackingProcessor;
 using glipf::processors::ModelDebugProcessor;
+using glipf::processors::MorphologyProcessor;
+using glipf::processors::MultiThresholdProcessor;
 using glipf::processors::ProcessingResultSet;
 using glipf::sinks::DisplaySink;
 using glipf::sources::FrameSource;
@@ -17,6 +22,10 @@ using std::unique_ptr;
 using std::vector;
 
 
+// Thresholded areas smaller than this many pixels are ignored
+constexpr float kMinRectArea = 1000.0f;
+
+
 GlesProcessor::ModelData generateRectModel(const cv::Rect& rect) {
   float x = rect.x, y = rect.y;
 
@@ -52,8 +61,12 @@ GlesProcessor::ModelData generateWireframeModel(const cv::Rect& rect) {
 
 
 ThresholdContoursHandler::ThresholdContoursHandler(unique_ptr<FrameSource> frameSource,
-                                                   const glm::mat4& mvpMatrix)
+                                                   const glm::mat4& mvpMatrix,
+                                                   const MorphologyConfig& morphologyConfig,
+                                                   bool useGpuComponentExtraction)
   : mProjectionMatrix(mvpMatrix)
+  , mMorphologyConfig(morphologyConfig)
+  , mUseGpuComponentExtraction(useGpuComponentExtraction)
   , mFrameTextureContainer(frameSource->getFrameProperties().dimensions())
   , mThresholdedTexture(0)
   , mFrameSource(std::move(frameSource))
@@ -61,17 +74,51 @@ ThresholdContoursHandler::ThresholdContoursHandler(unique_ptr<FrameSource> frame
 }
 
 void ThresholdContoursHandler::initThresholdProcessor(const vector<glipf::Threshold>& thresholds) {
+  // Every threshold has a bit of its own in the 8-bit alpha mask
+  if (thresholds.empty() ||
+      thresholds.size() > MultiThresholdProcessor::kMaxThresholdCount)
+  {
+    glipf::InvalidArgument error;
+    error.message = "Between 1 and " +
+                    std::to_string(MultiThresholdProcessor::kMaxThresholdCount) +
+                    " thresholds are supported, got " +
+                    std::to_string(thresholds.size());
+    throw error;
+  }
+
   // Drop the first batch of frames to let the camera image settle
   for (size_t i = 0; i < 15; ++i)
     mFrameSource->grabFrame();
 
+  vector<MultiThresholdProcessor::HsvRange> hsvRanges;
+
   for (auto& threshold : thresholds) {
     glm::vec3 lowerThreshold(threshold.lower.h, threshold.lower.s,
                              threshold.lower.v);
     glm::vec3 upperThreshold(threshold.upper.h, threshold.upper.s,
                              threshold.upper.v);
-    mThresholdProcessors.emplace_back(mFrameSource->getFrameProperties(),
-                                      lowerThreshold, upperThreshold);
+    hsvRanges.emplace_back(lowerThreshold, upperThreshold);
+  }
+
+  // All colours are thresholded in a single pass, each setting its own
+  // bit of the alpha mask
+  mThresholdProcessor.reset(
+      new MultiThresholdProcessor(mFrameSource->getFrameProperties(),
+                                  hsvRanges));
+
+  if (mMorphologyConfig.isEnabled) {
+    mMorphologyProcessor.reset(
+        new MorphologyProcessor(mFrameSource->getFrameProperties(),
+                                mMorphologyConfig.operation,
+                                mMorphologyConfig.kernelRadius, true));
+  }
+
+  if (mUseGpuComponentExtraction) {
+    mConnectedComponentsProcessor.reset(
+        new ConnectedComponentsProcessor(mFrameSource->getFrameProperties()));
+  } else {
+    mMaskPackingProcessor.reset(
+        new MaskPackingProcessor(mFrameSource->getFrameProperties()));
   }
 
   mDisplaySink.reset(new DisplaySink(mGlesContext.nativeWindowDimensions().first,
@@ -84,45 +131,94 @@ void ThresholdContoursHandler::initThresholdProcessor(const vector<glipf::Thresh
 }
 
 
-void ThresholdContoursHandler::getThresholdRects(vector<vector<glipf::Rect> >& result) {
-  mFrameTextureContainer.uploadData(mFrameSource->grabFrame());
+const ProcessingResultSet& ThresholdContoursHandler::processThreshold() {
+  const auto& resultSet =
+      mThresholdProcessor->process(mFrameTextureContainer.getTexture());
+  mThresholdedTexture = boost::get<GLuint>(resultSet.at("thresholded_texture"));
 
-  ProcessingResultSet combinedResultSet;
-  vector<GlesProcessor::ModelData> models;
+  if (!mMorphologyProcessor)
+    return resultSet;
+
+  // Clean up the thresholded mask; the morphology FBO stays bound for
+  // any readback that follows
+  const auto& morphologyResultSet =
+      mMorphologyProcessor->process(mThresholdedTexture);
+  mThresholdedTexture =
+      boost::get<GLuint>(morphologyResultSet.at("morphology_texture"));
+
+  return morphologyResultSet;
+}
+
+
+vector<vector<cv::Rect>> ThresholdContoursHandler::findThresholdRects() {
+  size_t thresholdCount = mThresholdProcessor->thresholdCount();
+  vector<vector<cv::Rect>> rects(thresholdCount);
 
-  for (auto& processor : mThresholdProcessors) {
-    const auto& resultSet =
-        processor.process(mFrameTextureContainer.getTexture());
-    combinedResultSet.insert(std::begin(resultSet), std::end(resultSet));
-    mThresholdedTexture = boost::get<GLuint>(resultSet.at("thresholded_texture"));
+  if (mConnectedComponentsProcessor) {
+    for (size_t i = 0; i < thresholdCount; ++i) {
+      mConnectedComponentsProcessor->setMaskBit(i);
+      const auto& resultSet =
+          mConnectedComponentsProcessor->process(mThresholdedTexture);
+      const auto& components =
+          getNumbers(resultSet.at("components"));
 
-    size_t fboWidth = mFrameSource->getFrameProperties().dimensions().first;
-    size_t fboHeight = mFrameSource->getFrameProperties().dimensions().second;
+      for (size_t j = 0; j < components.size(); j += 5) {
+        if (components[j + 4] < kMinRectArea)
+          continue;
 
-    GLubyte pixelData[fboWidth * fboHeight * 4];
-    glReadPixels(0, 0, fboWidth, fboHeight, GL_RGBA, GL_UNSIGNED_BYTE,
-                 pixelData);
+        rects[i].emplace_back(components[j], components[j + 1],
+                              components[j + 2], components[j + 3]);
+      }
+    }
+
+    return rects;
+  }
 
-    cv::Mat image(fboHeight, fboWidth, CV_8UC4, pixelData);
-    cv::Mat alpha(image.rows, image.cols, CV_8UC1);
-    int channelMapping[] = { 3, 0 };
-    mixChannels(&image, 1, &alpha, 1, channelMapping, 1);
+  // Fall back to finding contours on the CPU, reading back each
+  // colour's mask at one bit per pixel
+  for (size_t i = 0; i < thresholdCount; ++i) {
+    mMaskPackingProcessor->setMaskBit(i);
+    mMaskPackingProcessor->process(mThresholdedTexture);
+
+    glipf::utils::Profiler::Span contoursSpan(
+        glipf::utils::Profiler::defaultProfiler(), "threshold_rects.contours");
+    cv::Mat mask;
+    mMaskPackingProcessor->unpackMask(mask);
 
     vector< vector<cv::Point> > contours;
     vector<cv::Vec4i> hierarchy;
-    findContours(alpha, contours, hierarchy, CV_RETR_EXTERNAL,
+    findContours(mask, contours, hierarchy, CV_RETR_EXTERNAL,
                  CV_CHAIN_APPROX_SIMPLE);
 
-    result.emplace_back();
-    vector<glipf::Rect>& thresholdResult = result.back();
-
     for (auto& points : contours) {
       double contArea = contourArea(points);
 
-      if (contArea < 1000.0)
+      if (contArea < kMinRectArea)
         continue;
 
-      cv::Rect rect = boundingRect(points);
+      rects[i].push_back(boundingRect(points));
+    }
+  }
+
+  return rects;
+}
+
+
+void ThresholdContoursHandler::getThresholdRects(vector<vector<glipf::Rect> >& result) {
+  mFrameTextureContainer.uploadData(mFrameSource->grabFrame());
+
+  ProcessingResultSet combinedResultSet;
+  vector<GlesProcessor::ModelData> models;
+
+  const auto& thresholdResultSet = processThreshold();
+  combinedResultSet.insert(std::begin(thresholdResultSet),
+                           std::end(thresholdResultSet));
+
+  for (auto& thresholdRects : findThresholdRects()) {
+    result.emplace_back();
+    vector<glipf::Rect>& thresholdResult = result.back();
+
+    for (auto& rect : thresholdRects) {
       models.push_back(generateRectModel(rect));
 
       thresholdResult.emplace_back();
@@ -158,9 +254,9 @@ void ThresholdContoursHandler::initTarget(const glipf::Target& targetData) {
       mForegroundHistogramProcessor->process(mThresholdedTexture);
 
   mTargetHistograms[targetData.id] =
-      boost::get<vector<float>>(resultSet.at("0"));
+      getNumbers(resultSet.at("0"));
   float pixelCount =
-      boost::get<vector<float>>(resultSet.at("total_pixel_counts"))[0];
+      getNumbers(resultSet.at("total_pixel_counts"))[0];
   float targetArea = targetData.pose.w * targetData.pose.h;
   mTargetCoverage[targetData.id] = pixelCount / targetArea;
 
@@ -207,12 +303,9 @@ void ThresholdContoursHandler::computeDistance(vector<double>& result,
   mFrameTextureContainer.uploadData(mFrameSource->grabFrame());
   ProcessingResultSet combinedResultSet;
 
-  for (auto& processor : mThresholdProcessors) {
-    const auto& resultSet =
-        processor.process(mFrameTextureContainer.getTexture());
-    mThresholdedTexture = boost::get<GLuint>(resultSet.at("thresholded_texture"));
-    combinedResultSet.insert(std::begin(resultSet), std::end(resultSet));
-  }
+  const auto& thresholdResultSet = processThreshold();
+  combinedResultSet.insert(std::begin(thresholdResultSet),
+                           std::end(thresholdResultSet));
 
   vector<GlesProcessor::ModelData> models;
   vector<uint_fast8_t> modelGroups;
@@ -228,7 +321,7 @@ void ThresholdContoursHandler::computeDistance(vector<double>& result,
   mForegroundHistogramProcessor->setModels(models, mProjectionMatrix);
   const auto& resultSet = mForegroundHistogramProcessor->process(mThresholdedTexture);
   const auto& totalPixelCounts =
-      boost::get<vector<float>>(resultSet.at("total_pixel_counts"));
+      getNumbers(resultSet.at("total_pixel_counts"));
   size_t i = 0;
 
   for (auto& particle : particles) {
@@ -246,7 +339,7 @@ void ThresholdContoursHandler::computeDistance(vector<double>& result,
 
     auto histKey = std::to_string(i++);
     auto& refHist = mTargetHistograms.at(particle.id);
-    auto& hist = boost::get<vector<float>>(resultSet.at(histKey));
+    auto& hist = getNumbers(resultSet.at(histKey));
     auto bhattDist = computeBhattDist(refHist, hist);
     bhattDist *= 1 - coverageDiffPercentage;
 
@@ -273,3 +366,21 @@ void ThresholdContoursHandler::computeDistance(vector<double>& result,
   mDisplaySink->send(combinedResultSet);
   mGlesContext.swapBuffers();
 }
+
+
+void ThresholdContoursHandler::getStageTimings(std::map<std::string, glipf::StageTiming>& result) {
+  const auto& histograms =
+      glipf::utils::Profiler::defaultProfiler().histograms();
+
+  for (const auto& stageHistogram : histograms) {
+    const auto& histogram = stageHistogram.second;
+    glipf::StageTiming& timing = result[stageHistogram.first];
+
+    timing.count = histogram.count();
+    timing.meanDuration = histogram.meanDuration();
+    timing.minDuration = histogram.minDuration();
+    timing.maxDuration = histogram.maxDuration();
+    timing.histogram.assign(std::begin(histogram.buckets()),
+                            std::end(histogram.buckets()));
+  }
+}
@@ -3,19 +3,29 @@
 
 #include <glipf/gles-utils/gles-context.h>
 #include <glipf/gles-utils/texture-container.h>
+#include <glipf/processors/connected-components-processor.h>
 #include <glipf/processors/foreground-histogram-processor.h>
+#include <glipf/processors/mask-packing-processor.h>
 #include <glipf/processors/model-debug-processor.h>
-#include <glipf/processors/threshold-processor.h>
+#include <glipf/processors/morphology-processor.h>
+#include <glipf/processors/multi-threshold-processor.h>
 #include <glipf/sinks/display-sink.h>
 #include <glipf/sources/frame-source.h>
+#include <glipf/utils/server-config.h>
 #include "thrift-gen-cpp/threshold-contours/ThresholdContours.h"
 
+#include <opencv2/opencv.hpp>
+
 
 
 class ThresholdContoursHandler : virtual public glipf::ThresholdContoursIf {
 public:
+  using MorphologyConfig = glipf::utils::MorphologyConfig;
+
   ThresholdContoursHandler(std::unique_ptr<glipf::sources::FrameSource> frameSource,
-                           const glm::mat4& mvpMatrix);
+                           const glm::mat4& mvpMatrix,
+                           const MorphologyConfig& morphologyConfig,
+                           bool useGpuComponentExtraction);
 
   void initThresholdProcessor(const std::vector<glipf::Threshold>& thresholds) override;
   void getThresholdRects(std::vector<std::vector<glipf::Rect> >& result) override;
@@ -23,20 +33,28 @@ public:
   void computeDistance(std::vector<double>& result,
                        const std::vector<glipf::Target>& targets,
                        const std::vector<glipf::Particle>& particles) override;
+  void getStageTimings(std::map<std::string, glipf::StageTiming>& result) override;
 
 private:
   double computeBhattDist(const std::vector<float>& refHist,
                           const std::vector<float>& hist);
+  const glipf::processors::ProcessingResultSet& processThreshold();
+  std::vector<std::vector<cv::Rect>> findThresholdRects();
 
   glipf::gles_utils::GlesContext mGlesContext;
   glm::mat4 mProjectionMatrix;
+  MorphologyConfig mMorphologyConfig;
+  bool mUseGpuComponentExtraction;
   glipf::gles_utils::TextureContainer mFrameTextureContainer;
   GLuint mThresholdedTexture;
   std::unique_ptr<glipf::sources::FrameSource> mFrameSource;
   std::unique_ptr<glipf::sinks::DisplaySink> mDisplaySink;
   std::unique_ptr<glipf::processors::ForegroundHistogramProcessor> mForegroundHistogramProcessor;
   std::unique_ptr<glipf::processors::ModelDebugProcessor> mModelDebugProcessor;
-  std::vector<glipf::processors::ThresholdProcessor> mThresholdProcessors;
+  std::unique_ptr<glipf::processors::MorphologyProcessor> mMorphologyProcessor;
+  std::unique_ptr<glipf::processors::ConnectedComponentsProcessor> mConnectedComponentsProcessor;
+  std::unique_ptr<glipf::processors::MaskPackingProcessor> mMaskPackingProcessor;
+  std::unique_ptr<glipf::processors::MultiThresholdProcessor> mThresholdProcessor;
   std::map<int32_t, std::vector<float>> mTargetHistograms;
   std::map<int32_t, float> mTargetCoverage;
 };
@@ -0,0 +1,159 @@
+#include <bcm_host.h>
+
+#include <boost/variant/get.hpp>
+
+#include <glipf/gles-utils/frame-batch.h>
+#include <glipf/gles-utils/gles-context.h>
+#include <glipf/processors/background-subtraction-processor.h>
+#include <glipf/sources/opencv-video-source.h>
+#include <glipf/utils/profiler.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+using glipf::gles_utils::FrameBatch;
+using glipf::gles_utils::GlesContext;
+using glipf::processors::BackgroundSubtractionProcessor;
+using glipf::sources::FrameProperties;
+using glipf::sources::OpenCvVideoSource;
+using glipf::utils::Profiler;
+
+using std::vector;
+
+
+// Number of pipelines, each with a context of its own, that batches are
+// handed to in turn
+static const size_t kPipelineCount = 2;
+
+
+/**
+ * Context, batch and processor handling every kPipelineCount-th batch.
+ * Members are declared in the order they have to be created in, so that
+ * they're destroyed in reverse.
+ */
+struct Pipeline {
+  Pipeline(const FrameProperties& frameProperties, size_t frameCount,
+           const void* referenceFrameData)
+    // Processors render into FBOs of their own, so the surface is never
+    // drawn to
+    : context(GlesContext::Dimensions(1, 1))
+    , batch(frameProperties, frameCount)
+  {
+    // Every tile is compared with the same reference frame
+    for (size_t i = 0; i < batch.frameCount(); ++i)
+      batch.uploadFrame(i, referenceFrameData);
+
+    processor.reset(
+        new BackgroundSubtractionProcessor(batch.getFrameProperties(),
+                                           nullptr));
+    processor->setReferenceFrame(batch.getTexture());
+  }
+
+  ~Pipeline() {
+    // GL objects of the batch and the processor belong to this context
+    context.makeCurrent();
+  }
+
+  GlesContext context;
+  FrameBatch batch;
+  std::unique_ptr<BackgroundSubtractionProcessor> processor;
+};
+
+
+float foregroundFraction(const vector<uint8_t>& pixels,
+                         const FrameBatch& batch, size_t index,
+                         const FrameProperties& frameProperties)
+{
+  size_t batchWidth = batch.getFrameProperties().dimensions().first;
+  size_t frameWidth = frameProperties.dimensions().first;
+  size_t frameHeight = frameProperties.dimensions().second;
+  std::pair<size_t, size_t> origin = batch.tileOrigin(index);
+  size_t foregroundPixelCount = 0;
+
+  // Background pixels are cleared to transparent black
+  for (size_t y = origin.second; y < origin.second + frameHeight; ++y) {
+    for (size_t x = origin.first; x < origin.first + frameWidth; ++x) {
+      if (pixels[(y * batchWidth + x) * 4 + 3] != 0)
+        ++foregroundPixelCount;
+    }
+  }
+
+  return float(foregroundPixelCount) / (frameWidth * frameHeight);
+}
+
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " VIDEO_FILE [FRAMES_PER_BATCH]\n";
+    return 1;
+  }
+
+  bcm_host_init();
+
+  OpenCvVideoSource frameSource(argv[1]);
+  size_t batchFrameCount = argc > 2 ? std::stoul(argv[2]) : 4;
+  const FrameProperties& frameProperties = frameSource.getFrameProperties();
+
+  // The first frame is the background; it's copied as the source
+  // reuses its buffer
+  const uint8_t* frameData = frameSource.grabFrame();
+
+  if (!frameData) {
+    std::cerr << "No frames to process in `" << argv[1] << "`\n";
+    return 1;
+  }
+
+  vector<uint8_t> referenceFrame(frameData,
+                                 frameData + frameProperties.dimensions().first *
+                                             frameProperties.dimensions().second * 3);
+  vector<std::unique_ptr<Pipeline>> pipelines;
+
+  for (size_t i = 0; i < kPipelineCount; ++i) {
+    pipelines.emplace_back(new Pipeline(frameProperties, batchFrameCount,
+                                        referenceFrame.data()));
+  }
+
+  size_t frameNumber = 1;
+
+  for (size_t batchNumber = 0; ; ++batchNumber) {
+    Pipeline& pipeline = *pipelines[batchNumber % pipelines.size()];
+    pipeline.context.makeCurrent();
+
+    size_t frameCount = pipeline.batch.uploadFrames(frameSource);
+
+    if (frameCount == 0)
+      break;
+
+    const auto& resultSet =
+        pipeline.processor->process(pipeline.batch.getTexture());
+    const auto& pixels = pipeline.batch.readBack(
+        boost::get<GLuint>(resultSet.at("foreground_texture")));
+
+    // The tiles past the end of a partial batch hold older frames
+    for (size_t i = 0; i < frameCount; ++i, ++frameNumber) {
+      std::cout << "frame " << frameNumber << ": "
+                << 100.0f * foregroundFraction(pixels, pipeline.batch, i,
+                                               frameProperties)
+                << "% foreground\n";
+    }
+
+    if (frameCount < pipeline.batch.frameCount())
+      break;
+  }
+
+  // Every context has a profiler of its own
+  for (size_t i = 0; i < pipelines.size(); ++i) {
+    pipelines[i]->context.makeCurrent();
+
+    for (const auto& stageHistogram : Profiler::defaultProfiler().histograms()) {
+      std::cout << "pipeline " << i << " " << stageHistogram.first << ": "
+                << stageHistogram.second.count() << " x "
+                << stageHistogram.second.meanDuration() * 1000.0f << " ms\n";
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef gles_utils_fragment_stage_h
+#define gles_utils_fragment_stage_h
+
+#include <GLES2/gl2.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace glipf {
+namespace gles_utils {
+
+/**
+ * @brief Per-pixel body of a full-screen pass that can be chained with
+ *        other stages in a single fragment shader.
+ *
+ * The source file defines `bool <functionName>(inout vec4 color,
+ * in vec2 tcoord)`, which transforms the color of a pixel and returns
+ * false if the pixel should be discarded. Stage sources must not
+ * declare `tcoord` or `tex`; the generated shader does that itself.
+ */
+struct FragmentStage {
+  std::string functionName;
+  std::string sourceFile;
+  /// Include files the stage depends on; shared includes are added once
+  std::vector<std::string> includeFiles;
+  /// `#define` lines scoped to the stage's source
+  std::string defines;
+  /// Result key under which the stage's output is published
+  std::string outputKey;
+  /// Sampler uniform names and the textures bound to them
+  std::vector<std::pair<std::string, GLuint>> textures;
+  /// Set the stage's (non-sampler) uniforms on a linked program in
+  /// use; it captures copies of its values, as stages may outlive the
+  /// processors they were taken from
+  std::function<void(GLuint glslProgram)> setupUniforms;
+  /// True if the stage samples `tex` itself at other coordinates than
+  /// `tcoord`, which only gives the expected result as the first stage
+  bool resamplesInput = false;
+};
+
+} // end namespace gles_utils
+} // end namespace glipf
+
+#endif // gles_utils_fragment_stage_h
@@ -0,0 +1,79 @@
+#ifndef gles_utils_frame_batch_h
+#define gles_utils_frame_batch_h
+
+#include "../sources/frame-properties.h"
+#include "../sources/frame-source.h"
+#include "../utils/profiler.h"
+
+#include <GLES2/gl2.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+namespace glipf {
+namespace gles_utils {
+
+/**
+ * @brief Texture holding several frames side by side, for offline
+ *        processing at high throughput.
+ *
+ * Frames are uploaded into the tiles of one texture. Processors set up
+ * with getFrameProperties() then handle the whole batch with every draw,
+ * and their results are read back once per batch instead of once per
+ * frame. This only gives correct results for processors treating every
+ * pixel on its own (thresholds, colour space conversions, reference
+ * background subtraction and fused stages of these); background models
+ * depend on the previous frame, and neighbourhood operations would mix
+ * up adjacent tiles.
+ *
+ * Processors keep a reference to the batch's frame properties, so the
+ * batch must outlive them.
+ */
+class FrameBatch {
+public:
+  FrameBatch(const sources::FrameProperties& frameProperties,
+             size_t frameCount);
+  FrameBatch(const FrameBatch&) = delete;
+  FrameBatch& operator=(const FrameBatch&) = delete;
+  ~FrameBatch();
+
+  /// Upload a frame into a tile of the batch.
+  void uploadFrame(size_t index, const void* frameData);
+  /**
+   * Grab frames from a source until the batch is full or the source
+   * runs out, and return the number of frames uploaded.
+   */
+  size_t uploadFrames(sources::FrameSource& frameSource);
+  /**
+   * Read back a texture with the batch's dimensions, e.g. the result of
+   * a processor, with a single glReadPixels call. The returned RGBA
+   * pixels stay valid until the next read back.
+   */
+  const std::vector<uint8_t>& readBack(GLuint texture);
+
+  GLuint getTexture() const;
+  /// Properties of the whole batch texture
+  const sources::FrameProperties& getFrameProperties() const;
+  size_t frameCount() const;
+  /// Bottom left pixel of a frame's tile in the batch texture
+  std::pair<size_t, size_t> tileOrigin(size_t index) const;
+  void setProfiler(utils::Profiler& profiler);
+
+protected:
+  std::pair<size_t, size_t> mFrameDimensions;
+  size_t mFrameCount;
+  size_t mColumnCount;
+  sources::FrameProperties mBatchFrameProperties;
+  GLuint mTexture;
+  GLuint mReadBackFbo;
+  std::vector<uint8_t> mReadBackPixels;
+  utils::Profiler* mProfiler;
+};
+
+} // end namespace gles_utils
+} // end namespace glipf
+
+#endif // gles_utils_frame_batch_h
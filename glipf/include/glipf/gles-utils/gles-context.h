@@ -13,21 +13,57 @@
 namespace glipf {
 namespace gles_utils {
 
+/**
+ * @brief EGL context rendering to the screen or to an offscreen surface.
+ *
+ * If built with GLIPF_GLES3, a GLES 3 context is created where the
+ * driver offers one, and a GLES 2 context otherwise.
+ *
+ * Several contexts can live in one process, e.g. one per pipeline in an
+ * offline run; the GL calls of each pipeline must be made while its
+ * context is current. Render target pools, program caches and profilers
+ * returned by RenderTargetPool::defaultPool(),
+ * GlslProgramCache::defaultCache() and utils::Profiler::defaultProfiler()
+ * belong to the current context and are released with it, so all
+ * processors using a context must be destroyed before it.
+ */
 class GlesContext {
 public:
   using Dimensions = std::pair<uint_fast16_t, uint_fast16_t>;
 
+  /// Create a context rendering to a full-screen dispmanx window.
   GlesContext();
+  /// Create a context rendering to an offscreen pbuffer surface.
+  explicit GlesContext(Dimensions surfaceDimensions);
+  GlesContext(const GlesContext&) = delete;
+  GlesContext& operator=(const GlesContext&) = delete;
+  ~GlesContext();
 
   Dimensions nativeWindowDimensions() const;
   bool swapBuffers();
+  /// Make the context current on the calling thread.
+  void makeCurrent();
+  /// Return the major GLES version the context was created with.
+  EGLint clientVersion() const;
+
+  /**
+   * Return the major GLES version of the current context, so that code
+   * without access to the context can pick GLES 3 paths at runtime.
+   */
+  static int currentClientVersion();
 
 protected:
+  EGLConfig createContext(EGLint surfaceType);
+  bool tryCreateContext(EGLint surfaceType, EGLint clientVersion,
+                        EGLConfig& config);
+  void initializeSurface();
+
   Dimensions mDimensions;
   EGLDisplay mDisplay;
   EGL_DISPMANX_WINDOW_T mNativeWindow;
   EGLSurface mSurface;
   EGLContext mContext;
+  EGLint mClientVersion;
 };
 
 } // end namespace gles_utils
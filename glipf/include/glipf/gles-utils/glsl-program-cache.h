@@ -0,0 +1,47 @@
+#ifndef gles_utils_glsl_program_cache_h
+#define gles_utils_glsl_program_cache_h
+
+#include <GLES2/gl2.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+
+namespace glipf {
+namespace gles_utils {
+
+/**
+ * @brief Cache of linked GLSL programs, so that identical generated
+ *        programs are compiled and linked only once.
+ *
+ * The cache owns its programs. Users of a shared program must set
+ * every uniform they depend on before drawing with it.
+ */
+class GlslProgramCache {
+public:
+  GlslProgramCache() = default;
+  GlslProgramCache(const GlslProgramCache&) = delete;
+  GlslProgramCache& operator=(const GlslProgramCache&) = delete;
+  ~GlslProgramCache();
+
+  /// Return the program cached under a key, building it on a miss.
+  GLuint get(const std::string& key, const std::function<GLuint()>& buildProgram);
+
+  /// Delete all cached programs; must be called while their GL context
+  /// is current.
+  void clear();
+
+  /// Return the cache of the current GL context.
+  static GlslProgramCache& defaultCache();
+  /// Delete the cache of the current GL context and its programs.
+  static void releaseDefaultCache();
+
+protected:
+  std::unordered_map<std::string, GLuint> mGlslPrograms;
+};
+
+} // end namespace gles_utils
+} // end namespace glipf
+
+#endif // gles_utils_glsl_program_cache_h
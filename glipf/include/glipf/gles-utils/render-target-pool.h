@@ -0,0 +1,115 @@
+#ifndef gles_utils_render_target_pool_h
+#define gles_utils_render_target_pool_h
+
+#include <GLES2/gl2.h>
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+#include <vector>
+
+
+namespace glipf {
+namespace gles_utils {
+
+/**
+ * @brief Pool of texture-backed FBOs shared by processors.
+ *
+ * Render targets are handed out as leases and return to the pool when
+ * their lease ends, so that a processor created after another one was
+ * destroyed reuses its targets instead of allocating new ones. The pool
+ * keeps track of the GPU memory held by its targets.
+ */
+class RenderTargetPool {
+public:
+  /// Width, height, texel type and whether a depth buffer is attached
+  using Format = std::tuple<size_t, size_t, GLenum, bool>;
+
+  class Lease {
+  public:
+    Lease();
+    Lease(Lease&& other);
+    Lease& operator=(Lease&& other);
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    GLuint texture() const;
+    GLuint fbo() const;
+
+    /// Return the target to the pool; the lease is empty afterwards.
+    void release();
+
+  protected:
+    friend class RenderTargetPool;
+
+    Lease(RenderTargetPool* pool, const Format& format, GLuint texture,
+          GLuint fbo, GLuint depthBuffer);
+
+    RenderTargetPool* mPool;
+    Format mFormat;
+    GLuint mTexture;
+    GLuint mFbo;
+    GLuint mDepthBuffer;
+  };
+
+  RenderTargetPool();
+  RenderTargetPool(const RenderTargetPool&) = delete;
+  RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+  ~RenderTargetPool();
+
+  /**
+   * Lease an RGBA render target. A reused target is cleared to zero,
+   * which leaves the current FBO binding changed.
+   */
+  Lease acquire(size_t width, size_t height, GLenum type = GL_UNSIGNED_BYTE,
+                bool hasDepthBuffer = false);
+
+  /**
+   * Set the GPU memory, in bytes, the pool should stay within, or 0 for
+   * no limit. Idle targets are deleted to make room for new ones; if
+   * that doesn't suffice, a warning is printed and the target is
+   * allocated anyway.
+   */
+  void setMemoryBudget(size_t memoryBudget);
+
+  /// GPU memory held by all targets, leased or idle, in bytes
+  size_t memoryUsage() const;
+  /// Highest memory usage so far, in bytes
+  size_t peakMemoryUsage() const;
+  /// GPU memory held by leased targets, in bytes
+  size_t leasedMemoryUsage() const;
+
+  /// Delete all idle targets; must be called while their GL context is
+  /// current.
+  void trim();
+
+  /// Return the pool of the current GL context.
+  static RenderTargetPool& defaultPool();
+  /// Delete the pool of the current GL context and its idle targets;
+  /// none of its targets may still be leased.
+  static void releaseDefaultPool();
+
+protected:
+  struct RenderTarget {
+    GLuint texture;
+    GLuint fbo;
+    GLuint depthBuffer;
+  };
+
+  static size_t formatMemorySize(const Format& format);
+  RenderTarget createRenderTarget(const Format& format);
+  void deleteRenderTarget(const Format& format, const RenderTarget& target);
+  void returnRenderTarget(const Format& format, const RenderTarget& target);
+
+  std::map<Format, std::vector<RenderTarget>> mIdleRenderTargets;
+  size_t mMemoryBudget;
+  size_t mMemoryUsage;
+  size_t mPeakMemoryUsage;
+  size_t mLeasedMemoryUsage;
+};
+
+} // end namespace gles_utils
+} // end namespace glipf
+
+#endif // gles_utils_render_target_pool_h
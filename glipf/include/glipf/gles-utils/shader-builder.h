@@ -1,6 +1,8 @@
 #ifndef shader_builder_h
 #define shader_builder_h
 
+#include "fragment-stage.h"
+
 #include <GLES2/gl2.h>
 
 #include <stdexcept>
@@ -36,6 +38,12 @@ public:
 
   ShaderBuilder& appendSourceString(std::string sourceString);
   ShaderBuilder& appendSourceFile(std::string filePath);
+
+  /**
+   * Append a fragment shader running a chain of stages on the pixel
+   * sampled from `tex`, discarding it as soon as a stage rejects it.
+   */
+  ShaderBuilder& appendFragmentStages(const std::vector<FragmentStage>& stages);
   GLuint compile();
 
 protected:
@@ -1,6 +1,8 @@
 #ifndef gles_utils_texture_container_h
 #define gles_utils_texture_container_h
 
+#include "../utils/profiler.h"
+
 #include <GLES2/gl2.h>
 
 #include <cstddef>
@@ -17,10 +19,12 @@ public:
 
   void uploadData(const void* frameData);
   GLuint getTexture() const;
+  void setProfiler(utils::Profiler& profiler);
 
 protected:
   std::pair<size_t, size_t> mDimensions;
   GLuint mTexture;
+  utils::Profiler* mProfiler;
 };
 
 } // end namespace gles_utils
@@ -10,18 +10,37 @@ namespace processors {
 class BackgroundSubtractionProcessor : public GlesProcessor {
 public:
   BackgroundSubtractionProcessor(const sources::FrameProperties& frameProperties,
-                                 const void* referenceFrameData);
+                                 const void* referenceFrameData,
+                                 float adaptationRate = 0.0f,
+                                 bool hasHsvOutput = false);
   ~BackgroundSubtractionProcessor() override;
 
+  virtual bool setUpdateMask(GLuint updateMaskTexture) override;
+  /// Replace the reference frame with the contents of a texture, e.g. a
+  /// preprocessed frame; it becomes the background again.
+  void setReferenceFrame(GLuint frameTexture);
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const override;
 
 protected:
+  gles_utils::FragmentStage subtractionStage() const;
   void setupResultFbo();
+  void setupBackgroundUpdate();
+  GLuint buildUpdateGlslProgram(bool useUpdateMask);
+  void updateBackground();
 
   GLuint mGlslProgram;
   GLuint mReferenceFrameTexture;
   GLuint mResultTexture;
   GLuint mResultFbo;
+  float mAdaptationRate;
+  bool mHasHsvOutput;
+  GLuint mUpdateGlslProgram;
+  GLuint mMaskedUpdateGlslProgram;
+  GLuint mUpdateMaskTexture;
+  TextureFboPair mBackgroundTextureFboPairs[2];
+  size_t mNextBackgroundIndex;
+  GLuint mBackgroundTexture;
 };
 
 } // end namespace processors
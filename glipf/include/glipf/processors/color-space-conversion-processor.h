@@ -3,6 +3,8 @@
 
 #include "gles-processor.h"
 
+#include <string>
+
 
 namespace glipf {
 namespace processors {
@@ -15,8 +17,10 @@ public:
   ~ColorSpaceConversionProcessor();
 
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const override;
 
 protected:
+  std::string mColorSpaceDefines;
   GLuint mGlslProgram;
   GLuint mResultTexture;
   GLuint mResultFbo;
@@ -0,0 +1,66 @@
+#ifndef processors_connected_components_processor_h
+#define processors_connected_components_processor_h
+
+#include "gles-processor.h"
+
+#include <string>
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+class ConnectedComponentsProcessor : public GlesProcessor {
+public:
+  /**
+   * A non-zero iterationCount runs exactly that many label propagation
+   * passes, which may leave long or winding components split into
+   * several. The default of 0 runs passes until labels stop changing,
+   * checking every few passes with a one-texel readback.
+   */
+  ConnectedComponentsProcessor(const sources::FrameProperties& frameProperties,
+                               size_t iterationCount = 0);
+  ~ConnectedComponentsProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+
+  /**
+   * Only treat pixels with the given bit set in their alpha mask as
+   * foreground, as written by MultiThresholdProcessor. A negative index
+   * restores the default of treating any non-zero alpha as foreground.
+   */
+  void setMaskBit(int bitIndex);
+
+protected:
+  GLuint buildGlslProgram(const std::string& vertexShaderPath,
+                          const std::string& fragmentShaderPath,
+                          const std::string& defines);
+  void setupScatterPoints();
+  void labelComponents(GLuint frameTexture);
+  bool hasLabelChanges();
+  void scatterToRoots();
+  void extractComponents();
+
+  size_t mIterationCount;
+  size_t mScale;
+  std::pair<size_t, size_t> mWorkingDimensions;
+  std::pair<size_t, size_t> mTileGridDimensions;
+  GLuint mInitializationGlslProgram;
+  GLuint mPropagationGlslProgram;
+  GLuint mBoundingBoxGlslProgram;
+  GLuint mAreaGlslProgram;
+  GLuint mCompactionGlslProgram;
+  GLuint mChangeDetectionGlslProgram;
+  GLuint mScatterPointsBuffer;
+  TextureFboPair mLabelTextureFboPairs[2];
+  size_t mLabelIndex;
+  TextureFboPair mBoundingBoxTextureFboPair;
+  TextureFboPair mAreaTextureFboPair;
+  TextureFboPair mCompactionTextureFboPair;
+  TextureFboPair mChangeTextureFboPair;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_connected_components_processor_h
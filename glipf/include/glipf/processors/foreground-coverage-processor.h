@@ -13,10 +13,12 @@ class ForegroundCoverageProcessor : public GlesProcessor {
 public:
   ForegroundCoverageProcessor(const sources::FrameProperties& frameProperties,
                               const std::vector<ModelData>& models,
-                              const glm::mat4& mvpMatrix);
+                              const glm::mat4& mvpMatrix,
+                              float qualityScale = 1.0f);
   ~ForegroundCoverageProcessor();
 
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual size_t inputPyramidLevel() const override;
 
 protected:
   using TextureFboPair = std::pair<GLuint, GLuint>;
@@ -24,6 +26,7 @@ protected:
                                      std::vector<TextureFboPair>>;
   using ReductionFboSpec = std::tuple<GLuint, uint_fast16_t, uint_fast16_t>;
 
+  bool isModelDrawn(const utils::ProjectedModel& projectedModel) const;
   void setupModelGeometry(const std::vector<ModelData>& models);
   void addReductionFboSet(size_t modelCount, GLuint indexOffset,
                           GLuint indexCount);
@@ -31,6 +34,10 @@ protected:
   void startForegroundCoverage(void* referenceFrameData);
   void calculateForegroundCoverage();
 
+  std::pair<size_t, size_t> mWorkingDimensions;
+  size_t mModelCount;
+  /// Indices of the models rendered, in the order they're rendered
+  std::vector<size_t> mDrawnModelIndices;
   GLuint mPixelCountingGlslProgram;
   GLuint mModelVertexBuffer;
   GLuint mModelIndexBuffer;
@@ -2,6 +2,7 @@
 #define foreground_histogram_processor_h
 
 #include "gles-processor.h"
+#include "model-occlusion-processor.h"
 
 #include <glm/glm.hpp>
 
@@ -15,41 +16,124 @@ public:
 
   ForegroundHistogramProcessor(const sources::FrameProperties& frameProperties,
                                size_t maxModelCount,
-                               const glm::mat4& mvpMatrix);
+                               const glm::mat4& mvpMatrix,
+                               bool hasHsvInput = false,
+                               float qualityScale = 1.0f);
   ~ForegroundHistogramProcessor() override;
+
+  /// Coarsest level of detail accepted by setModels()
+  static constexpr size_t kMaxLevelOfDetail = 2;
+
+  /**
+   * Set the models to compute histograms of. If occluders are set,
+   * ownOccluderIndices holds for every model the index of the occluder
+   * it belongs to, which never hides it, or -1. levelsOfDetail holds
+   * for every model the level at which it is sampled: at level n only
+   * every 2^n-th pixel in either direction is scattered, and pixel
+   * counts are scaled up to make up for the skipped ones.
+   */
   void setModels(const std::vector<ModelData>& models,
-                 const glm::mat4& mvpMatrix);
+                 const glm::mat4& mvpMatrix,
+                 const std::vector<int>& ownOccluderIndices = {},
+                 const std::vector<size_t>& levelsOfDetail = {});
 
+  /**
+   * Skip model pixels hidden behind the nearer models last processed by
+   * an occlusion processor, and models hidden entirely; pass nullptr to
+   * stop culling. Entirely hidden models are found by setModels(), so
+   * occluders have to be set before it.
+   */
+  void setOccluders(const ModelOcclusionProcessor* occlusionProcessor);
+
+  /**
+   * Scatter the histograms of the models. Histograms (keyed by model
+   * number), "total_pixel_counts" and "histogram_coverage" are
+   * LazyNumbers read back together when the first of them is read.
+   */
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual size_t inputPyramidLevel() const override;
 
 protected:
   using TextureFboPair = std::pair<GLuint, GLuint>;
   using ReductionFboSet = std::tuple<size_t, GLuint, GLuint>;
   using ReductionFboSpec = std::tuple<GLuint, uint_fast16_t, uint_fast16_t>;
-  using HistogramFboSpec = std::pair<GLint, GLsizei>;
 
-  void setupHistogramBuffers(const std::vector<ModelData>& models,
-                             const glm::mat4& mvpMatrix);
+  /// Scatter samples covering the bounding box of a model
+  struct ModelBbox {
+    uint_fast16_t x;
+    uint_fast16_t y;
+    uint_fast16_t columnCount;
+    uint_fast16_t rowCount;
+    uint_fast16_t sampleStep;
+    /// Number of bounding box pixels every sample stands for
+    float sampleWeight;
+  };
+
+  void setupModelBboxes(const std::vector<utils::ProjectedModel>& projectedModels,
+                        const std::vector<bool>& hiddenModels,
+                        const std::vector<size_t>& levelsOfDetail);
+  static bool hasHalfFloatRenderTargets();
+  static bool hasComputeShaders();
+  void setupScatterTemplate();
+  void accumulateHistogramFbo(uint_fast32_t* binCounts);
+  void accumulateHistogramData(const void* histogramData,
+                               uint_fast32_t* binCounts) const;
+  size_t histogramFboByteCount() const;
+  void reservePixelPackBuffer(size_t passCount);
+  void queueHistogramReadback(size_t fboIndex);
+  void accumulateQueuedReadbacks(uint_fast32_t* binCounts, size_t fboBinCount);
+  void scatterHistograms(uint_fast32_t* binCounts, size_t fboCount,
+                         size_t fboBinCount);
+  void setupHistogramCompute();
+  void dispatchHistogramCompute(size_t fboCount);
+  void accumulateComputedHistograms(uint_fast32_t* binCounts, size_t binCount);
   void setupFbos(size_t modelCount);
-  void setupModelGeometry(const std::vector<ModelData>& models);
+  void setupModelGeometry(const std::vector<ModelData>& models,
+                          const std::vector<int>& ownOccluderIndices);
   void addModelForegroundFbo();
   void addHistogramFbo();
   void setupReductionGlslPrograms(const glm::mat4& mvpMatrix);
+  GLuint buildReductionGlslProgram(const glm::mat4& mvpMatrix,
+                                   bool isOcclusionCulling);
 
+  /// Resolution models are rasterised at, per model grid cell
+  std::pair<size_t, size_t> mWorkingDimensions;
   size_t mModelCount;
   size_t mMaxModelCount;
+  bool mHasHsvInput;
+  glm::mat4 mMvpMatrix;
+  const ModelOcclusionProcessor* mOcclusionProcessor;
+  GLuint mCullingGlslProgram;
+  utils::ModelProjection mModelProjection;
   std::vector<double> mModelAreas;
   GLuint mModelVertexBuffer;
   GLuint mModelIndexBuffer;
-  GLuint mScatterPointsBuffer;
+  GLuint mScatterTemplateBuffer;
   GLuint mHistogramGlslProgram;
+  GLint mCellOriginLocation;
+  GLint mChannelPairLocation;
+  GLint mModelBboxLocation;
+  GLenum mHistogramType;
+  /// Points of a model scattered per pass without overflowing a channel
+  GLsizei mPassPointCount;
+  /// Whether histograms are read back through a pixel pack buffer (GLES 3)
+  bool mHasPixelPackBuffers;
+  GLuint mPixelPackBuffer;
+  size_t mPixelPackBufferSize;
+  /// Histogram FBO read into every slice of the pixel pack buffer
+  std::vector<size_t> mQueuedReadbackFbos;
+  /// Compute shader building all histograms at once (GLES 3.1), or 0
+  GLuint mComputeGlslProgram;
+  GLint mFirstModelNumberLocation;
+  GLuint mModelBboxBuffer;
+  GLuint mBinCountBuffer;
   std::vector<ReductionFboSet> mReductionFboSets;
   std::vector<ReductionFboSpec> mReductionFboSpecs;
   std::vector<GLuint> mForegroundTextures;
   std::vector<GLuint> mForegroundFbos;
   std::vector<GLuint> mHistogramTextures;
   std::vector<GLuint> mHistogramFbos;
-  std::vector<HistogramFboSpec> mHistogramFboSpecs;
+  std::vector<ModelBbox> mModelBboxes;
 };
 
 } // end namespace processors
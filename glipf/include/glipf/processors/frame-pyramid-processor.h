@@ -0,0 +1,62 @@
+#ifndef processors_frame_pyramid_processor_h
+#define processors_frame_pyramid_processor_h
+
+#include "gles-processor.h"
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+/**
+ * @brief Processor building a resolution pyramid of a foreground
+ *        texture once per frame.
+ *
+ * Level `n` has the frame resolution divided by 2^n. Every level is
+ * reduced from the previous one, so the full-resolution texture is
+ * sampled only once. Levels hold the average color of the foreground
+ * texels of a block and the fraction of the block that is foreground
+ * in alpha; an HSV version of each level is kept as well, unless the
+ * input foreground already is HSV, in which case the levels themselves
+ * are HSV. Processors report the level they work at through
+ * GlesProcessor::inputPyramidLevel().
+ */
+class FramePyramidProcessor : public GlesProcessor {
+public:
+  FramePyramidProcessor(const sources::FrameProperties& frameProperties,
+                        size_t levelCount = 3, bool hasHsvInput = false);
+  ~FramePyramidProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+
+  size_t levelCount() const;
+
+  /// Return the foreground texture of a level, or of the last level if
+  /// the pyramid isn't that deep; level 0 is the last processed input.
+  GLuint foregroundTexture(size_t level) const;
+
+  /// Return the HSV foreground texture of a level, clamped like
+  /// foregroundTexture(). Unless the input is HSV, HSV levels start at
+  /// 1, which is returned for level 0.
+  GLuint hsvTexture(size_t level) const;
+
+  /// Return the texture of the level a processor asks for.
+  GLuint textureFor(const GlesProcessor& processor, bool isHsv = false) const;
+
+protected:
+  size_t mLevelCount;
+  bool mHasHsvInput;
+  GLuint mReductionGlslProgram;
+  GLuint mHsvConversionGlslProgram;
+  GLint mInputTexelSizeLocation;
+  GLuint mInputTexture;
+  std::vector<std::pair<size_t, size_t>> mLevelDimensions;
+  std::vector<TextureFboPair> mForegroundTextureFboPairs;
+  std::vector<TextureFboPair> mHsvTextureFboPairs;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_frame_pyramid_processor_h
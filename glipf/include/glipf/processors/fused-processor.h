@@ -0,0 +1,51 @@
+#ifndef processors_fused_processor_h
+#define processors_fused_processor_h
+
+#include "gles-processor.h"
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+/**
+ * @brief Processor running a chain of full-screen processors as a
+ *        single pass.
+ *
+ * The fragment stages of the processors (see
+ * GlesProcessor::fragmentStage()) are composed into one generated
+ * fragment shader, so intermediate results are never written to or read
+ * back from a framebuffer. The result is published both as
+ * `fused_texture` and under the output key of the last stage; when an
+ * intermediate result is needed, the processors have to be run on
+ * their own instead. Programs are shared through the default
+ * GlslProgramCache, so identical chains are compiled only once.
+ */
+class FusedProcessor : public GlesProcessor {
+public:
+  /// Throws std::invalid_argument if the processors can't be fused (see
+  /// canFuse()).
+  FusedProcessor(const sources::FrameProperties& frameProperties,
+                 const std::vector<const GlesProcessor*>& processors);
+  ~FusedProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+
+  /**
+   * Return true if every processor of a chain provides a fragment stage,
+   * no two stages share a function name and only the first stage
+   * resamples its input.
+   */
+  static bool canFuse(const std::vector<const GlesProcessor*>& processors);
+
+protected:
+  std::vector<gles_utils::FragmentStage> mStages;
+  GLuint mGlslProgram;
+  TextureFboPair mResultTextureFboPair;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_fused_processor_h
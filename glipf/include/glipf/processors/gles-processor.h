@@ -1,7 +1,12 @@
 #ifndef gles_processor_h
 #define gles_processor_h
 
+#include "../gles-utils/fragment-stage.h"
+#include "../gles-utils/render-target-pool.h"
 #include "../sources/frame-properties.h"
+#include "../utils/model-projection.h"
+#include "../utils/profiler.h"
+#include "../utils/roi-scheduler.h"
 #include "processing-result.h"
 
 #include <GLES2/gl2.h>
@@ -24,20 +29,75 @@ public:
   GlesProcessor(const sources::FrameProperties& frameProperties);
   virtual ~GlesProcessor();
   virtual const ProcessingResultSet& process(GLuint frameTexture) = 0;
+  void setProfiler(utils::Profiler& profiler);
+
+  /**
+   * Return the level of a frame pyramid (see FramePyramidProcessor)
+   * closest to the processor's working resolution, with 0 being the
+   * full-resolution frame.
+   */
+  virtual size_t inputPyramidLevel() const;
+
+  /**
+   * Describe the processor's per-pixel work as a fragment stage, so
+   * that it can be fused with other full-screen passes (see
+   * FusedProcessor). Return false if the processor can't be fused.
+   */
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const;
+
+  /**
+   * Keep the processor's background model from learning where the red
+   * channel of the given texture is non-zero, e.g. under tracked
+   * targets. A texture of 0 removes the mask. Return false if the
+   * processor keeps no background model.
+   */
+  virtual bool setUpdateMask(GLuint updateMaskTexture);
+
+  /**
+   * Restrict the processor's full-screen passes to the given regions of
+   * the frame, in frame pixels. Outputs outside them are left cleared.
+   * An empty list means the whole frame. Processors which can't skip
+   * parts of the frame ignore the regions.
+   */
+  void setRegionsOfInterest(const std::vector<utils::RegionOfInterest>& regions);
 
 protected:
   using TextureFboPair = std::pair<GLuint, GLuint>;
 
-  TextureFboPair generateTextureBackedFbo(std::pair<size_t, size_t> dimensions);
+  /**
+   * Lease a texture-backed FBO from the default render target pool. The
+   * lease is held until the processor is destroyed, so the texture and
+   * FBO must not be deleted by the processor itself.
+   */
+  TextureFboPair generateTextureBackedFbo(std::pair<size_t, size_t> dimensions,
+                                          GLenum type = GL_UNSIGNED_BYTE,
+                                          bool hasDepthBuffer = false);
   void drawFullscreenQuad(GLuint vertexPositionAttribLoc);
-  std::vector<double> computeModelAreas(const std::vector<ModelData>& models,
-                                        const glm::mat4& mvpMatrix,
+  /// Draw a full-screen quad scissored to the regions of interest.
+  void drawRegionsOfInterest(GLuint vertexPositionAttribLoc);
+  GLuint buildFragmentStageGlslProgram(const std::vector<gles_utils::FragmentStage>& stages,
+                                       GLuint vertexPositionAttribLoc);
+  size_t pyramidLevelForWidth(size_t workingWidth) const;
+  /**
+   * Return the working resolution of a processor sampling frames at
+   * frameScale times their size, further scaled by qualityScale. Both
+   * dimensions are rounded to multiples of 4 and shrunk, keeping the
+   * aspect ratio, until gridSize x gridSize working areas fit into a
+   * texture.
+   */
+  std::pair<size_t, size_t> workingDimensions(float frameScale,
+                                              float qualityScale,
+                                              size_t gridSize = 1) const;
+  std::vector<double> computeModelAreas(const std::vector<utils::ProjectedModel>& projectedModels,
                                         size_t viewportWidth,
                                         size_t viewportHeight);
 
   GLuint mQuadVertexBuffer;
+  std::vector<gles_utils::RenderTargetPool::Lease> mRenderTargetLeases;
   ProcessingResultSet mResultSet;
+  std::vector<utils::RegionOfInterest> mRegionsOfInterest;
   const sources::FrameProperties& mFrameProperties;
+  utils::Profiler* mProfiler;
 };
 
 } // end namespace processors
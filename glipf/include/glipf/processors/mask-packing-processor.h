@@ -0,0 +1,50 @@
+#ifndef processors_mask_packing_processor_h
+#define processors_mask_packing_processor_h
+
+#include "gles-processor.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+/**
+ * @brief Processor reading back a binary mask at one bit per pixel.
+ *
+ * A mask pixel is any pixel with non-zero alpha or, once setMaskBit()
+ * has been called, with the given bit set in its alpha mask. Every 32
+ * horizontally adjacent mask pixels are packed into one RGBA texel on
+ * the GPU, so the readback is 32 times smaller than reading back the
+ * input texture. Every row of the packed mask is a bitset in which the
+ * pixel in column `x` is bit `x % 8` of byte `x / 8`; rows are stored
+ * in glReadPixels order.
+ */
+class MaskPackingProcessor : public GlesProcessor {
+public:
+  MaskPackingProcessor(const sources::FrameProperties& frameProperties);
+  ~MaskPackingProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  void setMaskBit(int bitIndex);
+
+  const std::vector<GLubyte>& packedMask() const;
+  size_t packedRowLength() const;
+
+  /// Expand the packed mask into an 8-bit image with mask pixels set
+  /// to 255 and all others to 0.
+  void unpackMask(cv::Mat& mask) const;
+
+protected:
+  size_t mPackedWidth;
+  GLuint mGlslProgram;
+  TextureFboPair mPackedTextureFboPair;
+  std::vector<GLubyte> mPackedMask;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_mask_packing_processor_h
@@ -9,30 +9,65 @@
 namespace glipf {
 namespace processors {
 
+/**
+ * @brief Processor measuring how much of every model is visible when
+ *        all models are rendered together.
+ *
+ * The occlusion texture holds the number of the nearest model (starting
+ * at 1) in red and its depth in green and blue (see
+ * glsl/include/occlusion-depth.frag), so that it also serves as a depth
+ * and ID buffer for culling hidden pixels of other models. On GLES 3,
+ * model numbers and depths are also rendered into an integer target,
+ * which is what's read back, so that visibility is measured exactly
+ * for any number of models; the texture then clamps model numbers to
+ * 255.
+ */
 class ModelOcclusionProcessor : public GlesProcessor {
 public:
   using ModelData = std::pair<std::vector<GLfloat>, std::vector<GLushort>>;
 
   ModelOcclusionProcessor(const sources::FrameProperties& frameProperties,
-                          const glm::mat4& mvpMatrix);
+                          const glm::mat4& mvpMatrix,
+                          float qualityScale = 1.0f);
   ~ModelOcclusionProcessor() override;
 
   void setModels(const std::vector<ModelData>& models,
                  const glm::mat4& mvpMatrix);
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
 
+  GLuint occlusionTexture() const;
+
+  /**
+   * Return true if a model is entirely hidden behind the last processed
+   * models, other than the one with index ownModelIndex (-1 for none).
+   * The test is conservative: it checks the model's bounding box
+   * against its nearest vertex.
+   */
+  bool isModelHidden(const utils::ProjectedModel& projectedModel,
+                     int ownModelIndex) const;
+
 protected:
   void setupModelGeometry(const std::vector<ModelData>& models);
+  void setupModelNumberTarget();
+  /// Return the number and depth of the nearest model at a pixel of the
+  /// last readback.
+  void readOccluder(size_t x, size_t y, size_t& modelNumber,
+                    float& depth) const;
 
+  std::pair<size_t, size_t> mWorkingDimensions;
   size_t mModelCount;
+  utils::ModelProjection mModelProjection;
   std::vector<double> mModelAreas;
   GLuint mMainGlslProgram;
   size_t mModelIndexCount;
   GLuint mModelVertexBuffer;
   GLuint mModelIndexBuffer;
   GLuint mTexture;
-  GLuint mRenderBuffer;
   GLuint mFrameBuffer;
+  std::vector<GLubyte> mOcclusionData;
+  bool mHasIntegerModelNumbers;
+  GLuint mModelNumberTexture;
+  std::vector<GLuint> mModelNumberData;
 };
 
 } // end namespace processors
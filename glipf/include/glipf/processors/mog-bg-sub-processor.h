@@ -0,0 +1,49 @@
+#ifndef processors_mog_bg_sub_processor_h
+#define processors_mog_bg_sub_processor_h
+
+#include "gles-processor.h"
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+class MogBgSubProcessor : public GlesProcessor {
+public:
+  static constexpr size_t kMaxGaussianCount = 4;
+
+  MogBgSubProcessor(const sources::FrameProperties& frameProperties,
+                    size_t gaussianCount = 3, size_t historyLength = 200,
+                    float backgroundRatio = 0.7f, bool hasHsvOutput = false);
+  ~MogBgSubProcessor() override;
+
+  virtual bool setUpdateMask(GLuint updateMaskTexture) override;
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+
+protected:
+  GLuint buildGlslProgram(const std::string& fragmentShaderPath,
+                          const std::string& defines);
+  std::vector<GLuint> buildUpdateGlslPrograms(const std::string& defines);
+  void bindModelTextures(size_t modelIndex);
+  void renderModel(size_t modelIndex, const std::vector<GLuint>& glslPrograms);
+
+  size_t mGaussianCount;
+  float mLearningRate;
+  float mBackgroundRatio;
+  GLuint mSubtractionGlslProgram;
+  std::vector<GLuint> mInitializationGlslPrograms;
+  std::vector<GLuint> mUpdateGlslPrograms;
+  std::vector<GLuint> mMaskedUpdateGlslPrograms;
+  GLuint mUpdateMaskTexture;
+  std::vector<TextureFboPair> mModelTextureFboPairs[2];
+  size_t mCurrentModelIndex;
+  bool mIsModelInitialized;
+  GLuint mResultTexture;
+  GLuint mResultFbo;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_mog_bg_sub_processor_h
@@ -0,0 +1,39 @@
+#ifndef processors_morphology_processor_h
+#define processors_morphology_processor_h
+
+#include "gles-processor.h"
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+enum class MorphologicalOperation {
+  kErode, kDilate, kOpen, kClose
+};
+
+
+class MorphologyProcessor : public GlesProcessor {
+public:
+  MorphologyProcessor(const sources::FrameProperties& frameProperties,
+                      MorphologicalOperation operation,
+                      size_t kernelRadius = 1, bool isBitmask = false);
+  ~MorphologyProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+
+protected:
+  GLuint buildPassGlslProgram(bool isErosion, bool isLastPass,
+                              const glm::vec2& texelStep);
+
+  size_t mKernelRadius;
+  bool mIsBitmask;
+  std::vector<GLuint> mPassGlslPrograms;
+  TextureFboPair mTextureFboPairs[2];
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_morphology_processor_h
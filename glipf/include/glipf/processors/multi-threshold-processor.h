@@ -0,0 +1,48 @@
+#ifndef processors_multi_threshold_processor_h
+#define processors_multi_threshold_processor_h
+
+#include "gles-processor.h"
+
+#include <utility>
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+/**
+ * @brief Processor thresholding a frame against several HSV ranges in
+ *        a single pass.
+ *
+ * Every pixel is converted to HSV once and tested against all ranges.
+ * Bit `i` of the output alpha value (as an 8-bit integer) is set when
+ * the pixel falls into range `i`, so up to kMaxThresholdCount ranges
+ * are supported; other counts throw std::invalid_argument. Pixels
+ * outside every range are cleared.
+ */
+class MultiThresholdProcessor : public GlesProcessor {
+public:
+  using HsvRange = std::pair<glm::vec3, glm::vec3>;
+
+  static constexpr size_t kMaxThresholdCount = 8;
+
+  MultiThresholdProcessor(const sources::FrameProperties& frameProperties,
+                          const std::vector<HsvRange>& hsvRanges);
+  ~MultiThresholdProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const override;
+  size_t thresholdCount() const;
+
+protected:
+  size_t mThresholdCount;
+  std::vector<GLfloat> mLowerThresholdData;
+  std::vector<GLfloat> mUpperThresholdData;
+  GLuint mGlslProgram;
+  TextureFboPair mResultTextureFboPair;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_multi_threshold_processor_h
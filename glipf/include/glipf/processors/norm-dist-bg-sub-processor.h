@@ -3,6 +3,9 @@
 
 #include "gles-processor.h"
 
+#include <array>
+#include <vector>
+
 
 namespace glipf {
 namespace processors {
@@ -19,7 +22,11 @@ protected:
   void setupResultFbo();
   void setupBackgroundModel();
 
-  std::vector<uint8_t*> mBackgroundSamples;
+  // Running per-pixel YCoCg mean and sum of squared deviations from it
+  // (Welford's algorithm), one array per channel
+  size_t mBackgroundSampleCount;
+  std::array<std::vector<float>, 3> mSampleMeans;
+  std::array<std::vector<float>, 3> mSampleSquaredDeviations;
   GLuint mGlslProgram;
   GLuint mReferenceFrameTexture;
   GLuint mMeanTexture;
@@ -4,6 +4,8 @@
 #include <boost/variant/variant.hpp>
 #include <GLES2/gl2.h>
 
+#include <functional>
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -13,14 +15,64 @@ namespace processors {
 
 
 enum ProcessingResultType {
-  kTexture, kNumbers
+  kTexture, kNumbers, kLazyNumbers
 };
 
 
-typedef boost::variant<GLuint, std::vector<float>> ProcessingResult;
+/**
+ * @brief Numbers computed only when they're first read.
+ *
+ * Results read back together share a batch: reading any of them first
+ * fetches the whole batch, e.g. with a single readback, and then runs
+ * the result's own computation, e.g. normalisation. Results that are
+ * never read cost neither. Copies share the computed numbers. The
+ * numbers are only valid until the processor producing them processes
+ * the next frame.
+ */
+class LazyNumbers {
+public:
+  class Batch {
+  public:
+    explicit Batch(std::function<void()> fetch);
+
+    /// Run the fetch unless it already ran.
+    void fetch();
+
+  protected:
+    std::function<void()> mFetch;
+    bool mIsFetched;
+  };
+
+  LazyNumbers(std::shared_ptr<Batch> batch,
+              std::function<void(std::vector<float>&)> compute);
+
+  const std::vector<float>& get() const;
+
+protected:
+  struct State {
+    std::shared_ptr<Batch> batch;
+    std::function<void(std::vector<float>&)> compute;
+    bool isComputed;
+    std::vector<float> numbers;
+  };
+
+  std::shared_ptr<State> mState;
+};
+
+
+typedef boost::variant<GLuint, std::vector<float>, LazyNumbers> ProcessingResult;
 typedef std::map<std::string, ProcessingResult> ProcessingResultSet;
 
 
+/**
+ * Return the numbers of a result, computing them if they're lazy. Use
+ * this rather than boost::get for any result holding numbers, as
+ * processors may turn plain numbers into lazy ones; boost::get on a
+ * lazy result throws boost::bad_get.
+ */
+const std::vector<float>& getNumbers(const ProcessingResult& result);
+
+
 } // end namespace processors
 } // end namespace glipf
 
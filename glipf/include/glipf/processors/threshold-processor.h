@@ -14,8 +14,11 @@ public:
   ~ThresholdProcessor();
 
   virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const override;
 
 protected:
+  glm::vec3 mLowerHsvThreshold;
+  glm::vec3 mUpperHsvThreshold;
   GLuint mGlslProgram;
   GLuint mResultTexture;
   GLuint mResultFbo;
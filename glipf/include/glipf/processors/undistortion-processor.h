@@ -0,0 +1,51 @@
+#ifndef processors_undistortion_processor_h
+#define processors_undistortion_processor_h
+
+#include "gles-processor.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+namespace glipf {
+namespace processors {
+
+/**
+ * @brief Processor removing lens distortion from frames.
+ *
+ * The position every output pixel samples from the distorted frame is
+ * computed once, from distortion coefficients in OpenCV's order (k1, k2,
+ * p1, p2[, k3]), and stored in a remap texture with 16-bit fixed-point
+ * coordinates. Every frame is then resampled on the GPU with a single
+ * texture lookup per pixel. The output keeps the camera's intrinsics,
+ * so that models projected with them line up with the undistorted
+ * frame. The processor can be fused with the per-pixel passes that
+ * follow it (see FusedProcessor), as long as it comes first.
+ */
+class UndistortionProcessor : public GlesProcessor {
+public:
+  UndistortionProcessor(const sources::FrameProperties& frameProperties,
+                        const glm::vec2& focalLength,
+                        const glm::vec2& principalPoint,
+                        const std::vector<float>& distortionCoefficients);
+  ~UndistortionProcessor() override;
+
+  virtual const ProcessingResultSet& process(GLuint frameTexture) override;
+  virtual bool fragmentStage(gles_utils::FragmentStage& stage) const override;
+
+protected:
+  void setupRemapTexture(const glm::vec2& focalLength,
+                         const glm::vec2& principalPoint,
+                         const std::vector<float>& distortionCoefficients);
+
+  GLuint mGlslProgram;
+  GLuint mRemapTexture;
+  GLuint mResultTexture;
+  GLuint mResultFbo;
+};
+
+} // end namespace processors
+} // end namespace glipf
+
+#endif // processors_undistortion_processor_h
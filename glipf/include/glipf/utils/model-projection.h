@@ -0,0 +1,64 @@
+#ifndef utils_model_projection_h
+#define utils_model_projection_h
+
+#include <GLES2/gl2.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+namespace glipf {
+namespace utils {
+
+/// Image-space extent of a projected model, in frame pixels
+struct ProjectedModel {
+  glm::vec2 bboxMin;
+  glm::vec2 bboxMax;
+  /// Smallest projected z of the model's vertices; not above 0 if the
+  /// model crosses the camera plane
+  float nearestDepth;
+  /// Area of the smallest rotated rectangle enclosing the projected
+  /// vertices
+  float area;
+};
+
+
+/**
+ * @brief Projects the vertices of many models into the frame at once.
+ *
+ * Vertices are gathered into one structure-of-arrays buffer and
+ * transformed in a single loop the compiler can vectorise, instead of
+ * model by model. The buffers are kept between calls, so projecting
+ * the same number of models again doesn't allocate.
+ */
+class ModelProjection {
+public:
+  using ModelData = std::pair<std::vector<GLfloat>, std::vector<GLushort>>;
+
+  const std::vector<ProjectedModel>& project(const std::vector<ModelData>& models,
+                                             const glm::mat4& mvpMatrix);
+  const std::vector<ProjectedModel>& projectedModels() const;
+
+protected:
+  void computeMinAreaRect(size_t firstVertex, size_t vertexCount,
+                          ProjectedModel& projectedModel);
+
+  std::vector<GLfloat> mVertexX;
+  std::vector<GLfloat> mVertexY;
+  std::vector<GLfloat> mVertexZ;
+  std::vector<GLfloat> mImageX;
+  std::vector<GLfloat> mImageY;
+  std::vector<GLfloat> mDepth;
+  std::vector<glm::vec2> mHullPoints;
+  std::vector<glm::vec2> mHull;
+  std::vector<size_t> mModelOffsets;
+  std::vector<ProjectedModel> mProjectedModels;
+};
+
+} // end namespace utils
+} // end namespace glipf
+
+#endif // utils_model_projection_h
@@ -0,0 +1,119 @@
+#ifndef utils_profiler_h
+#define utils_profiler_h
+
+#include <GLES2/gl2.h>
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace glipf {
+namespace utils {
+
+/**
+ * @brief Histogram of durations recorded for a single processing stage.
+ *
+ * Durations are bucketed on a logarithmic scale: bucket `i` counts
+ * durations in the range [2^i, 2^(i+1)) microseconds, with the first
+ * and last buckets also collecting anything shorter or longer.
+ */
+class DurationHistogram {
+public:
+  static constexpr size_t kBucketCount = 24;
+  using Buckets = std::array<uint32_t, kBucketCount>;
+
+  DurationHistogram();
+
+  /// Record a duration given in seconds.
+  void record(float duration);
+
+  size_t count() const;
+  float meanDuration() const;
+  float minDuration() const;
+  float maxDuration() const;
+  const Buckets& buckets() const;
+
+protected:
+  size_t mCount;
+  double mTotalDuration;
+  float mMinDuration;
+  float mMaxDuration;
+  Buckets mBuckets;
+};
+
+
+/**
+ * @brief Collector of per-stage timings.
+ *
+ * Every timed stage is measured with CPU monotonic time. If the current
+ * GLES context exposes `GL_EXT_disjoint_timer_query`, the GPU time of
+ * the outermost active span is measured as well and recorded under the
+ * stage name suffixed with `.gpu`. GPU results become available
+ * asynchronously and are collected whenever a new span is started or
+ * the histograms are requested.
+ */
+class Profiler {
+public:
+  /// Timing span covering the lifetime of the object.
+  class Span {
+  public:
+    Span(Profiler& profiler, const std::string& stageName);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /// Stop timing before the span goes out of scope.
+    void finish();
+
+  protected:
+    Profiler& mProfiler;
+    std::string mStageName;
+    timespec mStartTime;
+    GLuint mGpuQuery;
+    bool mIsFinished;
+  };
+
+  using HistogramMap = std::map<std::string, DurationHistogram>;
+
+  Profiler();
+  ~Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  /// Return the profiler used by processors of the current GL context
+  /// unless told otherwise.
+  static Profiler& defaultProfiler();
+  /// Delete the profiler of the current GL context and its GL queries.
+  static void releaseDefaultProfiler();
+
+  void record(const std::string& stageName, float duration);
+  const HistogramMap& histograms();
+  void reset();
+  bool hasGpuTimer();
+
+protected:
+  using PendingQuery = std::pair<GLuint, std::string>;
+
+  void initializeGpuTimer();
+  GLuint beginGpuQuery();
+  void endGpuQuery(GLuint query, const std::string& stageName);
+  void collectGpuTimings();
+
+  bool mIsGpuTimerInitialized;
+  bool mHasGpuTimer;
+  GLuint mActiveGpuQuery;
+  std::vector<GLuint> mFreeGpuQueries;
+  std::vector<PendingQuery> mPendingGpuQueries;
+  HistogramMap mHistograms;
+};
+
+} // end namespace utils
+} // end namespace glipf
+
+#endif // utils_profiler_h
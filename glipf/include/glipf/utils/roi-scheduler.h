@@ -0,0 +1,63 @@
+#ifndef utils_roi_scheduler_h
+#define utils_roi_scheduler_h
+
+#include <GLES2/gl2.h>
+
+#include "model-projection.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+namespace glipf {
+namespace utils {
+
+/// Rectangle of a frame, in pixels
+struct RegionOfInterest {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+
+/**
+ * @brief Collects the parts of a frame later processing depends on.
+ *
+ * Models are projected to their bounding boxes, widened by a margin for
+ * the motion expected until the next frame. Overlapping boxes are merged,
+ * and the remaining ones are merged further until at most a fixed number
+ * of regions remain, so that processors restricting themselves to them
+ * only draw a few rectangles.
+ */
+class RoiScheduler {
+public:
+  RoiScheduler(std::pair<size_t, size_t> frameDimensions,
+               const glm::mat4& mvpMatrix, size_t margin,
+               size_t maxRegionCount = 8);
+
+  void clear();
+  /// Add the bounding boxes of models, projected in one batch.
+  void addModels(const std::vector<ModelProjection::ModelData>& models);
+  void addRegion(const RegionOfInterest& region);
+
+  /// Return the merged regions clipped to the frame, or none if nothing
+  /// was added.
+  std::vector<RegionOfInterest> regions() const;
+
+protected:
+  std::pair<size_t, size_t> mFrameDimensions;
+  glm::mat4 mMvpMatrix;
+  int mMargin;
+  size_t mMaxRegionCount;
+  ModelProjection mModelProjection;
+  std::vector<RegionOfInterest> mRegions;
+};
+
+} // end namespace utils
+} // end namespace glipf
+
+#endif // utils_roi_scheduler_h
@@ -0,0 +1,37 @@
+#ifndef utils_server_config_h
+#define utils_server_config_h
+
+#include "../processors/morphology-processor.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstddef>
+#include <utility>
+
+
+namespace glipf {
+namespace utils {
+
+/// Morphological filtering of a foreground mask, as read from a server
+/// configuration
+struct MorphologyConfig {
+  bool isEnabled;
+  processors::MorphologicalOperation operation;
+  size_t kernelRadius;
+};
+
+
+/**
+ * Read the `morphology.operation` and `morphology.kernelRadius` keys.
+ * Operations other than erode, dilate, open and close disable
+ * filtering.
+ */
+MorphologyConfig readMorphologyConfig(const boost::property_tree::ptree& config);
+
+/// Read the `captureResolution` array, defaulting to 640x480.
+std::pair<size_t, size_t> readCaptureResolution(const boost::property_tree::ptree& config);
+
+} // end namespace utils
+} // end namespace glipf
+
+#endif // utils_server_config_h
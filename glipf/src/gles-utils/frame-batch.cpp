@@ -0,0 +1,155 @@
+#include <glipf/gles-utils/frame-batch.h>
+
+#include <cassert>
+#include <cmath>
+
+
+#define assertNoGlError() assert(glGetError() == GL_NO_ERROR)
+
+
+namespace glipf {
+namespace gles_utils {
+
+
+namespace {
+
+// Lay the tiles out in a grid as close to square as possible, which
+// keeps both texture dimensions within GL_MAX_TEXTURE_SIZE for the
+// largest batches
+size_t columnCountFor(size_t frameCount) {
+  return std::ceil(std::sqrt(static_cast<double>(frameCount)));
+}
+
+
+std::pair<size_t, size_t> batchDimensions(std::pair<size_t, size_t> frameDimensions,
+                                          size_t frameCount)
+{
+  size_t columnCount = columnCountFor(frameCount);
+  size_t rowCount = (frameCount + columnCount - 1) / columnCount;
+
+  return std::make_pair(frameDimensions.first * columnCount,
+                        frameDimensions.second * rowCount);
+}
+
+} // end namespace
+
+
+FrameBatch::FrameBatch(const sources::FrameProperties& frameProperties,
+                       size_t frameCount)
+  : mFrameDimensions(frameProperties.dimensions())
+  , mFrameCount(frameCount)
+  , mColumnCount(columnCountFor(frameCount))
+  , mBatchFrameProperties(batchDimensions(mFrameDimensions, frameCount),
+                          frameProperties.colorSpace())
+  , mReadBackFbo(0)
+  , mProfiler(&utils::Profiler::defaultProfiler())
+{
+  assert(mFrameCount > 0);
+
+  std::pair<size_t, size_t> dimensions = mBatchFrameProperties.dimensions();
+  GLint maxTextureSize;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  assert(dimensions.first <= size_t(maxTextureSize) &&
+         dimensions.second <= size_t(maxTextureSize));
+
+  glGenTextures(1, &mTexture);
+  glBindTexture(GL_TEXTURE_2D, mTexture);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, dimensions.first, dimensions.second,
+               0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  assertNoGlError();
+}
+
+
+FrameBatch::~FrameBatch() {
+  if (mReadBackFbo != 0)
+    glDeleteFramebuffers(1, &mReadBackFbo);
+
+  glDeleteTextures(1, &mTexture);
+}
+
+
+void FrameBatch::uploadFrame(size_t index, const void* frameData) {
+  assert(index < mFrameCount);
+  utils::Profiler::Span uploadSpan(*mProfiler, "frame_upload");
+
+  std::pair<size_t, size_t> origin = tileOrigin(index);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, mTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, origin.first, origin.second,
+                  mFrameDimensions.first, mFrameDimensions.second,
+                  GL_RGB, GL_UNSIGNED_BYTE, frameData);
+  assertNoGlError();
+}
+
+
+size_t FrameBatch::uploadFrames(sources::FrameSource& frameSource) {
+  assert(frameSource.getFrameProperties().dimensions() == mFrameDimensions);
+
+  for (size_t i = 0; i < mFrameCount; ++i) {
+    const uint8_t* frameData = frameSource.grabFrame();
+
+    if (!frameData)
+      return i;
+
+    uploadFrame(i, frameData);
+  }
+
+  return mFrameCount;
+}
+
+
+const std::vector<uint8_t>& FrameBatch::readBack(GLuint texture) {
+  utils::Profiler::Span readBackSpan(*mProfiler, "batch_read_back");
+
+  std::pair<size_t, size_t> dimensions = mBatchFrameProperties.dimensions();
+
+  if (mReadBackFbo == 0)
+    glGenFramebuffers(1, &mReadBackFbo);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mReadBackFbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         texture, 0);
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+  mReadBackPixels.resize(dimensions.first * dimensions.second * 4);
+  glReadPixels(0, 0, dimensions.first, dimensions.second, GL_RGBA,
+               GL_UNSIGNED_BYTE, mReadBackPixels.data());
+  assertNoGlError();
+
+  return mReadBackPixels;
+}
+
+
+GLuint FrameBatch::getTexture() const {
+  return mTexture;
+}
+
+
+const sources::FrameProperties& FrameBatch::getFrameProperties() const {
+  return mBatchFrameProperties;
+}
+
+
+size_t FrameBatch::frameCount() const {
+  return mFrameCount;
+}
+
+
+std::pair<size_t, size_t> FrameBatch::tileOrigin(size_t index) const {
+  return std::make_pair((index % mColumnCount) * mFrameDimensions.first,
+                        (index / mColumnCount) * mFrameDimensions.second);
+}
+
+
+void FrameBatch::setProfiler(utils::Profiler& profiler) {
+  mProfiler = &profiler;
+}
+
+
+} // end namespace gles_utils
+} // end namespace glipf
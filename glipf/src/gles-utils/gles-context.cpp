@@ -1,54 +1,28 @@
 #include <glipf/gles-utils/gles-context.h>
 
+#include <glipf/gles-utils/glsl-program-cache.h>
+#include <glipf/gles-utils/render-target-pool.h>
+#include <glipf/utils/profiler.h>
+
 #include <GLES2/gl2.h>
 
+#include <cstdio>
+
 
 #define assertNoGlError() assert(glGetError() == GL_NO_ERROR)
 #define UNUSED(x) ((void)x)
 
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x0040
+#endif
+
 
 namespace glipf {
 namespace gles_utils {
 
 
 GlesContext::GlesContext() {
-  // Get an EGL display connection
-  mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-  assert(mDisplay != EGL_NO_DISPLAY);
-
-  // Initialize the EGL display connection
-  EGLBoolean result = eglInitialize(mDisplay, NULL, NULL);
-  assert(result != EGL_FALSE);
-  UNUSED(result);
-
-  // Get an appropriate EGL frame buffer configuration
-  EGLConfig config;
-  EGLint configCount;
-  const EGLint attributeList[] = {
-    EGL_RED_SIZE, 8,
-    EGL_GREEN_SIZE, 8,
-    EGL_BLUE_SIZE, 8,
-    EGL_ALPHA_SIZE, 8,
-    EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-    EGL_NONE
-  };
-
-  result = eglChooseConfig(mDisplay, attributeList, &config, 1, &configCount);
-  assert(result != EGL_FALSE);
-
-  // Set the current rendering API
-  result = eglBindAPI(EGL_OPENGL_ES_API);
-  assert(result != EGL_FALSE);
-
-  // Create an EGL rendering context
-  const EGLint contextAttributes[] = {
-    EGL_CONTEXT_CLIENT_VERSION, 2,
-    EGL_NONE
-  };
-
-  mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT,
-                              contextAttributes);
-  assert(mContext != EGL_NO_CONTEXT);
+  EGLConfig config = createContext(EGL_WINDOW_BIT);
 
   // Create a native window
   uint32_t screenWidth, screenHeight;
@@ -90,10 +64,119 @@ GlesContext::GlesContext() {
   mSurface = eglCreateWindowSurface(mDisplay, config, &mNativeWindow, NULL);
   assert(mSurface != EGL_NO_SURFACE);
 
-  // Connect the context to the surface
-  result = eglMakeCurrent(mDisplay, mSurface, mSurface, mContext);
+  initializeSurface();
+}
+
+
+GlesContext::GlesContext(Dimensions surfaceDimensions)
+  : mDimensions(surfaceDimensions)
+  , mNativeWindow()
+{
+  EGLConfig config = createContext(EGL_PBUFFER_BIT);
+
+  // Create a new EGL pbuffer surface; nothing is displayed, all
+  // processing happens in FBOs anyway
+  const EGLint surfaceAttributes[] = {
+    EGL_WIDTH, static_cast<EGLint>(surfaceDimensions.first),
+    EGL_HEIGHT, static_cast<EGLint>(surfaceDimensions.second),
+    EGL_NONE
+  };
+
+  mSurface = eglCreatePbufferSurface(mDisplay, config, surfaceAttributes);
+  assert(mSurface != EGL_NO_SURFACE);
+
+  initializeSurface();
+}
+
+
+GlesContext::~GlesContext() {
+  // Delete the GL objects shared by the processors of this context while
+  // it's still current
+  makeCurrent();
+  RenderTargetPool::releaseDefaultPool();
+  GlslProgramCache::releaseDefaultCache();
+  utils::Profiler::releaseDefaultProfiler();
+
+  eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroySurface(mDisplay, mSurface);
+  eglDestroyContext(mDisplay, mContext);
+}
+
+
+EGLConfig GlesContext::createContext(EGLint surfaceType) {
+  // Get an EGL display connection
+  mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  assert(mDisplay != EGL_NO_DISPLAY);
+
+  // Initialize the EGL display connection
+  EGLBoolean result = eglInitialize(mDisplay, NULL, NULL);
+  assert(result != EGL_FALSE);
+  UNUSED(result);
+
+  // Set the current rendering API
+  result = eglBindAPI(EGL_OPENGL_ES_API);
   assert(result != EGL_FALSE);
 
+  EGLConfig config;
+
+#ifdef GLIPF_GLES3
+  // Prefer GLES 3, which older drivers such as the Raspberry Pi's
+  // proprietary one don't offer
+  if (tryCreateContext(surfaceType, 3, config))
+    return config;
+#endif
+
+  bool isCreated = tryCreateContext(surfaceType, 2, config);
+  assert(isCreated);
+  UNUSED(isCreated);
+
+  return config;
+}
+
+
+bool GlesContext::tryCreateContext(EGLint surfaceType, EGLint clientVersion,
+                                   EGLConfig& config)
+{
+  // Get an appropriate EGL frame buffer configuration
+  EGLint configCount;
+  const EGLint attributeList[] = {
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_SURFACE_TYPE, surfaceType,
+    EGL_RENDERABLE_TYPE, clientVersion >= 3 ? EGL_OPENGL_ES3_BIT_KHR
+                                            : EGL_OPENGL_ES2_BIT,
+    EGL_NONE
+  };
+
+  EGLBoolean result = eglChooseConfig(mDisplay, attributeList, &config, 1,
+                                      &configCount);
+
+  if (result == EGL_FALSE || configCount == 0)
+    return false;
+
+  // Create an EGL rendering context
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_CLIENT_VERSION, clientVersion,
+    EGL_NONE
+  };
+
+  mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT,
+                              contextAttributes);
+
+  if (mContext == EGL_NO_CONTEXT)
+    return false;
+
+  mClientVersion = clientVersion;
+  return true;
+}
+
+
+void GlesContext::initializeSurface() {
+  // Connect the context to the surface
+  makeCurrent();
+
   // Adjust common GLES settings
   glPixelStorei(GL_PACK_ALIGNMENT, 1);
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -115,5 +198,30 @@ bool GlesContext::swapBuffers() {
 }
 
 
+void GlesContext::makeCurrent() {
+  EGLBoolean result = eglMakeCurrent(mDisplay, mSurface, mSurface, mContext);
+  assert(result != EGL_FALSE);
+  UNUSED(result);
+}
+
+
+EGLint GlesContext::clientVersion() const {
+  return mClientVersion;
+}
+
+
+int GlesContext::currentClientVersion() {
+  const GLubyte* version = glGetString(GL_VERSION);
+  int majorVersion = 2;
+
+  if (version != nullptr) {
+    std::sscanf(reinterpret_cast<const char*>(version), "OpenGL ES %d",
+                &majorVersion);
+  }
+
+  return majorVersion;
+}
+
+
 } // end namespace gles_utils
 } // end namespace glipf
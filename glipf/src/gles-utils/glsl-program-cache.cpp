@@ -0,0 +1,70 @@
+#include <glipf/gles-utils/glsl-program-cache.h>
+
+#include <EGL/egl.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+
+namespace glipf {
+namespace gles_utils {
+
+
+GlslProgramCache::~GlslProgramCache() {
+  clear();
+}
+
+
+GLuint GlslProgramCache::get(const std::string& key,
+                             const std::function<GLuint()>& buildProgram)
+{
+  auto programIt = mGlslPrograms.find(key);
+
+  if (programIt != mGlslPrograms.end())
+    return programIt->second;
+
+  GLuint glslProgram = buildProgram();
+  mGlslPrograms[key] = glslProgram;
+
+  return glslProgram;
+}
+
+
+void GlslProgramCache::clear() {
+  for (const auto& keyProgramPair : mGlslPrograms)
+    glDeleteProgram(keyProgramPair.second);
+
+  mGlslPrograms.clear();
+}
+
+
+namespace {
+
+// Programs belong to the context they were linked in, so every context
+// gets its own default cache
+std::mutex defaultCachesMutex;
+std::map<EGLContext, std::unique_ptr<GlslProgramCache>> defaultCaches;
+
+} // end namespace
+
+
+GlslProgramCache& GlslProgramCache::defaultCache() {
+  std::lock_guard<std::mutex> lock(defaultCachesMutex);
+  std::unique_ptr<GlslProgramCache>& cache = defaultCaches[eglGetCurrentContext()];
+
+  if (!cache)
+    cache.reset(new GlslProgramCache());
+
+  return *cache;
+}
+
+
+void GlslProgramCache::releaseDefaultCache() {
+  std::lock_guard<std::mutex> lock(defaultCachesMutex);
+  defaultCaches.erase(eglGetCurrentContext());
+}
+
+
+} // end namespace gles_utils
+} // end namespace glipf
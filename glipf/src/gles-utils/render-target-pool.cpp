@@ -0,0 +1,288 @@
+#include <glipf/gles-utils/render-target-pool.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+
+#define assertNoGlError() assert(glGetError() == GL_NO_ERROR)
+
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
+
+namespace glipf {
+namespace gles_utils {
+
+
+RenderTargetPool::Lease::Lease()
+  : mPool(nullptr)
+  , mFormat(0, 0, GL_UNSIGNED_BYTE, false)
+  , mTexture(0)
+  , mFbo(0)
+  , mDepthBuffer(0)
+{}
+
+
+RenderTargetPool::Lease::Lease(RenderTargetPool* pool, const Format& format,
+                               GLuint texture, GLuint fbo, GLuint depthBuffer)
+  : mPool(pool)
+  , mFormat(format)
+  , mTexture(texture)
+  , mFbo(fbo)
+  , mDepthBuffer(depthBuffer)
+{}
+
+
+RenderTargetPool::Lease::Lease(Lease&& other)
+  : Lease()
+{
+  *this = std::move(other);
+}
+
+
+RenderTargetPool::Lease& RenderTargetPool::Lease::operator=(Lease&& other) {
+  if (this != &other) {
+    release();
+
+    mPool = other.mPool;
+    mFormat = other.mFormat;
+    mTexture = other.mTexture;
+    mFbo = other.mFbo;
+    mDepthBuffer = other.mDepthBuffer;
+    other.mPool = nullptr;
+  }
+
+  return *this;
+}
+
+
+RenderTargetPool::Lease::~Lease() {
+  release();
+}
+
+
+GLuint RenderTargetPool::Lease::texture() const {
+  return mTexture;
+}
+
+
+GLuint RenderTargetPool::Lease::fbo() const {
+  return mFbo;
+}
+
+
+void RenderTargetPool::Lease::release() {
+  if (mPool == nullptr)
+    return;
+
+  mPool->returnRenderTarget(mFormat, {mTexture, mFbo, mDepthBuffer});
+  mPool = nullptr;
+  mTexture = 0;
+  mFbo = 0;
+  mDepthBuffer = 0;
+}
+
+
+RenderTargetPool::RenderTargetPool()
+  : mMemoryBudget(0)
+  , mMemoryUsage(0)
+  , mPeakMemoryUsage(0)
+  , mLeasedMemoryUsage(0)
+{}
+
+
+RenderTargetPool::~RenderTargetPool() {
+  trim();
+}
+
+
+size_t RenderTargetPool::formatMemorySize(const Format& format) {
+  size_t width, height;
+  GLenum type;
+  bool hasDepthBuffer;
+  std::tie(width, height, type, hasDepthBuffer) = format;
+
+  size_t texelSize = (type == GL_HALF_FLOAT_OES) ? 8 : 4;
+  size_t depthTexelSize = hasDepthBuffer ? 2 : 0;
+
+  return width * height * (texelSize + depthTexelSize);
+}
+
+
+RenderTargetPool::Lease RenderTargetPool::acquire(size_t width, size_t height,
+                                                  GLenum type,
+                                                  bool hasDepthBuffer)
+{
+  Format format(width, height, type, hasDepthBuffer);
+  size_t memorySize = formatMemorySize(format);
+  auto& idleTargets = mIdleRenderTargets[format];
+  RenderTarget target;
+
+  if (!idleTargets.empty()) {
+    target = idleTargets.back();
+    idleTargets.pop_back();
+
+    // Don't leak the previous lessee's contents
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glClear(hasDepthBuffer ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT
+                           : GL_COLOR_BUFFER_BIT);
+    assertNoGlError();
+  } else {
+    if (mMemoryBudget > 0 && mMemoryUsage + memorySize > mMemoryBudget)
+      trim();
+
+    if (mMemoryBudget > 0 && mMemoryUsage + memorySize > mMemoryBudget) {
+      std::cerr << "Warning: render targets exceed the GPU memory budget of "
+                << mMemoryBudget << " bytes\n";
+    }
+
+    target = createRenderTarget(format);
+    mMemoryUsage += memorySize;
+
+    if (mMemoryUsage > mPeakMemoryUsage)
+      mPeakMemoryUsage = mMemoryUsage;
+  }
+
+  mLeasedMemoryUsage += memorySize;
+
+  return Lease(this, format, target.texture, target.fbo, target.depthBuffer);
+}
+
+
+RenderTargetPool::RenderTarget RenderTargetPool::createRenderTarget(const Format& format) {
+  size_t width, height;
+  GLenum type;
+  bool hasDepthBuffer;
+  std::tie(width, height, type, hasDepthBuffer) = format;
+  RenderTarget target = {0, 0, 0};
+
+  // Prepare a texture
+  glActiveTexture(GL_TEXTURE3);
+  glGenTextures(1, &target.texture);
+  glBindTexture(GL_TEXTURE_2D, target.texture);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, type, 0);
+  assertNoGlError();
+
+  // Prepare a renderbuffer for depth testing
+  if (hasDepthBuffer) {
+    glGenRenderbuffers(1, &target.depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+    assertNoGlError();
+  }
+
+  // Prepare an FBO
+  glGenFramebuffers(1, &target.fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         target.texture, 0);
+
+  if (hasDepthBuffer) {
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, target.depthBuffer);
+  }
+
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+  assertNoGlError();
+
+  return target;
+}
+
+
+void RenderTargetPool::deleteRenderTarget(const Format& format,
+                                          const RenderTarget& target)
+{
+  glDeleteFramebuffers(1, &target.fbo);
+  glDeleteTextures(1, &target.texture);
+
+  if (target.depthBuffer != 0)
+    glDeleteRenderbuffers(1, &target.depthBuffer);
+
+  mMemoryUsage -= formatMemorySize(format);
+}
+
+
+void RenderTargetPool::returnRenderTarget(const Format& format,
+                                          const RenderTarget& target)
+{
+  mLeasedMemoryUsage -= formatMemorySize(format);
+  mIdleRenderTargets[format].push_back(target);
+}
+
+
+void RenderTargetPool::setMemoryBudget(size_t memoryBudget) {
+  mMemoryBudget = memoryBudget;
+}
+
+
+size_t RenderTargetPool::memoryUsage() const {
+  return mMemoryUsage;
+}
+
+
+size_t RenderTargetPool::peakMemoryUsage() const {
+  return mPeakMemoryUsage;
+}
+
+
+size_t RenderTargetPool::leasedMemoryUsage() const {
+  return mLeasedMemoryUsage;
+}
+
+
+void RenderTargetPool::trim() {
+  for (const auto& formatTargetsPair : mIdleRenderTargets) {
+    for (const auto& target : formatTargetsPair.second)
+      deleteRenderTarget(formatTargetsPair.first, target);
+  }
+
+  mIdleRenderTargets.clear();
+}
+
+
+namespace {
+
+// GL objects can't be used across contexts, so every context gets its
+// own default pool; pipelines may run on separate threads
+std::mutex defaultPoolsMutex;
+std::map<EGLContext, std::unique_ptr<RenderTargetPool>> defaultPools;
+
+} // end namespace
+
+
+RenderTargetPool& RenderTargetPool::defaultPool() {
+  std::lock_guard<std::mutex> lock(defaultPoolsMutex);
+  std::unique_ptr<RenderTargetPool>& pool = defaultPools[eglGetCurrentContext()];
+
+  if (!pool)
+    pool.reset(new RenderTargetPool());
+
+  return *pool;
+}
+
+
+void RenderTargetPool::releaseDefaultPool() {
+  std::lock_guard<std::mutex> lock(defaultPoolsMutex);
+  auto poolIt = defaultPools.find(eglGetCurrentContext());
+
+  if (poolIt == defaultPools.end())
+    return;
+
+  assert(poolIt->second->leasedMemoryUsage() == 0);
+  defaultPools.erase(poolIt);
+}
+
+
+} // end namespace gles_utils
+} // end namespace glipf
@@ -1,7 +1,9 @@
 #include <glipf/gles-utils/shader-builder.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
 
@@ -46,6 +48,53 @@ ShaderBuilder& ShaderBuilder::appendSourceFile(std::string filePath) {
 }
 
 
+ShaderBuilder& ShaderBuilder::appendFragmentStages(const std::vector<FragmentStage>& stages) {
+  appendSourceString("varying vec2 tcoord;\nuniform sampler2D tex;\n");
+
+  std::vector<std::string> includeFiles;
+
+  for (const auto& stage : stages) {
+    for (const auto& includeFile : stage.includeFiles) {
+      if (std::find(includeFiles.begin(), includeFiles.end(),
+                    includeFile) == includeFiles.end())
+      {
+        includeFiles.push_back(includeFile);
+        appendSourceFile(includeFile);
+      }
+    }
+  }
+
+  std::string mainBody;
+
+  for (const auto& stage : stages) {
+    appendSourceString(stage.defines);
+    appendSourceFile(stage.sourceFile);
+
+    // Undefine the stage's macros, so that they don't change the
+    // sources of the stages that follow
+    std::istringstream defines(stage.defines);
+    std::string directive, macroName, undefines;
+
+    while (defines >> directive) {
+      if (directive == "#define" && defines >> macroName)
+        undefines += "#undef " + macroName + "\n";
+
+      defines.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+    appendSourceString("\n" + undefines);
+    mainBody += "  if (!" + stage.functionName + "(color, tcoord))\n"
+                "    discard;\n";
+  }
+
+  return appendSourceString("\nvoid main(void) {\n"
+                            "  vec4 color = texture2D(tex, tcoord);\n" +
+                            mainBody +
+                            "  gl_FragColor = color;\n"
+                            "}\n");
+}
+
+
 GLuint ShaderBuilder::compile() {
   const GLchar* rawSourceStrings[mSourceStrings.size()];
 
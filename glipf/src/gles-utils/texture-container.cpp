@@ -12,6 +12,7 @@ namespace gles_utils {
 
 TextureContainer::TextureContainer(std::pair<size_t, size_t> dimensions)
   : mDimensions(dimensions)
+  , mProfiler(&utils::Profiler::defaultProfiler())
 {
   glGenTextures(1, &mTexture);
   glBindTexture(GL_TEXTURE_2D, mTexture);
@@ -29,6 +30,8 @@ TextureContainer::~TextureContainer() {
 
 
 void TextureContainer::uploadData(const void* frameData) {
+  utils::Profiler::Span uploadSpan(*mProfiler, "frame_upload");
+
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, mTexture);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, mDimensions.first, mDimensions.second,
@@ -42,5 +45,10 @@ GLuint TextureContainer::getTexture() const {
 }
 
 
+void TextureContainer::setProfiler(utils::Profiler& profiler) {
+  mProfiler = &profiler;
+}
+
+
 } // end namespace gles_utils
 } // end namespace glipf
@@ -0,0 +1,21 @@
+varying vec2 tcoord;
+uniform sampler2D tex;
+uniform sampler2D backgroundTexture;
+uniform sampler2D updateMaskTexture;
+uniform float adaptationRate;
+
+
+void main(void) {
+  vec3 background = texture2D(backgroundTexture, tcoord).rgb;
+
+#ifdef USE_UPDATE_MASK
+  // Keep the background under masked (e.g. tracked) areas unchanged
+  if (texture2D(updateMaskTexture, tcoord).r > 0.0) {
+    gl_FragColor = vec4(background, 1.0);
+    return;
+  }
+#endif
+
+  gl_FragColor = vec4(approach(background, texture2D(tex, tcoord).rgb,
+                               adaptationRate), 1.0);
+}
@@ -0,0 +1,29 @@
+precision highp float;
+
+attribute vec2 vertex;
+
+uniform sampler2D labelTexture;
+uniform sampler2D previousLabelTexture;
+
+varying vec4 pointColor;
+
+
+/*
+ * Scatter every texel whose label differs from the previous pass onto
+ * the single texel of the target, leaving it cleared once labelling has
+ * converged.
+ */
+void main(void) {
+  gl_PointSize = 1.0;
+
+  if (texture2D(labelTexture, vertex) ==
+      texture2D(previousLabelTexture, vertex))
+  {
+    // Outside of the clip volume
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    return;
+  }
+
+  pointColor = vec4(1.0);
+  gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,52 @@
+varying vec2 tcoord;
+
+uniform sampler2D labelTexture;
+uniform sampler2D boundingBoxTexture;
+uniform sampler2D areaTexture;
+uniform vec2 workingDimensions;
+uniform vec2 tileGridDimensions;
+
+
+/*
+ * Gather the component roots of TILE_SIZE x TILE_SIZE tiles of the
+ * working texture. Every tile is represented by ROOTS_PER_TILE slots of
+ * two horizontally adjacent texels: the bounding box of a root and that
+ * root's area counts. The k-th slot holds the k-th root of the tile in
+ * scan order; slots past the last root are left empty. As 8-connected
+ * components can't touch, no 2 x 2 block holds more than one root and
+ * ROOTS_PER_TILE slots are enough for every root of a tile.
+ */
+void main(void) {
+  vec2 outputCoord = floor(tcoord * vec2(2.0 * ROOTS_PER_TILE, 1.0) *
+                           tileGridDimensions);
+  vec2 tileOrigin = vec2(floor(outputCoord.x / (2.0 * ROOTS_PER_TILE)),
+                         outputCoord.y) * TILE_SIZE;
+  float slot = floor(mod(outputCoord.x, 2.0 * ROOTS_PER_TILE) / 2.0);
+  bool isAreaTexel = mod(outputCoord.x, 2.0) > 0.5;
+  vec4 boundingBox = vec4(0.0);
+  vec4 area = vec4(0.0);
+  float rootIndex = 0.0;
+
+  for (float i = 0.0; i < TILE_SIZE; ++i) {
+    for (float j = 0.0; j < TILE_SIZE; ++j) {
+      vec2 coord = tileOrigin + vec2(i, j);
+      vec2 texelCoord = (coord + 0.5) / workingDimensions;
+      vec4 label = texture2D(labelTexture, texelCoord);
+
+      // Texels past the edge are clamped to the edge and never match
+      if (label.a > 0.0 && labelRoot(label) == coord) {
+        if (rootIndex == slot) {
+          boundingBox = texture2D(boundingBoxTexture, texelCoord);
+          area = texture2D(areaTexture, texelCoord);
+        }
+
+        rootIndex++;
+      }
+    }
+  }
+
+  if (isAreaTexel)
+    gl_FragColor = area;
+  else
+    gl_FragColor = boundingBox;
+}
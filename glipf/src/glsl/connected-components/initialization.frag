@@ -0,0 +1,38 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+uniform vec2 inputTexelSize;
+uniform vec2 workingDimensions;
+uniform float maskBit;
+
+
+/*
+ * Label every working texel covering any foreground pixel of its
+ * SCALE x SCALE input block with its own coordinates. With a
+ * non-negative maskBit, only pixels with that bit set in their alpha
+ * mask count as foreground.
+ */
+void main(void) {
+  vec2 workingCoord = floor(tcoord * workingDimensions);
+  vec2 blockOrigin = workingCoord * SCALE;
+  bool isForeground = false;
+
+  for (float i = 0.0; i < SCALE; ++i) {
+    for (float j = 0.0; j < SCALE; ++j) {
+      vec2 inputCoord = (blockOrigin + vec2(i, j) + 0.5) * inputTexelSize;
+      float alpha = texture2D(tex, inputCoord).a;
+
+      if (maskBit < 0.0) {
+        if (alpha > 0.0)
+          isForeground = true;
+      } else if (bitmaskTest(floor(alpha * 255.0 + 0.5), maskBit)) {
+        isForeground = true;
+      }
+    }
+  }
+
+  if (isForeground)
+    gl_FragColor = vec4(workingCoord / 255.0, 0.0, 1.0);
+  else
+    gl_FragColor = vec4(0.0);
+}
@@ -0,0 +1,42 @@
+varying vec2 tcoord;
+
+uniform sampler2D labelTexture;
+uniform vec2 workingDimensions;
+
+
+/*
+ * Take over the lowest label among the 8-connected neighbours, then jump
+ * to the label of the texel that label points to.
+ */
+void main(void) {
+  vec4 label = texture2D(labelTexture, tcoord);
+
+  if (label.a == 0.0) {
+    gl_FragColor = vec4(0.0);
+    return;
+  }
+
+  vec2 texelSize = 1.0 / workingDimensions;
+  float key = labelKey(label);
+
+  for (float i = -1.0; i <= 1.0; ++i) {
+    for (float j = -1.0; j <= 1.0; ++j) {
+      vec4 neighbourLabel = texture2D(labelTexture,
+                                      tcoord + vec2(i, j) * texelSize);
+      float neighbourKey = labelKey(neighbourLabel);
+
+      if (neighbourLabel.a > 0.0 && neighbourKey < key) {
+        label = neighbourLabel;
+        key = neighbourKey;
+      }
+    }
+  }
+
+  vec4 rootLabel = texture2D(labelTexture,
+                             (labelRoot(label) + 0.5) * texelSize);
+
+  if (rootLabel.a > 0.0 && labelKey(rootLabel) < key)
+    label = rootLabel;
+
+  gl_FragColor = label;
+}
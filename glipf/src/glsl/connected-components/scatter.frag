@@ -0,0 +1,6 @@
+varying vec4 pointColor;
+
+
+void main(void) {
+  gl_FragColor = pointColor;
+}
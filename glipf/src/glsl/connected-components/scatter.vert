@@ -0,0 +1,46 @@
+precision highp float;
+
+attribute vec2 vertex;
+
+uniform sampler2D labelTexture;
+uniform vec2 workingDimensions;
+uniform vec2 coordinateAxis;
+uniform float isMaximum;
+
+varying vec4 pointColor;
+
+
+/*
+ * Scatter every labelled texel onto the root of its component.
+ *
+ * With COUNT_AREA defined, every texel adds one unit to one of the
+ * channels of the root. Otherwise the texel's coordinate along
+ * coordinateAxis is written, with a depth that lets the depth test keep
+ * the minimum (or maximum if isMaximum is 1) coordinate.
+ */
+void main(void) {
+  vec4 label = texture2D(labelTexture, vertex);
+  gl_PointSize = 1.0;
+
+  if (label.a == 0.0) {
+    // Outside of the clip volume
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    return;
+  }
+
+  vec2 coord = floor(vertex * workingDimensions);
+  vec2 root = floor(label.rg * 255.0 + 0.5);
+  vec2 rootPosition = (root + 0.5) / workingDimensions;
+
+#ifdef COUNT_AREA
+  // Spread the count over the channels to delay 8-bit saturation
+  float channel = mod(coord.x + coord.y, 4.0);
+  pointColor = vec4(equal(vec4(channel), vec4(0.0, 1.0, 2.0, 3.0))) / 255.0;
+  gl_Position = vec4(rootPosition * 2.0 - 1.0, 0.0, 1.0);
+#else
+  float axisCoord = dot(coord, coordinateAxis);
+  float depth = mix(axisCoord / 256.0, 1.0 - axisCoord / 256.0, isMaximum);
+  pointColor = vec4(axisCoord / 255.0);
+  gl_Position = vec4(rootPosition * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+#endif
+}
@@ -4,18 +4,16 @@ varying vec2 tcoord;
 uniform sampler2D tex;
 
 
+/*
+ * Count model pixels and the foreground among them. Foreground is
+ * weighted by alpha, which is the foreground fraction of the block when
+ * sampling a reduced pyramid level and 1 at full resolution.
+ */
 void main(void) {
-  if (texture2D(tex, tcoord).a != 0.0) {
-    if (vColor.r > 0.0) {
-      gl_FragColor = vec4(1.0, 1.0, 0.0, 0.0);
-    } else {
-      gl_FragColor = vec4(0.0, 0.0, 1.0, 1.0);
-    }
-  } else {
-    if (vColor.r > 0.0) {
-      gl_FragColor = vec4(1.0, 0.0, 0.0, 0.0);
-    } else {
-      gl_FragColor = vec4(0.0, 0.0, 1.0, 0.0);
-    }
-  }
+  float foreground = texture2D(tex, tcoord).a;
+
+  if (vColor.r > 0.0)
+    gl_FragColor = vec4(1.0, foreground, 0.0, 0.0);
+  else
+    gl_FragColor = vec4(0.0, 0.0, 1.0, foreground);
 }
@@ -0,0 +1,17 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+
+
+/*
+ * Convert the foreground of a pyramid level to HSV, keeping its alpha.
+ * Frames are stored in BGR order, like everywhere else.
+ */
+void main(void) {
+  vec4 color = texture2D(tex, tcoord);
+
+  if (color.a == 0.0)
+    discard;
+
+  gl_FragColor = vec4(rgb2hsv(color.bgr), color.a);
+}
@@ -0,0 +1,37 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+uniform vec2 inputTexelSize;
+
+
+/*
+ * Halve the resolution of a foreground texture. The color is the
+ * average of the foreground texels of each 2x2 block and alpha the
+ * average alpha, i.e. the fraction of the block that is foreground.
+ * HSV colors (HSV_INPUT defined) can't be averaged because hue wraps
+ * around, so the most opaque texel's color is kept instead. Blocks
+ * without foreground are left cleared.
+ */
+void main(void) {
+  vec4 sum = vec4(0.0);
+  vec4 mostOpaqueColor = vec4(0.0);
+
+  for (float i = -0.5; i < 1.0; ++i) {
+    for (float j = -0.5; j < 1.0; ++j) {
+      vec4 color = texture2D(tex, tcoord + vec2(i, j) * inputTexelSize);
+      sum += vec4(color.rgb * color.a, color.a);
+
+      if (color.a > mostOpaqueColor.a)
+        mostOpaqueColor = color;
+    }
+  }
+
+  if (sum.a == 0.0)
+    discard;
+
+#ifdef HSV_INPUT
+  gl_FragColor = vec4(mostOpaqueColor.rgb, sum.a / 4.0);
+#else
+  gl_FragColor = vec4(sum.rgb / sum.a, sum.a / 4.0);
+#endif
+}
@@ -3,9 +3,33 @@ varying vec4 vColor;
 
 uniform sampler2D tex;
 
+#ifdef OCCLUSION_CULLING
+uniform sampler2D occluderTexture;
+
+varying float vOwnOccluderNumber;
+varying float vDepth;
+#endif
+
 
 void main(void) {
-  vec3 colorHsv = rgb2hsv(texture2D(tex, tcoord).rgb);
+#ifdef OCCLUSION_CULLING
+  // Skip pixels hidden behind a nearer model other than the one this
+  // model belongs to
+  vec4 occluder = texture2D(occluderTexture, tcoord);
+  float occluderNumber = floor(occluder.r * 255.0 + 0.5);
+
+  if (occluderNumber != 0.0 &&
+      abs(occluderNumber - vOwnOccluderNumber) > 0.5 &&
+      decodeDepth(occluder.gb) < vDepth)
+    discard;
+#endif
+
+#ifdef HSV_INPUT
+  vec3 colorHsv = texture2D(tex, tcoord).rgb;
+#else
+  // Frames are stored in BGR order
+  vec3 colorHsv = rgb2hsv(texture2D(tex, tcoord).bgr);
+#endif
 
   if (colorHsv.b == 0.0 || colorHsv.b == 1.0)
     discard;
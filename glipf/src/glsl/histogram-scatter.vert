@@ -1,14 +1,29 @@
 precision highp float;
 
-attribute vec3 vertex;
+attribute float pointIndex;
 
 uniform ivec3 gridDimensions;
+uniform vec2 atlasDimensions;
+uniform vec2 cellOrigin;
+uniform float channelPair;
+// Offset of the model's bounding box within its cell, the number of
+// sample columns and the step between samples
+uniform vec4 modelBbox;
 uniform sampler2D tex;
 
-varying vec3 pointCoord;
+// Channel the point is counted in; consecutive points take turns so
+// that no channel gets more than a quarter of them
+varying float channel;
 
 
 void main(void) {
+  // Lay the point out row by row over the bounding box, skipping
+  // pixels between samples
+  float row = floor((pointIndex + 0.5) / modelBbox.z);
+  vec2 texel = cellOrigin + modelBbox.xy +
+               vec2(pointIndex - row * modelBbox.z, row) * modelBbox.w;
+  vec3 vertex = vec3((texel + vec2(0.5)) / atlasDimensions, channelPair);
+
   vec4 color = texture2D(tex, vertex.xy);
   vec2 saturationValue;
 
@@ -27,7 +42,7 @@ void main(void) {
                            vertex.z,
                        floor(vertex.y * float(gridDimensions.y)));
     vec2 bucket = multiplier * offset - vec2(1.0) + saturationValue;
-    pointCoord = vertex;
+    channel = mod(pointIndex, 4.0);
 
     gl_Position = vec4(bucket, 1.0, 1.0);
     gl_PointSize = 1.0;
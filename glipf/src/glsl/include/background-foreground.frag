@@ -3,6 +3,28 @@
  */
 
 
+/*
+ * Compare a frame color against the background color at the same
+ * coordinate and return the HSV foreground.
+ *
+ * @param referenceColor color of the reference (background) frame
+ * @param frameColor color of the frame that should have its background
+ *                   subtracted
+ * @return true if frameColor is part of the foreground, false otherwise
+ */
+bool isForegroundColor(in vec3 referenceColor, in vec3 frameColor,
+                       out vec3 foregroundHsv)
+{
+  foregroundHsv = rgb2hsv(frameColor.bgr);
+  vec3 referenceColorHsv = rgb2hsv(referenceColor.bgr);
+
+  float diff = length(vec3(0.0, 1.0, 1.0) *
+                      abs(referenceColorHsv - foregroundHsv));
+
+  return diff > 0.25;
+}
+
+
 /*
  * Subtract background from a frame and return the HSV foreground.
  *
@@ -17,14 +39,9 @@ bool subtractBackgroundHsv(in sampler2D referenceFrameTexture,
                            in sampler2D frameTexture, in vec2 tcoord,
                            out vec3 foregroundHsv)
 {
-  foregroundHsv = rgb2hsv(texture2D(frameTexture, tcoord).bgr);
-  vec3 referenceColorHsv = rgb2hsv(texture2D(referenceFrameTexture,
-                                             tcoord).bgr);
-
-  float diff = length(vec3(0.0, 1.0, 1.0) *
-                      abs(referenceColorHsv - foregroundHsv));
-
-  return diff > 0.25;
+  return isForegroundColor(texture2D(referenceFrameTexture, tcoord).rgb,
+                           texture2D(frameTexture, tcoord).rgb,
+                           foregroundHsv);
 }
 
 
@@ -0,0 +1,35 @@
+/*
+ * Bitwise operations on masks of up to 8 bits stored as integer-valued
+ * floats, for GLSL versions without integer bit operators.
+ */
+
+
+/*
+ * Check whether the bit with the given index is set in a mask.
+ */
+bool bitmaskTest(in float mask, in float bitIndex) {
+  return mod(floor(mask / exp2(bitIndex)), 2.0) >= 1.0;
+}
+
+
+/*
+ * Compute the bitwise AND (isIntersection true) or OR of two masks.
+ */
+float bitmaskCombine(in float mask1, in float mask2, in bool isIntersection) {
+  float result = 0.0;
+  float bitValue = 1.0;
+
+  for (int i = 0; i < 8; ++i) {
+    float bit1 = mod(floor(mask1 / bitValue), 2.0);
+    float bit2 = mod(floor(mask2 / bitValue), 2.0);
+
+    if (isIntersection)
+      result += bitValue * bit1 * bit2;
+    else
+      result += bitValue * max(bit1, bit2);
+
+    bitValue *= 2.0;
+  }
+
+  return result;
+}
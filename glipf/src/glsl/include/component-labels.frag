@@ -0,0 +1,24 @@
+/*
+ * Functions related to connected component labels.
+ *
+ * A label texel stores the integer working texture coordinates of the
+ * root of its component, divided by 255, in RG and the foreground flag
+ * in A. Roots are the texels with the lowest label key in a component
+ * and are labelled with their own coordinates.
+ */
+
+
+/*
+ * Decode the integer root coordinates stored in a label.
+ */
+vec2 labelRoot(in vec4 label) {
+  return floor(label.rg * 255.0 + 0.5);
+}
+
+
+/*
+ * Compute the key by which labels are ordered.
+ */
+float labelKey(in vec4 label) {
+  return dot(labelRoot(label), vec2(1.0, 256.0));
+}
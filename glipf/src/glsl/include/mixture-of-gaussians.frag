@@ -0,0 +1,160 @@
+/*
+ * Functions related to per-pixel mixtures of Gaussians.
+ *
+ * A mixture of GAUSSIAN_COUNT isotropic Gaussians is stored in
+ * GAUSSIAN_COUNT textures holding the mean color of a Gaussian in RGB
+ * and its weight in A, plus a deviation texture holding the standard
+ * deviation of Gaussian i in channel i. Requires running-average.frag.
+ */
+
+
+#define INITIAL_WEIGHT 0.05
+#define INITIAL_DEVIATION (15.0 / 255.0)
+#define MIN_DEVIATION (4.0 / 255.0)
+#define MATCH_THRESHOLD 2.5
+
+uniform sampler2D gaussianTextures[GAUSSIAN_COUNT];
+uniform sampler2D deviationTexture;
+uniform float learningRate;
+uniform float backgroundRatio;
+
+
+/*
+ * Load the mixture of Gaussians at a coordinate.
+ */
+void loadMixture(in vec2 tcoord, out vec4 gaussians[GAUSSIAN_COUNT],
+                 out vec4 deviations)
+{
+  for (int i = 0; i < GAUSSIAN_COUNT; ++i)
+    gaussians[i] = texture2D(gaussianTextures[i], tcoord);
+
+  deviations = max(texture2D(deviationTexture, tcoord), vec4(MIN_DEVIATION));
+}
+
+
+/*
+ * Find the highest ranked Gaussian that matches a color.
+ *
+ * Gaussians are ranked by weight / deviation, so heavy and narrow
+ * Gaussians rank first.
+ *
+ * @return index of the matching Gaussian or -1 if none matches
+ */
+int findMatchingGaussian(in vec3 color, in vec4 gaussians[GAUSSIAN_COUNT],
+                         in vec4 deviations, out float ranks[GAUSSIAN_COUNT])
+{
+  int match = -1;
+  float matchRank = -1.0;
+
+  for (int i = 0; i < GAUSSIAN_COUNT; ++i) {
+    vec3 delta = color - gaussians[i].rgb;
+    float maxDistance = MATCH_THRESHOLD * deviations[i];
+    ranks[i] = gaussians[i].a / deviations[i];
+
+    if (gaussians[i].a > 0.0 &&
+        dot(delta, delta) < 3.0 * maxDistance * maxDistance &&
+        ranks[i] > matchRank)
+    {
+      match = i;
+      matchRank = ranks[i];
+    }
+  }
+
+  return match;
+}
+
+
+/*
+ * Determine whether a Gaussian is part of the background.
+ *
+ * Instead of sorting, a Gaussian is part of the background if the total
+ * weight of the Gaussians ranked above it is below backgroundRatio.
+ */
+bool isBackgroundGaussian(in int index, in vec4 gaussians[GAUSSIAN_COUNT],
+                          in float ranks[GAUSSIAN_COUNT])
+{
+  float indexRank = 0.0;
+  float higherRankedWeight = 0.0;
+
+  for (int i = 0; i < GAUSSIAN_COUNT; ++i) {
+    if (i == index)
+      indexRank = ranks[i];
+  }
+
+  for (int i = 0; i < GAUSSIAN_COUNT; ++i) {
+    if (ranks[i] > indexRank || (ranks[i] == indexRank && i < index))
+      higherRankedWeight += gaussians[i].a;
+  }
+
+  return higherRankedWeight < backgroundRatio;
+}
+
+
+/*
+ * Determine whether a color belongs to the background modelled by a
+ * mixture of Gaussians.
+ */
+bool isBackgroundColor(in vec3 color, in vec4 gaussians[GAUSSIAN_COUNT],
+                       in vec4 deviations)
+{
+  float ranks[GAUSSIAN_COUNT];
+  int match = findMatchingGaussian(color, gaussians, deviations, ranks);
+
+  return match >= 0 && isBackgroundGaussian(match, gaussians, ranks);
+}
+
+
+/*
+ * Update a mixture of Gaussians with a new color sample.
+ *
+ * The matching Gaussian moves towards the color and gains weight while
+ * the others lose weight. If no Gaussian matches, the lowest ranked one
+ * is replaced by a new Gaussian centred on the color.
+ */
+void updateMixture(in vec3 color, inout vec4 gaussians[GAUSSIAN_COUNT],
+                   inout vec4 deviations)
+{
+  float ranks[GAUSSIAN_COUNT];
+  int match = findMatchingGaussian(color, gaussians, deviations, ranks);
+
+  if (match >= 0) {
+    for (int i = 0; i < GAUSSIAN_COUNT; ++i) {
+      if (i == match) {
+        float distance = length(color - gaussians[i].rgb) / sqrt(3.0);
+        deviations[i] = approach(vec3(deviations[i]), vec3(distance),
+                                 learningRate).x;
+        gaussians[i] = vec4(approach(gaussians[i].rgb, color, learningRate),
+                            approach(vec3(gaussians[i].a), vec3(1.0),
+                                     learningRate).x);
+      } else {
+        gaussians[i].a = approach(vec3(gaussians[i].a), vec3(0.0),
+                                  learningRate).x;
+      }
+    }
+  } else {
+    int replaced = 0;
+    float replacedRank = ranks[0];
+    float weightSum = INITIAL_WEIGHT;
+
+    for (int i = 1; i < GAUSSIAN_COUNT; ++i) {
+      if (ranks[i] < replacedRank) {
+        replaced = i;
+        replacedRank = ranks[i];
+      }
+    }
+
+    for (int i = 0; i < GAUSSIAN_COUNT; ++i) {
+      if (i == replaced) {
+        gaussians[i] = vec4(color, INITIAL_WEIGHT);
+        deviations[i] = INITIAL_DEVIATION;
+      } else {
+        weightSum += gaussians[i].a;
+      }
+    }
+
+    // Matched updates keep weights summing to about one on their own;
+    // only a replacement needs renormalising
+    for (int i = 0; i < GAUSSIAN_COUNT; ++i)
+      gaussians[i].a /= weightSum;
+  }
+}
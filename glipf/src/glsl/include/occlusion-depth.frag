@@ -0,0 +1,22 @@
+/*
+ * Functions storing the depth of the nearest model in two 8-bit color
+ * channels of the model occlusion texture.
+ */
+
+
+/*
+ * Split a depth in [0, 1] into a coarse and a fine 8-bit part.
+ */
+vec2 encodeDepth(in float depth) {
+  float scaledDepth = depth * 255.0;
+
+  return vec2(floor(scaledDepth) / 255.0, fract(scaledDepth));
+}
+
+
+/*
+ * Restore a depth split by encodeDepth().
+ */
+float decodeDepth(in vec2 encodedDepth) {
+  return dot(encodedDepth, vec2(1.0, 1.0 / 255.0));
+}
@@ -0,0 +1,28 @@
+/*
+ * Functions related to running averages of pixel values.
+ */
+
+
+/*
+ * Move a value towards a target by a fraction of the distance between
+ * them.
+ *
+ * Unless the rate is 0, every component moves by at least one 8-bit
+ * quantisation step (or the remaining distance, if smaller), so that
+ * running averages kept in 8-bit textures keep converging at low rates
+ * instead of stalling. Rates below 1/255 therefore behave like a fixed
+ * step of 1/255 per update.
+ *
+ * @param value current value
+ * @param target value to move towards
+ * @param rate fraction of the distance to cover, in [0, 1]
+ * @return value moved towards target
+ */
+vec3 approach(in vec3 value, in vec3 target, in float rate) {
+  vec3 diff = target - value;
+  vec3 absDiff = abs(diff);
+
+  vec3 minStep = rate > 0.0 ? min(absDiff, vec3(1.0 / 255.0)) : vec3(0.0);
+
+  return value + sign(diff) * max(absDiff * rate, minStep);
+}
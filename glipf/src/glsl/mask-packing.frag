@@ -0,0 +1,56 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+uniform float inputWidth;
+uniform float packedWidth;
+uniform float maskBit;
+
+
+/*
+ * Check whether the input pixel in column x of the current row belongs
+ * to the mask: any non-zero alpha, or with a non-negative maskBit, that
+ * bit of the alpha mask.
+ */
+bool isMaskPixel(in float x) {
+  if (x >= inputWidth)
+    return false;
+
+  float alpha = texture2D(tex, vec2((x + 0.5) / inputWidth, tcoord.y)).a;
+
+  if (maskBit < 0.0)
+    return alpha > 0.0;
+
+  return bitmaskTest(floor(alpha * 255.0 + 0.5), maskBit);
+}
+
+
+/*
+ * Pack 8 horizontally adjacent mask pixels, starting at column x, into
+ * one byte with the leftmost pixel in the lowest bit.
+ */
+float packByte(in float x) {
+  float value = 0.0;
+  float bitValue = 1.0;
+
+  for (int i = 0; i < 8; ++i) {
+    if (isMaskPixel(x + float(i)))
+      value += bitValue;
+
+    bitValue *= 2.0;
+  }
+
+  return value / 255.0;
+}
+
+
+/*
+ * Fold 32 horizontally adjacent mask pixels into the four channels of
+ * one output texel, so a row of packed texels read back as bytes forms
+ * a bitset of the input row.
+ */
+void main(void) {
+  float x = floor(tcoord.x * packedWidth) * 32.0;
+
+  gl_FragColor = vec4(packByte(x), packByte(x + 8.0), packByte(x + 16.0),
+                      packByte(x + 24.0));
+}
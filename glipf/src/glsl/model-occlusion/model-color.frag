@@ -1,6 +1,11 @@
 varying vec4 fragColor;
 
 
+/*
+ * Store the model number in red and the depth of the nearest model in
+ * green and blue, so that later passes can tell which model hides a
+ * pixel and how near it is.
+ */
 void main(void) {
-  gl_FragColor = vec4(fragColor.x, fragColor.yz * 8.0, 1.0);
+  gl_FragColor = vec4(fragColor.x, encodeDepth(gl_FragCoord.z), 1.0);
 }
@@ -0,0 +1,19 @@
+precision highp float;
+
+flat in uint fragModelNumber;
+
+layout(location = 0) out vec4 occlusionColor;
+layout(location = 1) out uvec2 modelNumberDepth;
+
+
+/*
+ * GLES 3 counterpart of model-color.frag. The occlusion texture keeps
+ * its 8-bit layout for the passes sampling it, while the exact model
+ * number and a 16-bit depth go to an integer target for readback.
+ */
+void main(void) {
+  occlusionColor = vec4(float(min(fragModelNumber, 255u)) / 255.0,
+                        encodeDepth(gl_FragCoord.z), 1.0);
+  modelNumberDepth = uvec2(fragModelNumber,
+                           uint(gl_FragCoord.z * 65535.0 + 0.5));
+}
@@ -0,0 +1,24 @@
+in vec4 vertex;
+in float modelNumber;
+
+flat out uint fragModelNumber;
+
+uniform vec2 viewportDimensions;
+uniform mat4 projectionMatrix;
+
+
+/*
+ * GLES 3 counterpart of transformation.vert, passing the model number on
+ * as an integer.
+ */
+void main(void) {
+  vec4 projectedPosition = projectionMatrix * vertex;
+  vec2 normalizedPosition = vec2(projectedPosition.x / projectedPosition.z,
+                                 projectedPosition.y / projectedPosition.z);
+  normalizedPosition /= viewportDimensions;
+
+  gl_Position = vec4(-1.0 + normalizedPosition.x * 2.0,
+                     -1.0 + normalizedPosition.y * 2.0,
+                     projectedPosition.z / 100000.0, 1.0);
+  fragModelNumber = uint(modelNumber);
+}
@@ -0,0 +1,21 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+
+
+void main(void) {
+  vec4 color = texture2D(tex, tcoord);
+  vec4 gaussians[GAUSSIAN_COUNT];
+  vec4 deviations;
+  loadMixture(tcoord, gaussians, deviations);
+
+  if (isBackgroundColor(color.rgb, gaussians, deviations))
+    discard;
+
+#ifdef HSV_OUTPUT
+  // Frames hold BGR data
+  gl_FragColor = vec4(rgb2hsv(color.bgr), 1.0);
+#else
+  gl_FragColor = color;
+#endif
+}
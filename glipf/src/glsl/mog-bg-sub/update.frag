@@ -0,0 +1,41 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+uniform sampler2D updateMaskTexture;
+
+
+/*
+ * Each pass computes the whole updated mixture but only outputs the
+ * texture selected by OUTPUT_INDEX: Gaussian OUTPUT_INDEX or, if
+ * OUTPUT_INDEX equals GAUSSIAN_COUNT, the deviation texture.
+ */
+void main(void) {
+  vec3 color = texture2D(tex, tcoord).rgb;
+  vec4 gaussians[GAUSSIAN_COUNT];
+  vec4 deviations;
+
+#ifdef INITIALIZE_MODEL
+  gaussians[0] = vec4(color, 1.0);
+
+  for (int i = 1; i < GAUSSIAN_COUNT; ++i)
+    gaussians[i] = vec4(0.0);
+
+  deviations = vec4(INITIAL_DEVIATION);
+#else
+  loadMixture(tcoord, gaussians, deviations);
+
+#ifdef USE_UPDATE_MASK
+  // Keep the model under masked (e.g. tracked) areas unchanged
+  if (texture2D(updateMaskTexture, tcoord).r == 0.0)
+    updateMixture(color, gaussians, deviations);
+#else
+  updateMixture(color, gaussians, deviations);
+#endif
+#endif
+
+#if OUTPUT_INDEX < GAUSSIAN_COUNT
+  gl_FragColor = gaussians[OUTPUT_INDEX];
+#else
+  gl_FragColor = deviations;
+#endif
+}
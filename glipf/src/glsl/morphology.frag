@@ -0,0 +1,67 @@
+varying vec2 tcoord;
+
+uniform sampler2D tex;
+uniform vec2 texelStep;
+
+
+#ifdef ERODE
+const bool isErosion = true;
+#else
+const bool isErosion = false;
+#endif
+
+
+/*
+ * Combine the alpha values of two texels: the minimum for erosion and
+ * the maximum for dilation, or with BITMASK defined, the bitwise AND
+ * or OR of alpha values holding per-threshold masks.
+ */
+float combineAlpha(in float alpha1, in float alpha2) {
+#ifdef BITMASK
+  float mask = bitmaskCombine(floor(alpha1 * 255.0 + 0.5),
+                              floor(alpha2 * 255.0 + 0.5), isErosion);
+  return mask / 255.0;
+#else
+  return isErosion ? min(alpha1, alpha2) : max(alpha1, alpha2);
+#endif
+}
+
+
+/*
+ * One separable pass of erosion (ERODE defined) or dilation of the
+ * alpha channel, with a kernel of 2 * KERNEL_RADIUS + 1 texels along
+ * texelStep. Erosion carries the color of the center texel through so
+ * that pixels restored by a later pass get their original color back.
+ * Dilation gives pixels it turns on the color of the nearest texel that
+ * was already on, instead of the color of the background.
+ */
+void main(void) {
+  vec4 color = texture2D(tex, tcoord);
+  float alpha = color.a;
+  vec3 foregroundColor = color.rgb;
+  bool hasForegroundColor = color.a > 0.0;
+
+  for (int i = 1; i <= KERNEL_RADIUS; ++i) {
+    vec2 offset = float(i) * texelStep;
+    vec4 previousColor = texture2D(tex, tcoord - offset);
+    vec4 nextColor = texture2D(tex, tcoord + offset);
+
+    alpha = combineAlpha(alpha, combineAlpha(previousColor.a, nextColor.a));
+
+    if (!hasForegroundColor && previousColor.a > 0.0) {
+      foregroundColor = previousColor.rgb;
+      hasForegroundColor = true;
+    } else if (!hasForegroundColor && nextColor.a > 0.0) {
+      foregroundColor = nextColor.rgb;
+      hasForegroundColor = true;
+    }
+  }
+
+#ifdef DISCARD_BACKGROUND
+  // Leave background pixels cleared, as background subtraction does
+  if (alpha == 0.0)
+    discard;
+#endif
+
+  gl_FragColor = vec4(isErosion ? color.rgb : foregroundColor, alpha);
+}
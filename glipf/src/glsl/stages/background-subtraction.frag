@@ -0,0 +1,21 @@
+uniform sampler2D referenceFrameTexture;
+
+
+/*
+ * Keep the foreground of a frame, either in its original colors or,
+ * with HSV_OUTPUT defined, as HSV computed once per pixel for all
+ * later histogram passes.
+ */
+bool backgroundSubtraction(inout vec4 color, in vec2 tcoord) {
+  vec3 foregroundHsv;
+
+  if (!isForegroundColor(texture2D(referenceFrameTexture, tcoord).rgb,
+                         color.rgb, foregroundHsv))
+    return false;
+
+#ifdef HSV_OUTPUT
+  color = vec4(foregroundHsv, 1.0);
+#endif
+
+  return true;
+}
@@ -0,0 +1,21 @@
+bool colorSpaceConversion(inout vec4 color, in vec2 tcoord) {
+  // Currently, all color spaces are first converted to RGB
+#if defined(INPUT_COLOR_SPACE_BGR)
+  color.rgb = color.bgr;
+#elif defined(INPUT_COLOR_SPACE_YUV)
+  color.rgb = yuv2rgb(color.rgb);
+#elif defined(INPUT_COLOR_SPACE_HSV)
+  color.rgb = hsv2rgb(color.rgb);
+#endif
+
+  // And then from RGB to the target color space
+#if defined(OUTPUT_COLOR_SPACE_YUV)
+  color.rgb = rgb2yuv(color.rgb);
+#elif defined(OUTPUT_COLOR_SPACE_HSV)
+  color.rgb = rgb2hsv(color.rgb);
+#elif defined(OUTPUT_COLOR_SPACE_BGR)
+  color.rgb = color.bgr;
+#endif
+
+  return true;
+}
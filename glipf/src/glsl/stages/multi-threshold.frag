@@ -0,0 +1,31 @@
+uniform vec3 lowerHsvThresholds[THRESHOLD_COUNT];
+uniform vec3 upperHsvThresholds[THRESHOLD_COUNT];
+
+
+/*
+ * Test a pixel against all HSV ranges at once. Bit i of the alpha
+ * value, scaled to [0, 255], is set when the pixel falls into range i;
+ * pixels outside every range are discarded. Colours keep the frame's BGR
+ * order.
+ */
+bool multiThreshold(inout vec4 color, in vec2 tcoord) {
+  vec3 hsvColor = rgb2hsv(color.bgr);
+  float mask = 0.0;
+  float bitValue = 1.0;
+
+  for (int i = 0; i < THRESHOLD_COUNT; ++i) {
+    bvec3 lowerThreshold = bvec3(step(lowerHsvThresholds[i], hsvColor));
+    bvec3 upperThreshold = bvec3(step(hsvColor, upperHsvThresholds[i]));
+
+    if (all(lowerThreshold) && all(upperThreshold))
+      mask += bitValue;
+
+    bitValue *= 2.0;
+  }
+
+  if (mask == 0.0)
+    return false;
+
+  color.a = mask / 255.0;
+  return true;
+}
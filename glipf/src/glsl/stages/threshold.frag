@@ -0,0 +1,16 @@
+uniform vec3 lowerHsvThreshold;
+uniform vec3 upperHsvThreshold;
+
+
+bool threshold(inout vec4 color, in vec2 tcoord) {
+  vec3 hsvColor = rgb2hsv(color.bgr);
+  bvec3 lowerThreshold = bvec3(step(lowerHsvThreshold, hsvColor));
+  bvec3 upperThreshold = bvec3(step(hsvColor, upperHsvThreshold));
+
+  if (!all(lowerThreshold) || !all(upperThreshold))
+    return false;
+
+  // Keep the frame's BGR order for later stages
+  color.a = 1.0;
+  return true;
+}
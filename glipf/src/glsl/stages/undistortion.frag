@@ -0,0 +1,18 @@
+uniform sampler2D remapTexture;
+
+
+/*
+ * Sample the distorted frame at the position the remap texture holds
+ * for this pixel. Coordinates are 16-bit fixed-point texture
+ * coordinates, split into high and low bytes: x in red and green, y in
+ * blue and alpha, and need high precision. The input is resampled
+ * rather than transformed, so the stage can only come first in a chain.
+ */
+bool undistortion(inout vec4 color, in vec2 tcoord) {
+  highp vec4 remap = texture2D(remapTexture, tcoord);
+  highp vec2 sourceCoord = vec2(dot(remap.rg, vec2(255.0 * 256.0, 255.0)),
+                                dot(remap.ba, vec2(255.0 * 256.0, 255.0))) / 65535.0;
+
+  color = texture2D(tex, sourceCoord);
+  return true;
+}
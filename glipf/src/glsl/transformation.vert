@@ -5,6 +5,13 @@ attribute vec2 cellOffset;
 varying vec4 vColor;
 varying vec2 tcoord;
 
+#ifdef OCCLUSION_CULLING
+attribute float ownOccluderNumber;
+
+varying float vOwnOccluderNumber;
+varying float vDepth;
+#endif
+
 uniform vec2 viewportDimensions;
 uniform mat4 projectionMatrix;
 
@@ -21,4 +28,10 @@ void main(void) {
   gl_Position = vec4(cellPosition, 1, 1);
   vColor = vertexColor;
   tcoord = normalizedPosition;
+
+#ifdef OCCLUSION_CULLING
+  // Depth the model would have in the model occlusion texture
+  vOwnOccluderNumber = ownOccluderNumber;
+  vDepth = 0.5 * projectedPosition.z / 100000.0 + 0.5;
+#endif
 }
@@ -1,28 +1,18 @@
 precision highp float;
 
+#ifndef UNIT_VALUE
 #define UNIT_VALUE 1.0 / 256.0
+#endif
 
-#define STEP_SIZE_X (1.0 / 640.0)
-#define STEP_SIZE_Y (1.0 / 480.0)
-#define HALF_STEP_SIZE_X (1.0 / 1280.0)
-#define HALF_STEP_SIZE_Y (1.0 / 960.0)
-
-varying vec3 pointCoord;
-
-
-float rand(vec2 co){
-  return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
-}
+varying float channel;
 
 
 void main(void) {
-  float randVal = rand(pointCoord.xy);
-
-  if (randVal < 0.25)
+  if (channel < 0.5)
     gl_FragColor = vec4(UNIT_VALUE, 0.0, 0.0, 0.0);
-  else if (randVal < 0.5)
+  else if (channel < 1.5)
     gl_FragColor = vec4(0.0, UNIT_VALUE, 0.0, 0.0);
-  else if (randVal < 0.75)
+  else if (channel < 2.5)
     gl_FragColor = vec4(0.0, 0.0, UNIT_VALUE, 0.0);
   else
     gl_FragColor = vec4(0.0, 0.0, 0.0, UNIT_VALUE);
@@ -14,12 +14,22 @@ enum VertexAttributeLocations : GLuint {
 
 
 BackgroundSubtractionProcessor::BackgroundSubtractionProcessor(const sources::FrameProperties& frameProperties,
-                                                               const void* referenceFrameData)
+                                                               const void* referenceFrameData,
+                                                               float adaptationRate,
+                                                               bool hasHsvOutput)
   : GlesProcessor(frameProperties)
   , mGlslProgram(0)
   , mReferenceFrameTexture(0)
   , mResultTexture(0)
   , mResultFbo(0)
+  , mAdaptationRate(adaptationRate)
+  , mHasHsvOutput(hasHsvOutput)
+  , mUpdateGlslProgram(0)
+  , mMaskedUpdateGlslProgram(0)
+  , mUpdateMaskTexture(0)
+  , mBackgroundTextureFboPairs{{0, 0}, {0, 0}}
+  , mNextBackgroundIndex(0)
+  , mBackgroundTexture(0)
 {
   // Prepare a reference frame texture image
   glActiveTexture(GL_TEXTURE1);
@@ -34,64 +44,166 @@ BackgroundSubtractionProcessor::BackgroundSubtractionProcessor(const sources::Fr
                GL_UNSIGNED_BYTE, referenceFrameData);
   assertNoGlError();
 
-  mGlslProgram = gles_utils::GlslProgramBuilder()
-    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
-                    .appendSourceFile("glsl/standard.vert")
-                    .compile())
-    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
-                    .appendSourceFile("glsl/include/color-space.frag")
-                    .appendSourceFile("glsl/include/background-foreground.frag")
-                    .appendSourceFile("glsl/background-subtraction.frag")
-                    .compile())
-    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
-    .link();
+  // The reference frame is the background until it's first updated
+  mBackgroundTexture = mReferenceFrameTexture;
+  mResultSet["background_texture"] = mBackgroundTexture;
 
-  glUseProgram(mGlslProgram);
-  glUniform1i(glGetUniformLocation(mGlslProgram, "tex"), 0);
-  glUniform1i(glGetUniformLocation(mGlslProgram, "referenceFrameTexture"), 1);
+  // The background, the stage's only texture, is sampled from unit 1
+  mGlslProgram = buildFragmentStageGlslProgram({subtractionStage()},
+                                               VertexAttributeLocations::kPosition);
 
   setupResultFbo();
+
+  if (mAdaptationRate > 0.0f)
+    setupBackgroundUpdate();
 }
 
 
 BackgroundSubtractionProcessor::~BackgroundSubtractionProcessor() {
   glDeleteProgram(mGlslProgram);
-  glDeleteFramebuffers(1, &mResultFbo);
-  glDeleteTextures(1, &mResultTexture);
   glDeleteTextures(1, &mReferenceFrameTexture);
+  glDeleteProgram(mUpdateGlslProgram);
+  glDeleteProgram(mMaskedUpdateGlslProgram);
 }
 
 
-void BackgroundSubtractionProcessor::setupResultFbo()
-{
-  // Prepare a texture to store the background-subtracted image
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &mResultTexture);
-  glBindTexture(GL_TEXTURE_2D, mResultTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mFrameProperties.dimensions().first,
-               mFrameProperties.dimensions().second, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
+gles_utils::FragmentStage BackgroundSubtractionProcessor::subtractionStage() const {
+  gles_utils::FragmentStage stage;
 
-  // Prepare an FBO to store the background-subtracted image image
-  glGenFramebuffers(1, &mResultFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, mResultFbo);
+  // The HSV foreground is already computed for the comparison, so
+  // storing it saves histogram passes converting every pixel again
+  stage.functionName = "backgroundSubtraction";
+  stage.sourceFile = "glsl/stages/background-subtraction.frag";
+  stage.includeFiles = {"glsl/include/color-space.frag",
+                        "glsl/include/background-foreground.frag"};
+  stage.defines = mHasHsvOutput ? "#define HSV_OUTPUT\n" : "";
+  stage.outputKey = "foreground_texture";
+  stage.textures = {{"referenceFrameTexture", mBackgroundTexture}};
+
+  return stage;
+}
+
+
+bool BackgroundSubtractionProcessor::fragmentStage(gles_utils::FragmentStage& stage) const {
+  // A fused pass would skip the background update
+  if (mAdaptationRate > 0.0f)
+    return false;
+
+  stage = subtractionStage();
+  return true;
+}
+
+
+void BackgroundSubtractionProcessor::setReferenceFrame(GLuint frameTexture) {
+  GLuint frameFbo;
+
+  // Textures can only be copied from the framebuffer they're attached to
+  glGenFramebuffers(1, &frameFbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         mResultTexture, 0);
+                         frameTexture, 0);
   assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, mReferenceFrameTexture);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0,
+                      mFrameProperties.dimensions().first,
+                      mFrameProperties.dimensions().second);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &frameFbo);
   assertNoGlError();
 
+  mBackgroundTexture = mReferenceFrameTexture;
+  mResultSet["background_texture"] = mBackgroundTexture;
+}
+
+
+void BackgroundSubtractionProcessor::setupResultFbo()
+{
+  // Prepare a texture-backed FBO to store the background-subtracted
+  // image
+  std::tie(mResultTexture, mResultFbo) =
+      generateTextureBackedFbo(mFrameProperties.dimensions());
+
   mResultSet["foreground_texture"] = mResultTexture;
 }
 
 
+void BackgroundSubtractionProcessor::setupBackgroundUpdate() {
+  mUpdateGlslProgram = buildUpdateGlslProgram(false);
+  mMaskedUpdateGlslProgram = buildUpdateGlslProgram(true);
+
+  // The background is updated by rendering alternately into one of two
+  // textures while reading from the other one
+  for (auto& textureFboPair : mBackgroundTextureFboPairs)
+    textureFboPair = generateTextureBackedFbo(mFrameProperties.dimensions());
+}
+
+
+GLuint BackgroundSubtractionProcessor::buildUpdateGlslProgram(bool useUpdateMask) {
+  gles_utils::ShaderBuilder fragmentShaderBuilder(GL_FRAGMENT_SHADER);
+
+  if (useUpdateMask)
+    fragmentShaderBuilder.appendSourceString("#define USE_UPDATE_MASK\n");
+
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(fragmentShaderBuilder
+                    .appendSourceFile("glsl/include/running-average.frag")
+                    .appendSourceFile("glsl/background-update.frag")
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(glslProgram);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+  glUniform1i(glGetUniformLocation(glslProgram, "backgroundTexture"), 1);
+  glUniform1i(glGetUniformLocation(glslProgram, "updateMaskTexture"), 2);
+  glUniform1f(glGetUniformLocation(glslProgram, "adaptationRate"),
+              mAdaptationRate);
+  assertNoGlError();
+
+  return glslProgram;
+}
+
+
+bool BackgroundSubtractionProcessor::setUpdateMask(GLuint updateMaskTexture) {
+  mUpdateMaskTexture = updateMaskTexture;
+  return true;
+}
+
+
+void BackgroundSubtractionProcessor::updateBackground() {
+  const auto& textureFboPair = mBackgroundTextureFboPairs[mNextBackgroundIndex];
+
+  glBindFramebuffer(GL_FRAMEBUFFER, textureFboPair.second);
+
+  if (mUpdateMaskTexture != 0) {
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, mUpdateMaskTexture);
+    glUseProgram(mMaskedUpdateGlslProgram);
+  } else {
+    glUseProgram(mUpdateGlslProgram);
+  }
+
+  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+  mBackgroundTexture = textureFboPair.first;
+  mNextBackgroundIndex = 1 - mNextBackgroundIndex;
+  mResultSet["background_texture"] = mBackgroundTexture;
+}
+
+
 const ProcessingResultSet& BackgroundSubtractionProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "background_subtraction.process");
+
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, frameTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, mBackgroundTexture);
 
   glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
 
@@ -100,7 +212,13 @@ const ProcessingResultSet& BackgroundSubtractionProcessor::process(GLuint frameT
              mFrameProperties.dimensions().second);
   glClear(GL_COLOR_BUFFER_BIT);
   glUseProgram(mGlslProgram);
-  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
+
+  // Blend the frame into the background only after subtraction, so that
+  // the current frame is compared against the background of the
+  // previous one
+  if (mAdaptationRate > 0.0f)
+    updateBackground();
 
   glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
 
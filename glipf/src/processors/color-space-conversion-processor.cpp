@@ -1,11 +1,6 @@
 #include <glipf/processors/color-space-conversion-processor.h>
 
-#include <glipf/gles-utils/shader-builder.h>
-#include <glipf/gles-utils/glsl-program-builder.h>
 
-
-using std::string;
-using std::vector;
 using glipf::sources::ColorSpace;
 
 
@@ -24,58 +19,43 @@ ColorSpaceConversionProcessor::ColorSpaceConversionProcessor(const sources::Fram
   : GlesProcessor(frameProperties)
   , mGlslProgram(0)
 {
-  gles_utils::ShaderBuilder fragmentShaderBuilder(GL_FRAGMENT_SHADER);
-
-  if (from == to)
-    fragmentShaderBuilder.appendSourceFile("glsl/noop.frag");
-  else {
-    fragmentShaderBuilder.appendSourceFile("glsl/include/color-space.frag");
-    string colorSpaceDefines;
-
+  // Without defines the stage leaves colors untouched
+  if (from != to) {
     switch (from) {
       case ColorSpace::BGR:
-        colorSpaceDefines += "#define INPUT_COLOR_SPACE_BGR\n";
+        mColorSpaceDefines += "#define INPUT_COLOR_SPACE_BGR\n";
         break;
       case ColorSpace::RGB:
-        colorSpaceDefines += "#define INPUT_COLOR_SPACE_RGB\n";
+        mColorSpaceDefines += "#define INPUT_COLOR_SPACE_RGB\n";
         break;
       case ColorSpace::YUV:
-        colorSpaceDefines += "#define INPUT_COLOR_SPACE_YUV\n";
+        mColorSpaceDefines += "#define INPUT_COLOR_SPACE_YUV\n";
         break;
       case ColorSpace::HSV:
-        colorSpaceDefines += "#define INPUT_COLOR_SPACE_HSV\n";
+        mColorSpaceDefines += "#define INPUT_COLOR_SPACE_HSV\n";
         break;
     }
 
     switch (to) {
       case ColorSpace::BGR:
-        colorSpaceDefines += "#define OUTPUT_COLOR_SPACE_BGR\n";
+        mColorSpaceDefines += "#define OUTPUT_COLOR_SPACE_BGR\n";
         break;
       case ColorSpace::RGB:
-        colorSpaceDefines += "#define OUTPUT_COLOR_SPACE_RGB\n";
+        mColorSpaceDefines += "#define OUTPUT_COLOR_SPACE_RGB\n";
         break;
       case ColorSpace::YUV:
-        colorSpaceDefines += "#define OUTPUT_COLOR_SPACE_YUV\n";
+        mColorSpaceDefines += "#define OUTPUT_COLOR_SPACE_YUV\n";
         break;
       case ColorSpace::HSV:
-        colorSpaceDefines += "#define OUTPUT_COLOR_SPACE_HSV\n";
+        mColorSpaceDefines += "#define OUTPUT_COLOR_SPACE_HSV\n";
         break;
     }
-
-    fragmentShaderBuilder.appendSourceString(colorSpaceDefines)
-      .appendSourceFile("glsl/color-space-conversion.frag");
   }
 
-  mGlslProgram = gles_utils::GlslProgramBuilder()
-    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
-                    .appendSourceFile("glsl/standard.vert")
-                    .compile())
-    .attachShader(fragmentShaderBuilder.compile())
-    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
-    .link();
-
-  glUseProgram(mGlslProgram);
-  glUniform1i(glGetUniformLocation(mGlslProgram, "tex"), 0);
+  gles_utils::FragmentStage stage;
+  fragmentStage(stage);
+  mGlslProgram = buildFragmentStageGlslProgram({stage},
+                                               VertexAttributeLocations::kPosition);
 
   std::tie(mResultTexture, mResultFbo) =
       generateTextureBackedFbo(frameProperties.dimensions());
@@ -85,12 +65,23 @@ ColorSpaceConversionProcessor::ColorSpaceConversionProcessor(const sources::Fram
 
 ColorSpaceConversionProcessor::~ColorSpaceConversionProcessor() {
   glDeleteProgram(mGlslProgram);
-  glDeleteFramebuffers(1, &mResultFbo);
-  glDeleteTextures(1, &mResultTexture);
+}
+
+
+bool ColorSpaceConversionProcessor::fragmentStage(gles_utils::FragmentStage& stage) const {
+  stage.functionName = "colorSpaceConversion";
+  stage.sourceFile = "glsl/stages/color-space-conversion.frag";
+  stage.includeFiles = {"glsl/include/color-space.frag"};
+  stage.defines = mColorSpaceDefines;
+  stage.outputKey = "color_space_converted_texture";
+
+  return true;
 }
 
 
 const ProcessingResultSet& ColorSpaceConversionProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "color_space_conversion.process");
+
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, frameTexture);
 
@@ -0,0 +1,386 @@
+#include <glipf/processors/connected-components-processor.h>
+
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+#include <boost/variant/get.hpp>
+
+#include <algorithm>
+
+
+// Labels store coordinates in 8-bit channels, so the working texture
+// can't be larger than this in either dimension
+#define MAX_WORKING_DIMENSION 256
+#define TILE_SIZE 8
+// Roots of 8-connected components are at least two texels apart, so a
+// tile holds at most one per 2 x 2 block
+#define ROOTS_PER_TILE ((TILE_SIZE / 2) * (TILE_SIZE / 2))
+// Number of propagation passes between checks for convergence
+#define CONVERGENCE_CHECK_INTERVAL 4
+
+
+using std::string;
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+ConnectedComponentsProcessor::ConnectedComponentsProcessor(const sources::FrameProperties& frameProperties,
+                                                           size_t iterationCount)
+  : GlesProcessor(frameProperties)
+  , mIterationCount(iterationCount)
+  , mInitializationGlslProgram(0)
+  , mPropagationGlslProgram(0)
+  , mBoundingBoxGlslProgram(0)
+  , mAreaGlslProgram(0)
+  , mCompactionGlslProgram(0)
+  , mChangeDetectionGlslProgram(0)
+  , mScatterPointsBuffer(0)
+  , mLabelTextureFboPairs{{0, 0}, {0, 0}}
+  , mLabelIndex(0)
+{
+  size_t frameWidth = frameProperties.dimensions().first;
+  size_t frameHeight = frameProperties.dimensions().second;
+
+  // Components are labelled at a reduced resolution whose coordinates
+  // fit into 8 bits
+  mScale = (std::max(frameWidth, frameHeight) + MAX_WORKING_DIMENSION - 1) /
+           MAX_WORKING_DIMENSION;
+  mWorkingDimensions = std::make_pair((frameWidth + mScale - 1) / mScale,
+                                      (frameHeight + mScale - 1) / mScale);
+  mTileGridDimensions = std::make_pair(
+      (mWorkingDimensions.first + TILE_SIZE - 1) / TILE_SIZE,
+      (mWorkingDimensions.second + TILE_SIZE - 1) / TILE_SIZE);
+
+  string scaleDefine = "#define SCALE " + std::to_string(mScale) + ".0\n";
+  string tileSizeDefine = "#define TILE_SIZE " + std::to_string(TILE_SIZE) +
+                          ".0\n#define ROOTS_PER_TILE " +
+                          std::to_string(ROOTS_PER_TILE) + ".0\n";
+
+  mInitializationGlslProgram =
+      buildGlslProgram("glsl/standard.vert",
+                       "glsl/connected-components/initialization.frag",
+                       scaleDefine);
+  mPropagationGlslProgram =
+      buildGlslProgram("glsl/standard.vert",
+                       "glsl/connected-components/propagation.frag", "");
+  mBoundingBoxGlslProgram =
+      buildGlslProgram("glsl/connected-components/scatter.vert",
+                       "glsl/connected-components/scatter.frag", "");
+  mAreaGlslProgram =
+      buildGlslProgram("glsl/connected-components/scatter.vert",
+                       "glsl/connected-components/scatter.frag",
+                       "#define COUNT_AREA\n");
+  mCompactionGlslProgram =
+      buildGlslProgram("glsl/standard.vert",
+                       "glsl/connected-components/compaction.frag",
+                       tileSizeDefine);
+  mChangeDetectionGlslProgram =
+      buildGlslProgram("glsl/connected-components/change-detection.vert",
+                       "glsl/connected-components/scatter.frag", "");
+
+  glUseProgram(mInitializationGlslProgram);
+  glUniform2f(glGetUniformLocation(mInitializationGlslProgram, "inputTexelSize"),
+              1.0f / frameWidth, 1.0f / frameHeight);
+  glUniform1f(glGetUniformLocation(mInitializationGlslProgram, "maskBit"),
+              -1.0f);
+  glUseProgram(mCompactionGlslProgram);
+  glUniform1i(glGetUniformLocation(mCompactionGlslProgram, "boundingBoxTexture"),
+              1);
+  glUniform1i(glGetUniformLocation(mCompactionGlslProgram, "areaTexture"), 2);
+  glUniform2f(glGetUniformLocation(mCompactionGlslProgram, "tileGridDimensions"),
+              mTileGridDimensions.first, mTileGridDimensions.second);
+  glUseProgram(mChangeDetectionGlslProgram);
+  glUniform1i(glGetUniformLocation(mChangeDetectionGlslProgram,
+                                   "previousLabelTexture"), 1);
+  assertNoGlError();
+
+  for (auto& textureFboPair : mLabelTextureFboPairs)
+    textureFboPair = generateTextureBackedFbo(mWorkingDimensions);
+
+  mAreaTextureFboPair = generateTextureBackedFbo(mWorkingDimensions);
+
+  // The bounding box FBO keeps the minimum and maximum coordinates with
+  // the depth test
+  mBoundingBoxTextureFboPair = generateTextureBackedFbo(mWorkingDimensions,
+                                                        GL_UNSIGNED_BYTE, true);
+
+  mCompactionTextureFboPair = generateTextureBackedFbo(
+      std::make_pair(2 * ROOTS_PER_TILE * mTileGridDimensions.first,
+                     mTileGridDimensions.second));
+  mChangeTextureFboPair = generateTextureBackedFbo(std::make_pair(1, 1));
+
+  setupScatterPoints();
+
+  mResultSet["components"] = vector<float>();
+}
+
+
+ConnectedComponentsProcessor::~ConnectedComponentsProcessor() {
+  for (auto glslProgram : {mInitializationGlslProgram, mPropagationGlslProgram,
+                           mBoundingBoxGlslProgram, mAreaGlslProgram,
+                           mCompactionGlslProgram, mChangeDetectionGlslProgram})
+  {
+    glDeleteProgram(glslProgram);
+  }
+
+  glDeleteBuffers(1, &mScatterPointsBuffer);
+}
+
+
+GLuint ConnectedComponentsProcessor::buildGlslProgram(const string& vertexShaderPath,
+                                                      const string& fragmentShaderPath,
+                                                      const string& defines)
+{
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceString(defines)
+                    .appendSourceFile(vertexShaderPath)
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString("precision highp float;\n")
+                    .appendSourceString(defines)
+                    .appendSourceFile("glsl/include/bitmask.frag")
+                    .appendSourceFile("glsl/include/component-labels.frag")
+                    .appendSourceFile(fragmentShaderPath)
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(glslProgram);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+  glUniform1i(glGetUniformLocation(glslProgram, "labelTexture"), 0);
+  glUniform2f(glGetUniformLocation(glslProgram, "workingDimensions"),
+              mWorkingDimensions.first, mWorkingDimensions.second);
+  assertNoGlError();
+
+  return glslProgram;
+}
+
+
+void ConnectedComponentsProcessor::setMaskBit(int bitIndex) {
+  glUseProgram(mInitializationGlslProgram);
+  glUniform1f(glGetUniformLocation(mInitializationGlslProgram, "maskBit"),
+              bitIndex);
+  assertNoGlError();
+}
+
+
+void ConnectedComponentsProcessor::setupScatterPoints() {
+  vector<GLfloat> pointData;
+  pointData.reserve(2 * mWorkingDimensions.first * mWorkingDimensions.second);
+
+  for (size_t i = 0; i < mWorkingDimensions.second; ++i) {
+    for (size_t j = 0; j < mWorkingDimensions.first; ++j) {
+      pointData.push_back((j + 0.5f) / mWorkingDimensions.first);
+      pointData.push_back((i + 0.5f) / mWorkingDimensions.second);
+    }
+  }
+
+  glGenBuffers(1, &mScatterPointsBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, mScatterPointsBuffer);
+  glBufferData(GL_ARRAY_BUFFER, pointData.size() * sizeof(GLfloat),
+               pointData.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  assertNoGlError();
+}
+
+
+void ConnectedComponentsProcessor::labelComponents(GLuint frameTexture) {
+  // Label every foreground texel with its own coordinates
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+  glBindFramebuffer(GL_FRAMEBUFFER, mLabelTextureFboPairs[0].second);
+  glUseProgram(mInitializationGlslProgram);
+  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  mLabelIndex = 0;
+
+  // Spread the lowest label of every component over it. Labels follow
+  // the path through a component, so winding components need many more
+  // passes than their extent suggests; unless limited, passes continue
+  // until a pass changes no label.
+  for (size_t i = 1; mIterationCount == 0 || i <= mIterationCount; ++i) {
+    glUseProgram(mPropagationGlslProgram);
+    glBindTexture(GL_TEXTURE_2D, mLabelTextureFboPairs[mLabelIndex].first);
+    mLabelIndex = 1 - mLabelIndex;
+    glBindFramebuffer(GL_FRAMEBUFFER, mLabelTextureFboPairs[mLabelIndex].second);
+    drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+    if (mIterationCount == 0 && i % CONVERGENCE_CHECK_INTERVAL == 0 &&
+        !hasLabelChanges())
+    {
+      break;
+    }
+  }
+}
+
+
+bool ConnectedComponentsProcessor::hasLabelChanges() {
+  utils::Profiler::Span convergenceSpan(*mProfiler,
+                                        "connected_components.convergence");
+
+  glBindTexture(GL_TEXTURE_2D, mLabelTextureFboPairs[mLabelIndex].first);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, mLabelTextureFboPairs[1 - mLabelIndex].first);
+  glActiveTexture(GL_TEXTURE0);
+  glBindFramebuffer(GL_FRAMEBUFFER, mChangeTextureFboPair.second);
+  glViewport(0, 0, 1, 1);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glUseProgram(mChangeDetectionGlslProgram);
+  glBindBuffer(GL_ARRAY_BUFFER, mScatterPointsBuffer);
+  glVertexAttribPointer(VertexAttributeLocations::kPosition, 2, GL_FLOAT,
+                        GL_FALSE, 0, 0);
+  glDrawArrays(GL_POINTS, 0,
+               mWorkingDimensions.first * mWorkingDimensions.second);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  GLubyte pixel[4];
+  glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  glViewport(0, 0, mWorkingDimensions.first, mWorkingDimensions.second);
+  assertNoGlError();
+
+  return pixel[0] != 0;
+}
+
+
+void ConnectedComponentsProcessor::scatterToRoots() {
+  glBindTexture(GL_TEXTURE_2D, mLabelTextureFboPairs[mLabelIndex].first);
+  glBindBuffer(GL_ARRAY_BUFFER, mScatterPointsBuffer);
+  glVertexAttribPointer(VertexAttributeLocations::kPosition, 2, GL_FLOAT,
+                        GL_FALSE, 0, 0);
+  GLsizei pointCount = mWorkingDimensions.first * mWorkingDimensions.second;
+
+  // Count the texels of every component at its root
+  glBindFramebuffer(GL_FRAMEBUFFER, mAreaTextureFboPair.second);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  glBlendEquation(GL_FUNC_ADD);
+  glUseProgram(mAreaGlslProgram);
+  glDrawArrays(GL_POINTS, 0, pointCount);
+  glDisable(GL_BLEND);
+
+  // Keep the extreme coordinates of every component at its root: one
+  // pass per bounding box channel, each keeping the point closest to
+  // the viewer
+  const struct {
+    GLfloat axis[2];
+    GLfloat isMaximum;
+  } boundingBoxChannels[] = {
+    {{1.0f, 0.0f}, 0.0f},
+    {{0.0f, 1.0f}, 0.0f},
+    {{1.0f, 0.0f}, 1.0f},
+    {{0.0f, 1.0f}, 1.0f}
+  };
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mBoundingBoxTextureFboPair.second);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  glUseProgram(mBoundingBoxGlslProgram);
+  GLint axisLocation = glGetUniformLocation(mBoundingBoxGlslProgram,
+                                            "coordinateAxis");
+  GLint isMaximumLocation = glGetUniformLocation(mBoundingBoxGlslProgram,
+                                                 "isMaximum");
+
+  for (size_t i = 0; i < 4; ++i) {
+    glColorMask(i == 0, i == 1, i == 2, i == 3);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glUniform2fv(axisLocation, 1, boundingBoxChannels[i].axis);
+    glUniform1f(isMaximumLocation, boundingBoxChannels[i].isMaximum);
+    glDrawArrays(GL_POINTS, 0, pointCount);
+  }
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDisable(GL_DEPTH_TEST);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  assertNoGlError();
+}
+
+
+void ConnectedComponentsProcessor::extractComponents() {
+  // Gather the roots into a texture with two texels per root slot and
+  // read only that back; with ROOTS_PER_TILE slots per tile, it holds
+  // half as many texels as the working texture
+  glViewport(0, 0, 2 * ROOTS_PER_TILE * mTileGridDimensions.first,
+             mTileGridDimensions.second);
+  glBindTexture(GL_TEXTURE_2D, mLabelTextureFboPairs[mLabelIndex].first);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, mBoundingBoxTextureFboPair.first);
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, mAreaTextureFboPair.first);
+  glBindFramebuffer(GL_FRAMEBUFFER, mCompactionTextureFboPair.second);
+  glUseProgram(mCompactionGlslProgram);
+  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+  size_t slotCount = ROOTS_PER_TILE * mTileGridDimensions.first *
+                     mTileGridDimensions.second;
+  vector<GLubyte> pixelData(slotCount * 8);
+  utils::Profiler::Span readbackSpan(*mProfiler,
+                                     "connected_components.readback");
+  glReadPixels(0, 0, 2 * ROOTS_PER_TILE * mTileGridDimensions.first,
+               mTileGridDimensions.second, GL_RGBA, GL_UNSIGNED_BYTE,
+               pixelData.data());
+  readbackSpan.finish();
+
+  auto& components = boost::get<vector<float>>(mResultSet["components"]);
+  components.clear();
+
+  size_t frameWidth = mFrameProperties.dimensions().first;
+  size_t frameHeight = mFrameProperties.dimensions().second;
+
+  for (size_t i = 0; i < slotCount; ++i) {
+    const GLubyte* boundingBox = &pixelData[8 * i];
+    const GLubyte* areaCounts = &pixelData[8 * i + 4];
+    size_t area = areaCounts[0] + areaCounts[1] + areaCounts[2] +
+                  areaCounts[3];
+
+    if (area == 0)
+      continue;
+
+    // Convert from working texels back to frame pixels
+    size_t x = boundingBox[0] * mScale;
+    size_t y = boundingBox[1] * mScale;
+    size_t xEnd = std::min((boundingBox[2] + 1) * mScale, frameWidth);
+    size_t yEnd = std::min((boundingBox[3] + 1) * mScale, frameHeight);
+
+    components.push_back(x);
+    components.push_back(y);
+    components.push_back(xEnd - x);
+    components.push_back(yEnd - y);
+    components.push_back(area * mScale * mScale);
+  }
+}
+
+
+const ProcessingResultSet& ConnectedComponentsProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "connected_components.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+  glViewport(0, 0, mWorkingDimensions.first, mWorkingDimensions.second);
+
+  // Step 1: label components
+  labelComponents(frameTexture);
+
+  // Step 2: compute areas and bounding boxes at component roots
+  scatterToRoots();
+
+  // Step 3: compact and read back the components
+  extractComponents();
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
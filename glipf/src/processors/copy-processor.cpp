@@ -12,6 +12,8 @@ CopyProcessor::CopyProcessor(const sources::FrameProperties& frameProperties)
 
 
 const ProcessingResultSet& CopyProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "copy.process");
+
   mResultSet["original_frame"] = frameTexture;
 
   return mResultSet;
@@ -9,10 +9,6 @@
 #include <cstring>
 
 
-#define BASE_TEXTURE_WIDTH 320
-#define BASE_TEXTURE_HEIGHT 240
-
-
 using std::pair;
 using std::string;
 using std::tuple;
@@ -30,16 +26,62 @@ enum VertexAttributeLocations : GLuint {
 };
 
 
+// Coverage is computed at half the frame resolution at quality 1, in a
+// grid of 4x4 working areas
+constexpr float kFrameScale = 0.5f;
+constexpr size_t kModelGridSize = 4;
+
+
+namespace {
+
+/*
+ * Return the factor the next reduction level divides a dimension by, or
+ * 1 once it's small or can't be divided any further. Factors are kept
+ * to at most 5, so that every output pixel samples at most 5x5 texels.
+ */
+uint16_t reductionFactor(size_t dimension) {
+  if (dimension <= 4)
+    return 1;
+
+  for (uint16_t factor : {5, 4, 3, 2}) {
+    if (dimension % factor == 0)
+      return factor;
+  }
+
+  return 1;
+}
+
+} // end namespace
+
+
 ForegroundCoverageProcessor::ForegroundCoverageProcessor(const sources::FrameProperties& frameProperties,
                                                          const vector<ModelData>& models,
-                                                         const glm::mat4& mvpMatrix)
+                                                         const glm::mat4& mvpMatrix,
+                                                         float qualityScale)
   : GlesProcessor(frameProperties)
+  , mWorkingDimensions(workingDimensions(kFrameScale, qualityScale,
+                                         kModelGridSize))
+  , mModelCount(models.size())
   , mPixelCountingGlslProgram(0)
   , mModelVertexBuffer(0)
   , mModelIndexBuffer(0)
 {
   setupReductionGlslPrograms(mvpMatrix);
-  setupModelGeometry(models);
+
+  // Models that wouldn't cover a single working pixel aren't rendered
+  // at all; they'd only take up grid cells and report 0 / 0 coverage
+  utils::ModelProjection modelProjection;
+  const auto& projectedModels = modelProjection.project(models, mvpMatrix);
+  vector<ModelData> drawnModels;
+
+  for (size_t i = 0; i < models.size(); ++i) {
+    if (isModelDrawn(projectedModels[i])) {
+      mDrawnModelIndices.push_back(i);
+      drawnModels.push_back(models[i]);
+    }
+  }
+
+  setupModelGeometry(drawnModels);
 
   mResultSet["model_coverage"] = vector<float>();
 }
@@ -52,13 +94,30 @@ ForegroundCoverageProcessor::~ForegroundCoverageProcessor() {
 
   for (auto reductionFboSpec : mReductionFboSpecs)
     glDeleteProgram(std::get<0>(reductionFboSpec));
+}
 
-  for (const auto& reductionFboSet : mReductionFboSets) {
-    for (auto modelTextureFboPair : std::get<3>(reductionFboSet)) {
-      glDeleteFramebuffers(1, &std::get<1>(modelTextureFboPair));
-      glDeleteTextures(1, &std::get<0>(modelTextureFboPair));
-    }
-  }
+
+bool ForegroundCoverageProcessor::isModelDrawn(const utils::ProjectedModel& projectedModel) const {
+  // Models crossing the camera plane can't be bounded by their
+  // projection
+  if (projectedModel.nearestDepth <= 0.0f)
+    return true;
+
+  float frameWidth = mFrameProperties.dimensions().first;
+  float frameHeight = mFrameProperties.dimensions().second;
+  float workingPixelArea = frameWidth / mWorkingDimensions.first *
+                           frameHeight / mWorkingDimensions.second;
+
+  return projectedModel.bboxMax.x >= 0.0f &&
+         projectedModel.bboxMax.y >= 0.0f &&
+         projectedModel.bboxMin.x < frameWidth &&
+         projectedModel.bboxMin.y < frameHeight &&
+         projectedModel.area >= workingPixelArea;
+}
+
+
+size_t ForegroundCoverageProcessor::inputPyramidLevel() const {
+  return pyramidLevelForWidth(mWorkingDimensions.first);
 }
 
 
@@ -86,14 +145,29 @@ void ForegroundCoverageProcessor::setupReductionGlslPrograms(const glm::mat4& mv
   assertNoGlError();
 
   mReductionFboSpecs.push_back(std::make_tuple(mainGlslProgram,
-                                               BASE_TEXTURE_WIDTH,
-                                               BASE_TEXTURE_HEIGHT));
-
-  vector<tuple<uint16_t, uint16_t, uint16_t, uint16_t>> reductionFboSpecs = {
-    std::make_tuple(BASE_TEXTURE_WIDTH / 4, BASE_TEXTURE_HEIGHT / 4, 4, 4),
-    std::make_tuple(BASE_TEXTURE_WIDTH / 16, BASE_TEXTURE_HEIGHT / 16, 4, 4),
-    std::make_tuple(BASE_TEXTURE_WIDTH / 80, BASE_TEXTURE_HEIGHT / 80, 5, 5)
-  };
+                                               mWorkingDimensions.first,
+                                               mWorkingDimensions.second));
+
+  // Divide the working area down level by level until neither
+  // dimension can be divided any further. Every level divides exactly,
+  // whatever the working resolution; the last level is summed on
+  // readback, however large it's left.
+  vector<tuple<uint16_t, uint16_t, uint16_t, uint16_t>> reductionFboSpecs;
+  size_t levelWidth = mWorkingDimensions.first;
+  size_t levelHeight = mWorkingDimensions.second;
+
+  while (true) {
+    uint16_t texelWidth = reductionFactor(levelWidth);
+    uint16_t texelHeight = reductionFactor(levelHeight);
+
+    if (texelWidth == 1 && texelHeight == 1)
+      break;
+
+    levelWidth /= texelWidth;
+    levelHeight /= texelHeight;
+    reductionFboSpecs.push_back(std::make_tuple(levelWidth, levelHeight,
+                                                texelWidth, texelHeight));
+  }
 
   for (auto& reductionFboSpec : reductionFboSpecs) {
     uint16_t fboWidth, fboHeight, texelWidth, texelHeight;
@@ -133,32 +207,11 @@ void ForegroundCoverageProcessor::addReductionFboSet(size_t modelCount,
 {
   vector<TextureFboPair> reductionObjects;
 
-  // Prepare a texture to store the average foreground coverage of the
-  // model
+  // Prepare a texture-backed FBO to store the average foreground
+  // coverage of the model
   for (auto& spec : mReductionFboSpecs) {
-    GLuint averageTexture;
-    glActiveTexture(GL_TEXTURE3);
-    glGenTextures(1, &averageTexture);
-    glBindTexture(GL_TEXTURE_2D, averageTexture);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 4 * std::get<1>(spec),
-                 4 * std::get<2>(spec), 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-    assertNoGlError();
-
-    // Prepare an FBO to store the average foreground coverage of the
-    // model
-    GLuint averageFbo;
-    glGenFramebuffers(1, &averageFbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, averageFbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D, averageTexture, 0);
-    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-    assertNoGlError();
-
-    reductionObjects.push_back(std::make_pair(averageTexture, averageFbo));
+    reductionObjects.push_back(generateTextureBackedFbo(
+        std::make_pair(4 * std::get<1>(spec), 4 * std::get<2>(spec))));
   }
 
   mReductionFboSets.push_back(std::make_tuple(modelCount,
@@ -233,9 +286,18 @@ void ForegroundCoverageProcessor::setupModelGeometry(const std::vector<ModelData
 
 
 const ProcessingResultSet& ForegroundCoverageProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "foreground_coverage.process");
+
   vector<float>& modelCoverageSet =
       boost::get<vector<float>>(mResultSet["model_coverage"]);
-  modelCoverageSet.clear();
+
+  // Culled models have no coverage
+  if (mDrawnModelIndices.empty()) {
+    modelCoverageSet.assign(mModelCount, 0.0f);
+    return mResultSet;
+  }
+
+  vector<float> drawnModelCoverage;
 
   auto reductionSpecIter = std::begin(mReductionFboSpecs);
   GLuint reductionGlslProgram;
@@ -307,13 +369,27 @@ const ProcessingResultSet& ForegroundCoverageProcessor::process(GLuint frameText
 
   glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
 
-  // Step 3: extract coverage
-  for (auto& reductionFboSet : mReductionFboSets) {
+  // Step 3: read back the coverage of all model sets
+  const size_t fboDataSize = fboWidth * fboHeight * 64;
+  vector<GLubyte> coverageData(mReductionFboSets.size() * fboDataSize);
+  utils::Profiler::Span readbackSpan(*mProfiler,
+                                     "foreground_coverage.readback");
+
+  for (size_t i = 0; i < mReductionFboSets.size(); ++i) {
     glBindFramebuffer(GL_FRAMEBUFFER,
-                      std::get<1>(std::get<3>(reductionFboSet).back()));
-    GLubyte pixelData[fboWidth * fboHeight * 64];
+                      std::get<1>(std::get<3>(mReductionFboSets[i]).back()));
     glReadPixels(0, 0, 4 * fboWidth, 4 * fboHeight, GL_RGBA, GL_UNSIGNED_BYTE,
-                 pixelData);
+                 coverageData.data() + i * fboDataSize);
+  }
+
+  readbackSpan.finish();
+  utils::Profiler::Span extractionSpan(*mProfiler,
+                                       "foreground_coverage.extraction");
+
+  // Step 4: extract coverage
+  for (size_t fboIndex = 0; fboIndex < mReductionFboSets.size(); ++fboIndex) {
+    const auto& reductionFboSet = mReductionFboSets[fboIndex];
+    const GLubyte* pixelData = coverageData.data() + fboIndex * fboDataSize;
     uint_fast16_t offset = 0;
     size_t modelCount = std::get<0>(reductionFboSet);
 
@@ -332,15 +408,20 @@ const ProcessingResultSet& ForegroundCoverageProcessor::process(GLuint frameText
       }
 
       for (uint_fast16_t j = 0; j < std::min(modelCount, 8u); ++j)
-        modelCoverageSet.push_back(foregroundCoverage[j] / (float)modelCoverage[j]);
+        drawnModelCoverage.push_back(foregroundCoverage[j] / (float)modelCoverage[j]);
 
-      if (modelCount < 8)
-        return mResultSet;
+      if (modelCount <= 8)
+        break;
 
       modelCount -= 8;
     }
   }
 
+  modelCoverageSet.assign(mModelCount, 0.0f);
+
+  for (size_t i = 0; i < mDrawnModelIndices.size(); ++i)
+    modelCoverageSet[mDrawnModelIndices[i]] = drawnModelCoverage[i];
+
   return mResultSet;
 }
 
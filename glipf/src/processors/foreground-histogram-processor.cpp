@@ -1,16 +1,23 @@
 #include <glipf/processors/foreground-histogram-processor.h>
 
+#include <glipf/gles-utils/gles-context.h>
 #include <glipf/gles-utils/shader-builder.h>
 #include <glipf/gles-utils/glsl-program-builder.h>
 
+#include <GLES2/gl2ext.h>
+#ifdef GLIPF_GLES3
+#include <GLES3/gl31.h>
+#endif
+
 #include <boost/variant/get.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <memory>
 
 
-#define BASE_TEXTURE_WIDTH 160
-#define BASE_TEXTURE_HEIGHT 120
 #define HISTOGRAM_TEXTURE_WIDTH 10
 #define HISTOGRAM_TEXTURE_HEIGHT 10
 #define HISTOGRAM_TEXTURE_AREA (HISTOGRAM_TEXTURE_WIDTH * HISTOGRAM_TEXTURE_HEIGHT)
@@ -19,13 +26,16 @@
 #define MODEL_GRID_AREA (MODEL_GRID_WIDTH * MODEL_GRID_HEIGHT)
 #define MODELS_PER_GRID_CELL 2
 #define MODEL_GRID_MODEL_COUNT (MODEL_GRID_AREA * MODELS_PER_GRID_CELL)
-#define HALF_BASE_TEXEL_WIDTH (0.5f / (MODEL_GRID_WIDTH * BASE_TEXTURE_WIDTH))
-#define HALF_BASE_TEXEL_HEIGHT (0.5f / (MODEL_GRID_HEIGHT * BASE_TEXTURE_HEIGHT))
+#define HISTOGRAM_FBO_WIDTH (MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH)
+#define HISTOGRAM_FBO_HEIGHT (MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT)
+
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
 
 
 using std::pair;
 using std::string;
-using std::tuple;
 using std::vector;
 
 
@@ -36,44 +46,216 @@ namespace processors {
 enum VertexAttributeLocations : GLuint {
   kPosition = 0,
   kColor = 1,
-  kCellOffset = 2
+  kCellOffset = 2,
+  kOwnOccluderNumber = 3
 };
 
 
+// Largest count a histogram channel holds exactly: 8-bit channels
+// saturate, half floats can't represent every integer beyond 2^11
+constexpr GLsizei kByteChannelCapacity = 255;
+constexpr GLsizei kHalfFloatChannelCapacity = 2048;
+// Histograms sample a quarter of the frame resolution at quality 1
+constexpr float kFrameScale = 0.25f;
+
+
+namespace {
+
+float halfToFloat(GLushort half) {
+  int exponent = (half >> 10) & 0x1f;
+  float mantissa = half & 0x3ff;
+  float value = (exponent == 0) ? std::ldexp(mantissa, -24)
+                                : std::ldexp(mantissa + 1024.0f, exponent - 25);
+
+  return (half & 0x8000) ? -value : value;
+}
+
+
+/*
+ * Collect the bins of a model from the bin counts of all histogram FBOs,
+ * where every row of grid cells holds the histograms of
+ * MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH models side by side.
+ */
+vector<uint_fast32_t> extractModelBinCounts(const vector<uint_fast32_t>& binCounts,
+                                            size_t modelNumber,
+                                            uint_fast32_t& histogramTotal)
+{
+  const size_t rowModelCount = MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH;
+  const size_t rowWidth = rowModelCount * HISTOGRAM_TEXTURE_WIDTH;
+  const size_t fboBinCount = rowWidth * MODEL_GRID_HEIGHT *
+                             HISTOGRAM_TEXTURE_HEIGHT;
+  size_t cellNumber = modelNumber % MODEL_GRID_MODEL_COUNT;
+  size_t firstBin = (modelNumber / MODEL_GRID_MODEL_COUNT) * fboBinCount +
+                    (cellNumber / rowModelCount) * HISTOGRAM_TEXTURE_HEIGHT *
+                        rowWidth +
+                    (cellNumber % rowModelCount) * HISTOGRAM_TEXTURE_WIDTH;
+  vector<uint_fast32_t> modelBinCounts;
+  histogramTotal = 0;
+
+  for (uint_fast16_t j = 0; j < HISTOGRAM_TEXTURE_HEIGHT; ++j) {
+    for (uint_fast16_t k = 0; k < HISTOGRAM_TEXTURE_WIDTH; ++k) {
+      uint_fast32_t bucketValue = binCounts[firstBin + j * rowWidth + k];
+
+      modelBinCounts.push_back(bucketValue);
+      histogramTotal += bucketValue;
+    }
+  }
+
+  return modelBinCounts;
+}
+
+} // end namespace
+
+
+bool ForegroundHistogramProcessor::hasHalfFloatRenderTargets() {
+  const GLubyte* extensions = glGetString(GL_EXTENSIONS);
+
+  if (extensions == nullptr ||
+      !std::strstr(reinterpret_cast<const char*>(extensions),
+                   "GL_OES_texture_half_float") ||
+      !std::strstr(reinterpret_cast<const char*>(extensions),
+                   "GL_EXT_color_buffer_half_float"))
+  {
+    return false;
+  }
+
+  // Half floats also have to be renderable and readable in RGBA, which
+  // the extensions leave to the implementation
+  GLuint texture, fbo;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+               GL_HALF_FLOAT_OES, 0);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_2D, texture, 0);
+
+  bool isSupported = false;
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+    GLint readFormat, readType;
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &readFormat);
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &readType);
+    isSupported = (readFormat == GL_RGBA && readType == GL_HALF_FLOAT_OES);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteTextures(1, &texture);
+
+  // Failed probes leave errors behind on some drivers
+  while (glGetError() != GL_NO_ERROR) {}
+
+  return isSupported;
+}
+
+
+bool ForegroundHistogramProcessor::hasComputeShaders() {
+#ifdef GLIPF_GLES3
+  if (gles_utils::GlesContext::currentClientVersion() < 3)
+    return false;
+
+  GLint majorVersion, minorVersion;
+  glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+  glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+
+  return majorVersion > 3 || (majorVersion == 3 && minorVersion >= 1);
+#else
+  return false;
+#endif
+}
+
+
 ForegroundHistogramProcessor::ForegroundHistogramProcessor(const sources::FrameProperties& frameProperties,
                                                            size_t maxModelCount,
-                                                           const glm::mat4& mvpMatrix)
+                                                           const glm::mat4& mvpMatrix,
+                                                           bool hasHsvInput,
+                                                           float qualityScale)
   : GlesProcessor(frameProperties)
+  , mWorkingDimensions(workingDimensions(kFrameScale, qualityScale,
+                                         MODEL_GRID_WIDTH))
   , mModelCount(0)
   , mMaxModelCount(maxModelCount)
+  , mHasHsvInput(hasHsvInput)
+  , mMvpMatrix(mvpMatrix)
+  , mOcclusionProcessor(nullptr)
+  , mCullingGlslProgram(0)
   , mModelVertexBuffer(0)
   , mModelIndexBuffer(0)
-  , mScatterPointsBuffer(0)
+  , mScatterTemplateBuffer(0)
   , mHistogramGlslProgram(0)
+  , mCellOriginLocation(-1)
+  , mChannelPairLocation(-1)
+  , mModelBboxLocation(-1)
+  , mHistogramType(GL_UNSIGNED_BYTE)
+  , mPassPointCount(0)
+  , mHasPixelPackBuffers(false)
+  , mPixelPackBuffer(0)
+  , mPixelPackBufferSize(0)
+  , mComputeGlslProgram(0)
+  , mFirstModelNumberLocation(-1)
+  , mModelBboxBuffer(0)
+  , mBinCountBuffer(0)
 {
+  string histogramDefines;
+
+  // Histograms are accumulated in half floats where possible, which
+  // takes fewer passes than bytes
+  if (hasHalfFloatRenderTargets()) {
+    mHistogramType = GL_HALF_FLOAT_OES;
+    mPassPointCount = 4 * kHalfFloatChannelCapacity;
+    histogramDefines = "#define UNIT_VALUE 1.0\n";
+  } else {
+    mPassPointCount = 4 * kByteChannelCapacity;
+  }
+
   setupReductionGlslPrograms(mvpMatrix);
   setupFbos(maxModelCount);
 
+#ifdef GLIPF_GLES3
+  // GLES 3 reads histograms back into a pixel buffer object without
+  // waiting for the GPU
+  if (gles_utils::GlesContext::currentClientVersion() >= 3) {
+    mHasPixelPackBuffers = true;
+    glGenBuffers(1, &mPixelPackBuffer);
+  }
+
+  if (hasComputeShaders())
+    setupHistogramCompute();
+#endif
+
   mHistogramGlslProgram = gles_utils::GlslProgramBuilder()
     .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
                     .appendSourceFile("glsl/histogram-scatter.vert")
                     .compile())
     .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString(histogramDefines)
                     .appendSourceFile("glsl/unit-value.frag")
                     .compile())
-    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "pointIndex")
     .link();
 
   glUseProgram(mHistogramGlslProgram);
   glUniform1i(glGetUniformLocation(mHistogramGlslProgram, "tex"), 2);
   glUniform3i(glGetUniformLocation(mHistogramGlslProgram, "gridDimensions"),
               MODEL_GRID_WIDTH, MODEL_GRID_HEIGHT, MODELS_PER_GRID_CELL);
+  glUniform2f(glGetUniformLocation(mHistogramGlslProgram, "atlasDimensions"),
+              MODEL_GRID_WIDTH * mWorkingDimensions.first,
+              MODEL_GRID_HEIGHT * mWorkingDimensions.second);
+  mCellOriginLocation = glGetUniformLocation(mHistogramGlslProgram,
+                                             "cellOrigin");
+  mChannelPairLocation = glGetUniformLocation(mHistogramGlslProgram,
+                                              "channelPair");
+  mModelBboxLocation = glGetUniformLocation(mHistogramGlslProgram,
+                                            "modelBbox");
 
   glGenBuffers(1, &mModelVertexBuffer);
   glGenBuffers(1, &mModelIndexBuffer);
-  glGenBuffers(1, &mScatterPointsBuffer);
   assertNoGlError();
 
+  setupScatterTemplate();
+
   for (size_t i = 0; i < maxModelCount; ++i)
     mResultSet[std::to_string(i)] = vector<float>(HISTOGRAM_TEXTURE_AREA);
 
@@ -83,90 +265,136 @@ ForegroundHistogramProcessor::ForegroundHistogramProcessor(const sources::FrameP
 
 
 void ForegroundHistogramProcessor::setModels(const vector<ModelData>& models,
-                                             const glm::mat4& mvpMatrix)
+                                             const glm::mat4& mvpMatrix,
+                                             const vector<int>& ownOccluderIndices,
+                                             const vector<size_t>& levelsOfDetail)
 {
+  utils::Profiler::Span setModelsSpan(*mProfiler,
+                                      "foreground_histogram.set_models");
+
   mReductionFboSets.clear();
-  mHistogramFboSpecs.clear();
 
   mModelCount = models.size();
   assert(mModelCount <= mMaxModelCount);
+  assert(ownOccluderIndices.empty() ||
+         ownOccluderIndices.size() == mModelCount);
+  assert(levelsOfDetail.empty() || levelsOfDetail.size() == mModelCount);
+
+  vector<int> occluderIndices = ownOccluderIndices;
+  occluderIndices.resize(mModelCount, -1);
+  vector<size_t> modelLevelsOfDetail = levelsOfDetail;
+  modelLevelsOfDetail.resize(mModelCount, 0);
+
+  // Bounding boxes, areas and occlusion tests all start from one batch
+  // projection of the models
+  const auto& projectedModels = mModelProjection.project(models, mvpMatrix);
+
+  // Models hidden entirely get no scatter points, which leaves their
+  // histograms empty
+  vector<bool> hiddenModels(mModelCount, false);
+
+  if (mOcclusionProcessor != nullptr) {
+    for (size_t i = 0; i < mModelCount; ++i) {
+      hiddenModels[i] = mOcclusionProcessor->isModelHidden(projectedModels[i],
+                                                           occluderIndices[i]);
+    }
+  }
 
-  setupModelGeometry(models);
-  setupHistogramBuffers(models, mvpMatrix);
+  setupModelGeometry(models, occluderIndices);
+  setupModelBboxes(projectedModels, hiddenModels, modelLevelsOfDetail);
 
-  mModelAreas = computeModelAreas(models, mvpMatrix, BASE_TEXTURE_WIDTH,
-                                  BASE_TEXTURE_HEIGHT);
+  mModelAreas = computeModelAreas(projectedModels, mWorkingDimensions.first,
+                                  mWorkingDimensions.second);
+}
+
+
+void ForegroundHistogramProcessor::setOccluders(const ModelOcclusionProcessor* occlusionProcessor) {
+  if (occlusionProcessor != nullptr && mCullingGlslProgram == 0)
+    mCullingGlslProgram = buildReductionGlslProgram(mMvpMatrix, true);
+
+  mOcclusionProcessor = occlusionProcessor;
 }
 
 
 ForegroundHistogramProcessor::~ForegroundHistogramProcessor() {
   glDeleteProgram(mHistogramGlslProgram);
+  glDeleteProgram(mCullingGlslProgram);
   glDeleteBuffers(1, &mModelVertexBuffer);
   glDeleteBuffers(1, &mModelIndexBuffer);
-  glDeleteBuffers(1, &mScatterPointsBuffer);
+  glDeleteBuffers(1, &mScatterTemplateBuffer);
+
+  if (mPixelPackBuffer != 0)
+    glDeleteBuffers(1, &mPixelPackBuffer);
+
+  if (mComputeGlslProgram != 0) {
+    glDeleteProgram(mComputeGlslProgram);
+    glDeleteBuffers(1, &mModelBboxBuffer);
+    glDeleteBuffers(1, &mBinCountBuffer);
+  }
 
   glDeleteProgram(std::get<0>(mReductionFboSpecs[0]));
+}
+
 
-  glDeleteFramebuffers(mHistogramFbos.size(), mHistogramFbos.data());
-  glDeleteTextures(mHistogramTextures.size(), mHistogramTextures.data());
-  glDeleteFramebuffers(mForegroundFbos.size(), mForegroundFbos.data());
-  glDeleteTextures(mForegroundTextures.size(), mForegroundTextures.data());
+size_t ForegroundHistogramProcessor::inputPyramidLevel() const {
+  return pyramidLevelForWidth(mWorkingDimensions.first);
 }
 
 
 void ForegroundHistogramProcessor::setupReductionGlslPrograms(const glm::mat4& mvpMatrix) {
-  GLuint mainGlslProgram = gles_utils::GlslProgramBuilder()
+  mReductionFboSpecs.push_back(
+      std::make_tuple(buildReductionGlslProgram(mvpMatrix, false),
+                      mWorkingDimensions.first, mWorkingDimensions.second));
+}
+
+
+GLuint ForegroundHistogramProcessor::buildReductionGlslProgram(const glm::mat4& mvpMatrix,
+                                                               bool isOcclusionCulling)
+{
+  // An HSV input texture saves converting every rasterised model pixel
+  string defines = mHasHsvInput ? "#define HSV_INPUT\n" : "";
+
+  if (isOcclusionCulling)
+    defines += "#define OCCLUSION_CULLING\n";
+
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
     .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceString(defines)
                     .appendSourceFile("glsl/transformation.vert")
                     .compile())
     .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString(defines)
                     .appendSourceFile("glsl/include/color-space.frag")
+                    .appendSourceFile("glsl/include/occlusion-depth.frag")
                     .appendSourceFile("glsl/histogram-foreground.frag")
                     .compile())
     .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
     .bindAttribLocation(VertexAttributeLocations::kColor, "vertexColor")
     .bindAttribLocation(VertexAttributeLocations::kCellOffset, "cellOffset")
+    .bindAttribLocation(VertexAttributeLocations::kOwnOccluderNumber,
+                        "ownOccluderNumber")
     .link();
 
-  glUseProgram(mainGlslProgram);
-  glUniform2f(glGetUniformLocation(mainGlslProgram, "viewportDimensions"),
+  glUseProgram(glslProgram);
+  glUniform2f(glGetUniformLocation(glslProgram, "viewportDimensions"),
               mFrameProperties.dimensions().first,
               mFrameProperties.dimensions().second);
-  glUniformMatrix4fv(glGetUniformLocation(mainGlslProgram, "projectionMatrix"),
+  glUniformMatrix4fv(glGetUniformLocation(glslProgram, "projectionMatrix"),
                      1, GL_FALSE, glm::value_ptr(mvpMatrix));
-  glUniform1i(glGetUniformLocation(mainGlslProgram, "tex"), 0);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+  glUniform1i(glGetUniformLocation(glslProgram, "occluderTexture"), 1);
   assertNoGlError();
 
-  mReductionFboSpecs.push_back(std::make_tuple(mainGlslProgram,
-                                               BASE_TEXTURE_WIDTH,
-                                               BASE_TEXTURE_HEIGHT));
+  return glslProgram;
 }
 
 
 void ForegroundHistogramProcessor::addModelForegroundFbo() {
-  // Prepare a texture to store the foreground of the model
-  GLuint averageTexture;
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &averageTexture);
-  glBindTexture(GL_TEXTURE_2D, averageTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-               MODEL_GRID_WIDTH * BASE_TEXTURE_WIDTH,
-               MODEL_GRID_HEIGHT * BASE_TEXTURE_HEIGHT, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
-
-  // Prepare an FBO to store the foreground of the model
-  GLuint averageFbo;
-  glGenFramebuffers(1, &averageFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, averageFbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                         GL_TEXTURE_2D, averageTexture, 0);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
+  // Prepare a texture-backed FBO to store the foreground of the models
+  GLuint averageTexture, averageFbo;
+  std::tie(averageTexture, averageFbo) = generateTextureBackedFbo(
+      std::make_pair(MODEL_GRID_WIDTH * mWorkingDimensions.first,
+                     MODEL_GRID_HEIGHT * mWorkingDimensions.second));
 
   mForegroundTextures.push_back(averageTexture);
   mForegroundFbos.push_back(averageFbo);
@@ -174,29 +402,13 @@ void ForegroundHistogramProcessor::addModelForegroundFbo() {
 
 
 void ForegroundHistogramProcessor::addHistogramFbo() {
-  // Prepare a texture to store the foreground histogram of the model
-  GLuint histogramTexture;
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &histogramTexture);
-  glBindTexture(GL_TEXTURE_2D, histogramTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-               MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH,
-               MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
-
-  // Prepare an FBO to store the foreground histogram of the model
-  GLuint histogramFbo;
-  glGenFramebuffers(1, &histogramFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, histogramFbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                         GL_TEXTURE_2D, histogramTexture, 0);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
+  // Prepare a texture-backed FBO to store the foreground histograms of
+  // the models
+  GLuint histogramTexture, histogramFbo;
+  std::tie(histogramTexture, histogramFbo) = generateTextureBackedFbo(
+      std::make_pair(MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH,
+                     MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT),
+      mHistogramType);
 
   mHistogramTextures.push_back(histogramTexture);
   mHistogramFbos.push_back(histogramFbo);
@@ -216,101 +428,194 @@ void ForegroundHistogramProcessor::setupFbos(size_t modelCount) {
 }
 
 
-void ForegroundHistogramProcessor::setupHistogramBuffers(const std::vector<ModelData>& models,
-                                                         const glm::mat4& mvpMatrix)
-{
-  size_t pointOffset = 0, fboScatterPointCount = 0;
-  vector<tuple<uint_fast16_t, uint_fast16_t, uint_fast16_t, uint_fast16_t>> bboxVertices;
-  size_t totalScatterPointCount = 0;
-  uint_fast16_t modelNumber = 0;
+void ForegroundHistogramProcessor::accumulateHistogramFbo(uint_fast32_t* binCounts) {
+  utils::Profiler::Span readbackSpan(*mProfiler,
+                                     "foreground_histogram.readback");
 
-  for (auto& model : models) {
-    GLfloat xMin = mFrameProperties.dimensions().first, xMax = 0.0f;
-    GLfloat yMin = mFrameProperties.dimensions().second, yMax = 0.0f;
+  vector<GLubyte> histogramData(histogramFboByteCount());
+  glReadPixels(0, 0, HISTOGRAM_FBO_WIDTH, HISTOGRAM_FBO_HEIGHT, GL_RGBA,
+               mHistogramType, histogramData.data());
+  assertNoGlError();
 
-    for (size_t i = 0; i < model.first.size(); i += 3) {
-      glm::vec4 vertexVector(model.first[i], model.first[i + 1],
-                             model.first[i + 2], 1.0);
-      glm::vec4 projectedPosition = mvpMatrix * vertexVector;
-      glm::vec2 normalizedPosition(projectedPosition.x / projectedPosition.z,
-                                   projectedPosition.y / projectedPosition.z);
-
-      if (normalizedPosition.x > xMax)
-        xMax = normalizedPosition.x;
-      if (normalizedPosition.x < xMin)
-        xMin = normalizedPosition.x;
-      if (normalizedPosition.y > yMax)
-        yMax = normalizedPosition.y;
-      if (normalizedPosition.y < yMin)
-        yMin = normalizedPosition.y;
+  accumulateHistogramData(histogramData.data(), binCounts);
+}
+
+
+void ForegroundHistogramProcessor::accumulateHistogramData(const void* histogramData,
+                                                           uint_fast32_t* binCounts) const
+{
+  // Every bin sums the four channels of its pixel
+  const size_t binCount = HISTOGRAM_FBO_WIDTH * HISTOGRAM_FBO_HEIGHT;
+
+  if (mHistogramType == GL_HALF_FLOAT_OES) {
+    auto halfData = static_cast<const GLushort*>(histogramData);
+
+    for (size_t i = 0; i < binCount; ++i) {
+      float bucketValue = halfToFloat(halfData[4 * i]) +
+                          halfToFloat(halfData[4 * i + 1]) +
+                          halfToFloat(halfData[4 * i + 2]) +
+                          halfToFloat(halfData[4 * i + 3]);
+      binCounts[i] += std::lround(bucketValue);
     }
+  } else {
+    auto byteData = static_cast<const GLubyte*>(histogramData);
 
-    xMin = glm::clamp(xMin / mFrameProperties.dimensions().first, 0.0f, 1.0f);
-    xMax = glm::clamp(xMax / mFrameProperties.dimensions().first, 0.0f, 1.0f);
-    yMin = glm::clamp(yMin / mFrameProperties.dimensions().second, 0.0f, 1.0f);
-    yMax = glm::clamp(yMax / mFrameProperties.dimensions().second, 0.0f, 1.0f);
+    for (size_t i = 0; i < binCount; ++i) {
+      binCounts[i] += byteData[4 * i] + byteData[4 * i + 1] +
+                      byteData[4 * i + 2] + byteData[4 * i + 3];
+    }
+  }
+}
 
-    uint_fast16_t xMinInt = glm::floor(xMin * BASE_TEXTURE_WIDTH);
-    uint_fast16_t xMaxInt = glm::ceil(xMax * BASE_TEXTURE_WIDTH);
-    uint_fast16_t yMinInt = glm::floor(yMin * BASE_TEXTURE_HEIGHT);
-    uint_fast16_t yMaxInt = glm::ceil(yMax * BASE_TEXTURE_HEIGHT);
 
-    bboxVertices.push_back(std::make_tuple(xMinInt, xMaxInt, yMinInt, yMaxInt));
-    size_t modelScatterPointCount = (xMaxInt - xMinInt) * (yMaxInt - yMinInt);
-    fboScatterPointCount += modelScatterPointCount;
-    totalScatterPointCount += modelScatterPointCount;
+size_t ForegroundHistogramProcessor::histogramFboByteCount() const {
+  size_t channelSize = (mHistogramType == GL_HALF_FLOAT_OES) ? 2 : 1;
+  return HISTOGRAM_FBO_WIDTH * HISTOGRAM_FBO_HEIGHT * 4 * channelSize;
+}
 
-    if (++modelNumber % MODEL_GRID_MODEL_COUNT == 0) {
-      mHistogramFboSpecs.push_back(std::make_pair(pointOffset,
-                                                  fboScatterPointCount));
-      pointOffset += fboScatterPointCount;
-      fboScatterPointCount = 0;
-    }
+
+void ForegroundHistogramProcessor::reservePixelPackBuffer(size_t passCount) {
+  mQueuedReadbackFbos.clear();
+
+#ifdef GLIPF_GLES3
+  size_t requiredSize = passCount * histogramFboByteCount();
+
+  if (requiredSize > mPixelPackBufferSize) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, mPixelPackBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, requiredSize, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mPixelPackBufferSize = requiredSize;
   }
+#else
+  (void)passCount;
+#endif
+}
 
-  if (fboScatterPointCount > 0)
-    mHistogramFboSpecs.push_back(std::make_pair(pointOffset,
-                                                fboScatterPointCount));
 
-  GLfloat* pointData = new GLfloat[totalScatterPointCount * 3];
-  size_t pointDataOffset = 0;
-  modelNumber = 0;
+void ForegroundHistogramProcessor::queueHistogramReadback(size_t fboIndex) {
+#ifdef GLIPF_GLES3
+  // With a pixel pack buffer bound, glReadPixels only schedules the copy
+  size_t offset = mQueuedReadbackFbos.size() * histogramFboByteCount();
+  assert(offset + histogramFboByteCount() <= mPixelPackBufferSize);
 
-  for (auto& bboxVertexSet : bboxVertices) {
-    auto modelGridCellNumber = (modelNumber++ % MODEL_GRID_MODEL_COUNT);
-    auto modelGridLocX = modelGridCellNumber %
-                         (MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH);
-    auto modelGridLocY = modelGridCellNumber /
-                         (MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH);
-    uint_fast16_t xMinInt, xMaxInt, yMinInt, yMaxInt;
-    std::tie(xMinInt, xMaxInt, yMinInt, yMaxInt) = bboxVertexSet;
-
-    for (size_t i = yMinInt; i < yMaxInt; ++i) {
-      for (size_t j = xMinInt; j < xMaxInt; ++j) {
-        pointData[pointDataOffset++] =
-            ((modelGridLocX / MODELS_PER_GRID_CELL) * BASE_TEXTURE_WIDTH + j) /
-                static_cast<GLfloat>(MODEL_GRID_WIDTH * BASE_TEXTURE_WIDTH) +
-            HALF_BASE_TEXEL_WIDTH;
-        pointData[pointDataOffset++] =
-            (modelGridLocY * BASE_TEXTURE_HEIGHT + i) /
-                static_cast<GLfloat>(MODEL_GRID_HEIGHT * BASE_TEXTURE_HEIGHT) +
-            HALF_BASE_TEXEL_HEIGHT;
-        pointData[pointDataOffset++] = modelGridCellNumber % 2;
-      }
-    }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, mPixelPackBuffer);
+  glReadPixels(0, 0, HISTOGRAM_FBO_WIDTH, HISTOGRAM_FBO_HEIGHT, GL_RGBA,
+               mHistogramType, reinterpret_cast<GLvoid*>(offset));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  assertNoGlError();
+#endif
+
+  mQueuedReadbackFbos.push_back(fboIndex);
+}
+
+
+void ForegroundHistogramProcessor::accumulateQueuedReadbacks(uint_fast32_t* binCounts,
+                                                             size_t fboBinCount)
+{
+#ifdef GLIPF_GLES3
+  // Mapping an empty range is an error
+  if (mQueuedReadbackFbos.empty())
+    return;
+
+  utils::Profiler::Span readbackSpan(*mProfiler,
+                                     "foreground_histogram.readback");
+
+  const size_t sliceSize = histogramFboByteCount();
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, mPixelPackBuffer);
+  auto histogramData = static_cast<const GLubyte*>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                       mQueuedReadbackFbos.size() * sliceSize,
+                       GL_MAP_READ_BIT));
+  assert(histogramData != nullptr);
+
+  for (size_t i = 0; i < mQueuedReadbackFbos.size(); ++i) {
+    accumulateHistogramData(histogramData + i * sliceSize,
+                            binCounts + mQueuedReadbackFbos[i] * fboBinCount);
   }
 
-  glBindBuffer(GL_ARRAY_BUFFER, mScatterPointsBuffer);
-  glBufferData(GL_ARRAY_BUFFER, totalScatterPointCount * 3 * sizeof(GLfloat),
-               pointData, GL_STATIC_DRAW);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  assertNoGlError();
+#else
+  (void)binCounts;
+  (void)fboBinCount;
+#endif
+}
+
+
+void ForegroundHistogramProcessor::setupScatterTemplate() {
+  // Scatter points only hold their index; the vertex shader lays the
+  // first width * height of them out over the bounding box of a model,
+  // so a single template uploaded once serves every model
+  vector<GLfloat> pointIndices(mWorkingDimensions.first *
+                               mWorkingDimensions.second);
+
+  for (size_t i = 0; i < pointIndices.size(); ++i)
+    pointIndices[i] = i;
+
+  glGenBuffers(1, &mScatterTemplateBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, mScatterTemplateBuffer);
+  glBufferData(GL_ARRAY_BUFFER, pointIndices.size() * sizeof(GLfloat),
+               pointIndices.data(), GL_STATIC_DRAW);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   assertNoGlError();
+}
+
+
+void ForegroundHistogramProcessor::setupModelBboxes(const vector<utils::ProjectedModel>& projectedModels,
+                                                    const vector<bool>& hiddenModels,
+                                                    const vector<size_t>& levelsOfDetail)
+{
+  mModelBboxes.clear();
+
+  for (size_t modelNumber = 0; modelNumber < projectedModels.size();
+       ++modelNumber)
+  {
+    const auto& projectedModel = projectedModels[modelNumber];
+    GLfloat xMin = projectedModel.bboxMin.x, xMax = projectedModel.bboxMax.x;
+    GLfloat yMin = projectedModel.bboxMin.y, yMax = projectedModel.bboxMax.y;
+
+    xMin = glm::clamp(xMin / mFrameProperties.dimensions().first, 0.0f, 1.0f);
+    xMax = glm::clamp(xMax / mFrameProperties.dimensions().first, 0.0f, 1.0f);
+    yMin = glm::clamp(yMin / mFrameProperties.dimensions().second, 0.0f, 1.0f);
+    yMax = glm::clamp(yMax / mFrameProperties.dimensions().second, 0.0f, 1.0f);
+
+    uint_fast16_t xMinInt = glm::floor(xMin * mWorkingDimensions.first);
+    uint_fast16_t xMaxInt = glm::ceil(xMax * mWorkingDimensions.first);
+    uint_fast16_t yMinInt = glm::floor(yMin * mWorkingDimensions.second);
+    uint_fast16_t yMaxInt = glm::ceil(yMax * mWorkingDimensions.second);
+
+    assert(levelsOfDetail[modelNumber] <= kMaxLevelOfDetail);
+
+    // Samples are taken at the top left of every step-sized block of the
+    // bounding box, and stand for all pixels of the box
+    ModelBbox bbox;
+    bbox.x = xMinInt;
+    bbox.y = yMinInt;
+    bbox.sampleStep = 1 << levelsOfDetail[modelNumber];
+    bbox.columnCount = (xMaxInt - xMinInt + bbox.sampleStep - 1) /
+                       bbox.sampleStep;
+    bbox.rowCount = (yMaxInt - yMinInt + bbox.sampleStep - 1) /
+                    bbox.sampleStep;
+    bbox.sampleWeight = 1.0f;
+
+    if (bbox.columnCount * bbox.rowCount > 0) {
+      bbox.sampleWeight = float((xMaxInt - xMinInt) * (yMaxInt - yMinInt)) /
+                          (bbox.columnCount * bbox.rowCount);
+    }
+
+    if (hiddenModels[modelNumber])
+      bbox.columnCount = 0;
 
-  delete[] pointData;
+    mModelBboxes.push_back(bbox);
+  }
 }
 
 
-void ForegroundHistogramProcessor::setupModelGeometry(const std::vector<ModelData>& models) {
+void ForegroundHistogramProcessor::setupModelGeometry(const std::vector<ModelData>& models,
+                                                      const vector<int>& ownOccluderIndices)
+{
   size_t vertexCount = 0, indexCount = 0, fboIndexCount = 0;
   ptrdiff_t vertexOffset = 0;
   ptrdiff_t indexOffset = 0;
@@ -336,7 +641,9 @@ void ForegroundHistogramProcessor::setupModelGeometry(const std::vector<ModelDat
                                                 indexOffset * sizeof(GLushort),
                                                 fboIndexCount));
 
-  GLfloat vertexData[vertexCount * 3];
+  // Every vertex holds its position, color, grid cell offset and the
+  // number of the occluder its model belongs to
+  GLfloat vertexData[vertexCount / 3 * 10];
   GLushort indexData[indexCount];
   memset(vertexData, 0, sizeof(vertexData));
   indexOffset = 0;
@@ -349,21 +656,24 @@ void ForegroundHistogramProcessor::setupModelGeometry(const std::vector<ModelDat
     auto modelGridLocX = modelGridCellNumber % MODEL_GRID_WIDTH;
     auto modelGridLocY = modelGridCellNumber / MODEL_GRID_WIDTH;
 
-    for (size_t i = 0; i < model.first.size(); i += 3) {
-      memcpy(vertexData + vertexOffset + i * 3, model.first.data() + i,
-             3 * sizeof(GLfloat));
+    GLfloat ownOccluderNumber = ownOccluderIndices[modelNumber] + 1;
 
-      vertexData[vertexOffset + i * 3 + 3 + modelColorChannel] = 1.0;
-      vertexData[vertexOffset + i * 3 + 4 + modelColorChannel] = 1.0;
-      vertexData[vertexOffset + i * 3 + 7] = modelGridLocX;
-      vertexData[vertexOffset + i * 3 + 8] = modelGridLocY;
+    for (size_t i = 0; i < model.first.size(); i += 3) {
+      GLfloat* vertex = vertexData + vertexOffset + i / 3 * 10;
+      memcpy(vertex, model.first.data() + i, 3 * sizeof(GLfloat));
+
+      vertex[3 + modelColorChannel] = 1.0;
+      vertex[4 + modelColorChannel] = 1.0;
+      vertex[7] = modelGridLocX;
+      vertex[8] = modelGridLocY;
+      vertex[9] = ownOccluderNumber;
     }
 
     for (size_t i = 0; i < model.second.size(); ++i)
-      indexData[indexOffset + i] = model.second[i] + vertexOffset / 9;
+      indexData[indexOffset + i] = model.second[i] + vertexOffset / 10;
 
     modelNumber++;
-    vertexOffset += model.first.size() * 3;
+    vertexOffset += model.first.size() / 3 * 10;
     indexOffset += model.second.size();
   }
 
@@ -381,7 +691,216 @@ void ForegroundHistogramProcessor::setupModelGeometry(const std::vector<ModelDat
 }
 
 
+void ForegroundHistogramProcessor::setupHistogramCompute() {
+#ifdef GLIPF_GLES3
+  // The histogram layout is passed on as defines, which have to follow
+  // the #version directive
+  string computeDefines = "#version 310 es\n"
+    "#define HISTOGRAM_WIDTH " + std::to_string(HISTOGRAM_TEXTURE_WIDTH) + "u\n"
+    "#define HISTOGRAM_HEIGHT " + std::to_string(HISTOGRAM_TEXTURE_HEIGHT) + "u\n"
+    "#define MODEL_GRID_WIDTH " + std::to_string(MODEL_GRID_WIDTH) + "u\n"
+    "#define MODEL_GRID_HEIGHT " + std::to_string(MODEL_GRID_HEIGHT) + "u\n"
+    "#define MODELS_PER_GRID_CELL " + std::to_string(MODELS_PER_GRID_CELL) + "u\n";
+
+  mComputeGlslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_COMPUTE_SHADER)
+                    .appendSourceString(computeDefines)
+                    .appendSourceFile("glsl/histogram-compute.comp")
+                    .compile())
+    .link();
+
+  glUseProgram(mComputeGlslProgram);
+  glUniform1i(glGetUniformLocation(mComputeGlslProgram, "tex"), 2);
+  glUniform2ui(glGetUniformLocation(mComputeGlslProgram, "cellDimensions"),
+               mWorkingDimensions.first, mWorkingDimensions.second);
+  mFirstModelNumberLocation = glGetUniformLocation(mComputeGlslProgram,
+                                                   "firstModelNumber");
+
+  glGenBuffers(1, &mModelBboxBuffer);
+  glGenBuffers(1, &mBinCountBuffer);
+  assertNoGlError();
+#endif
+}
+
+
+void ForegroundHistogramProcessor::dispatchHistogramCompute(size_t fboCount) {
+#ifdef GLIPF_GLES3
+  utils::Profiler::Span computeSpan(*mProfiler,
+                                    "foreground_histogram.compute");
+
+  // Sample columns and rows are all a workgroup needs to walk the
+  // bounding box of its model; the origin is packed in one component
+  vector<GLuint> modelBboxes;
+  modelBboxes.reserve(4 * mModelCount);
+
+  for (const auto& bbox : mModelBboxes) {
+    modelBboxes.push_back(bbox.x | (bbox.y << 16));
+    modelBboxes.push_back(bbox.columnCount);
+    modelBboxes.push_back(bbox.rowCount);
+    modelBboxes.push_back(bbox.sampleStep);
+  }
+
+  const size_t binCount = fboCount * MODELS_PER_GRID_CELL * MODEL_GRID_AREA *
+                          HISTOGRAM_TEXTURE_AREA;
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mModelBboxBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, modelBboxes.size() * sizeof(GLuint),
+               modelBboxes.data(), GL_STREAM_DRAW);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mBinCountBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, binCount * sizeof(GLuint), nullptr,
+               GL_STREAM_READ);
+
+  glUseProgram(mComputeGlslProgram);
+  glActiveTexture(GL_TEXTURE2);
+
+  // Every workgroup builds the histogram of one model; the models of
+  // each foreground atlas take one dispatch, all writing to the same
+  // bin count buffer
+  for (size_t fboIndex = 0; fboIndex < fboCount; ++fboIndex) {
+    size_t firstModelNumber = fboIndex * MODEL_GRID_MODEL_COUNT;
+    size_t modelCount = std::min(mModelCount - firstModelNumber,
+                                 size_t(MODEL_GRID_MODEL_COUNT));
+
+    glBindTexture(GL_TEXTURE_2D, mForegroundTextures[fboIndex]);
+    glUniform1ui(mFirstModelNumberLocation, firstModelNumber);
+    glDispatchCompute(modelCount, 1, 1);
+  }
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  assertNoGlError();
+#else
+  (void)fboCount;
+#endif
+}
+
+
+void ForegroundHistogramProcessor::accumulateComputedHistograms(uint_fast32_t* binCounts,
+                                                                size_t binCount)
+{
+#ifdef GLIPF_GLES3
+  // Mapping an empty range is an error
+  if (binCount == 0)
+    return;
+
+  utils::Profiler::Span readbackSpan(*mProfiler,
+                                     "foreground_histogram.readback");
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBinCountBuffer);
+  auto computedBinCounts = static_cast<const GLuint*>(
+      glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, binCount * sizeof(GLuint),
+                       GL_MAP_READ_BIT));
+  assert(computedBinCounts != nullptr);
+
+  std::copy(computedBinCounts, computedBinCounts + binCount, binCounts);
+
+  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  assertNoGlError();
+#else
+  (void)binCounts;
+  (void)binCount;
+#endif
+}
+
+
+void ForegroundHistogramProcessor::scatterHistograms(uint_fast32_t* binCounts,
+                                                     size_t fboCount,
+                                                     size_t fboBinCount)
+{
+  // Every scattered point adds one to a channel picked by its index, so
+  // no channel can overflow while at most mPassPointCount points of a
+  // model are scattered; models with more points are split over several
+  // passes whose counts are summed on readback.
+  glActiveTexture(GL_TEXTURE2);
+  glBindBuffer(GL_ARRAY_BUFFER, mScatterTemplateBuffer);
+  glVertexAttribPointer(VertexAttributeLocations::kPosition, 1, GL_FLOAT,
+                        GL_FALSE, 0, 0);
+
+  glViewport(0, 0,
+             MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH,
+             MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT);
+  glUseProgram(mHistogramGlslProgram);
+
+  vector<GLsizei> passCounts(fboCount, 1);
+  size_t totalPassCount = 0;
+
+  for (size_t fboIndex = 0; fboIndex < fboCount; ++fboIndex) {
+    size_t firstModelNumber = fboIndex * MODEL_GRID_MODEL_COUNT;
+    size_t lastModelNumber = std::min(firstModelNumber + MODEL_GRID_MODEL_COUNT,
+                                      mModelCount);
+
+    for (size_t i = firstModelNumber; i < lastModelNumber; ++i) {
+      GLsizei scatterPointCount = mModelBboxes[i].columnCount *
+                                  mModelBboxes[i].rowCount;
+      passCounts[fboIndex] = std::max(passCounts[fboIndex],
+                                      (scatterPointCount + mPassPointCount - 1) /
+                                      mPassPointCount);
+    }
+
+    totalPassCount += passCounts[fboIndex];
+  }
+
+  if (mHasPixelPackBuffers)
+    reservePixelPackBuffer(totalPassCount);
+
+  for (size_t fboIndex = 0; fboIndex < fboCount; ++fboIndex) {
+    size_t firstModelNumber = fboIndex * MODEL_GRID_MODEL_COUNT;
+    size_t lastModelNumber = std::min(firstModelNumber + MODEL_GRID_MODEL_COUNT,
+                                      mModelCount);
+    GLsizei passCount = passCounts[fboIndex];
+
+    glBindTexture(GL_TEXTURE_2D, mForegroundTextures[fboIndex]);
+    glBindFramebuffer(GL_FRAMEBUFFER, mHistogramFbos[fboIndex]);
+
+    for (GLsizei pass = 0; pass < passCount; ++pass) {
+      GLint firstPoint = pass * mPassPointCount;
+      glClear(GL_COLOR_BUFFER_BIT);
+
+      for (size_t modelNumber = firstModelNumber; modelNumber < lastModelNumber;
+           ++modelNumber)
+      {
+        const auto& bbox = mModelBboxes[modelNumber];
+        GLsizei scatterPointCount = bbox.columnCount * bbox.rowCount;
+
+        if (scatterPointCount <= firstPoint)
+          continue;
+
+        auto modelGridCellNumber = modelNumber % MODEL_GRID_MODEL_COUNT;
+        auto modelGridLocX = modelGridCellNumber %
+                             (MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH);
+        auto modelGridLocY = modelGridCellNumber /
+                             (MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH);
+
+        glUniform2f(mCellOriginLocation,
+                    (modelGridLocX / MODELS_PER_GRID_CELL) *
+                        mWorkingDimensions.first,
+                    modelGridLocY * mWorkingDimensions.second);
+        glUniform1f(mChannelPairLocation, modelGridCellNumber % 2);
+        glUniform4f(mModelBboxLocation, bbox.x, bbox.y, bbox.columnCount,
+                    bbox.sampleStep);
+        glDrawArrays(GL_POINTS, firstPoint,
+                     std::min(scatterPointCount - firstPoint, mPassPointCount));
+      }
+
+      // Carry the counts of all but the last pass over before
+      // the next pass clears them; the last pass stays in the FBO until
+      // a result is read. With pixel pack buffers, every pass is queued
+      // for readback instead, and nothing waits for the GPU here.
+      if (mHasPixelPackBuffers)
+        queueHistogramReadback(fboIndex);
+      else if (pass + 1 < passCount)
+        accumulateHistogramFbo(binCounts + fboIndex * fboBinCount);
+    }
+  }
+
+  glDisable(GL_BLEND);
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+}
+
+
 const ProcessingResultSet& ForegroundHistogramProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "foreground_histogram.process");
+
   auto reductionSpecIter = std::begin(mReductionFboSpecs);
   GLuint reductionGlslProgram;
   uint_fast16_t fboWidth, fboHeight;
@@ -390,6 +909,13 @@ const ProcessingResultSet& ForegroundHistogramProcessor::process(GLuint frameTex
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, frameTexture);
 
+  if (mOcclusionProcessor != nullptr) {
+    reductionGlslProgram = mCullingGlslProgram;
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, mOcclusionProcessor->occlusionTexture());
+    glEnableVertexAttribArray(VertexAttributeLocations::kOwnOccluderNumber);
+  }
+
   glEnable(GL_BLEND);
   glBlendFunc(GL_ONE, GL_ONE);
   glBlendEquation(GL_FUNC_ADD);
@@ -404,13 +930,16 @@ const ProcessingResultSet& ForegroundHistogramProcessor::process(GLuint frameTex
   glBindBuffer(GL_ARRAY_BUFFER, mModelVertexBuffer);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mModelIndexBuffer);
   glVertexAttribPointer(VertexAttributeLocations::kPosition, 3, GL_FLOAT,
-                        GL_FALSE, 9 * sizeof(GLfloat), 0);
+                        GL_FALSE, 10 * sizeof(GLfloat), 0);
   glVertexAttribPointer(VertexAttributeLocations::kColor, 4, GL_FLOAT,
-                        GL_FALSE, 9 * sizeof(GLfloat),
+                        GL_FALSE, 10 * sizeof(GLfloat),
                         (GLvoid*)(3 * sizeof(GLfloat)));
   glVertexAttribPointer(VertexAttributeLocations::kCellOffset, 2, GL_FLOAT,
-                        GL_FALSE, 9 * sizeof(GLfloat),
+                        GL_FALSE, 10 * sizeof(GLfloat),
                         (GLvoid*)(7 * sizeof(GLfloat)));
+  glVertexAttribPointer(VertexAttributeLocations::kOwnOccluderNumber, 1,
+                        GL_FLOAT, GL_FALSE, 10 * sizeof(GLfloat),
+                        (GLvoid*)(9 * sizeof(GLfloat)));
 
   auto foregroundFboIter = std::begin(mForegroundFbos);
 
@@ -423,98 +952,98 @@ const ProcessingResultSet& ForegroundHistogramProcessor::process(GLuint frameTex
     assertNoGlError();
   }
 
-  // Step 2: compute histograms by scattering points
   glDisableVertexAttribArray(VertexAttributeLocations::kColor);
   glDisableVertexAttribArray(VertexAttributeLocations::kCellOffset);
-  glActiveTexture(GL_TEXTURE2);
-  glBindBuffer(GL_ARRAY_BUFFER, mScatterPointsBuffer);
-  glVertexAttribPointer(VertexAttributeLocations::kPosition, 3, GL_FLOAT,
-                        GL_FALSE, 3 * sizeof(GLfloat), 0);
-
-  glViewport(0, 0,
-             MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH,
-             MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT);
-  glUseProgram(mHistogramGlslProgram);
-
-  auto foregroundTextureIter = std::begin(mForegroundTextures);
-  auto histogramFboIter = std::begin(mHistogramFbos);
-
-  for (auto& histogramFboSpec : mHistogramFboSpecs) {
-    glBindTexture(GL_TEXTURE_2D, *(foregroundTextureIter++));
-    glBindFramebuffer(GL_FRAMEBUFFER, *(histogramFboIter++));
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_POINTS, std::get<0>(histogramFboSpec),
-                 std::get<1>(histogramFboSpec));
+  glDisableVertexAttribArray(VertexAttributeLocations::kOwnOccluderNumber);
+
+  const size_t fboCount = (mModelCount + MODEL_GRID_MODEL_COUNT - 1) /
+                          MODEL_GRID_MODEL_COUNT;
+  const size_t fboBinCount = MODELS_PER_GRID_CELL * MODEL_GRID_AREA *
+                             HISTOGRAM_TEXTURE_WIDTH *
+                             HISTOGRAM_TEXTURE_HEIGHT;
+  auto binCounts =
+      std::make_shared<vector<uint_fast32_t>>(fboCount * fboBinCount, 0);
+
+  // Step 2: compute histograms, with a compute shader where available
+  if (mComputeGlslProgram != 0) {
+    glDisable(GL_BLEND);
+    glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+    dispatchHistogramCompute(fboCount);
+  } else {
+    scatterHistograms(binCounts->data(), fboCount, fboBinCount);
   }
 
-  glDisable(GL_BLEND);
-  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+  // Step 3: defer the readback of the last passes and the extraction of
+  // histograms until results are read. All results share one batch, so
+  // the FBOs are read back once however many results are read.
+  auto batch = std::make_shared<LazyNumbers::Batch>(
+      [this, binCounts, fboCount, fboBinCount]() {
+        if (mComputeGlslProgram != 0) {
+          accumulateComputedHistograms(binCounts->data(),
+                                       fboCount * fboBinCount);
+          return;
+        }
 
-  size_t modelNumber = 0;
-  size_t modelCount = mModelCount;
-  auto& totalPixelCounts =
-      boost::get<vector<float>>(mResultSet["total_pixel_counts"]);
-  auto& histogramCoverage =
-      boost::get<vector<float>>(mResultSet["histogram_coverage"]);
-
-  // Step 3: extract histograms
-  for (auto histogramFbo: mHistogramFbos) {
-    glBindFramebuffer(GL_FRAMEBUFFER, histogramFbo);
-    GLubyte pixelData[MODELS_PER_GRID_CELL * MODEL_GRID_AREA *
-                      HISTOGRAM_TEXTURE_WIDTH * HISTOGRAM_TEXTURE_HEIGHT * 4];
-    glReadPixels(0, 0,
-                 MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH,
-                 MODEL_GRID_HEIGHT * HISTOGRAM_TEXTURE_HEIGHT, GL_RGBA,
-                 GL_UNSIGNED_BYTE, pixelData);
-    uint_fast16_t offset = 0;
-
-    for (uint_fast16_t i = 0; i < MODEL_GRID_HEIGHT; ++i) {
-      vector<vector<uint_fast16_t>> histogramVectors(8);
-      vector<uint_fast16_t> histogramTotals(8);
-
-      for (uint_fast16_t j = 0; j < HISTOGRAM_TEXTURE_HEIGHT; ++j) {
-        for (uint_fast16_t k = 0;
-             k < MODELS_PER_GRID_CELL * MODEL_GRID_WIDTH * HISTOGRAM_TEXTURE_WIDTH;
-             k += 1)
-        {
-          uint_fast8_t histogramIndex = k / HISTOGRAM_TEXTURE_WIDTH;
-          uint_fast16_t bucketValue = pixelData[offset] +
-                                      pixelData[offset + 1] +
-                                      pixelData[offset + 2] +
-                                      pixelData[offset + 3];
-
-          histogramVectors[histogramIndex].push_back(bucketValue);
-          histogramTotals[histogramIndex] += bucketValue;
-          offset += 4;
+        if (mHasPixelPackBuffers) {
+          accumulateQueuedReadbacks(binCounts->data(), fboBinCount);
+          return;
         }
-      }
 
-      for (uint_fast8_t j = 0; j < std::min(modelCount, 8u); ++j) {
-        auto& resultHistogram = histogramVectors[j];
-        auto& normalizedHistogram =
-            boost::get<vector<float>>(mResultSet[std::to_string(modelNumber)]);
-        float histogramTotal = histogramTotals[j];
-
-        histogramCoverage[modelNumber] =
-            histogramTotal / mModelAreas[modelNumber];
-        totalPixelCounts[modelNumber++] = histogramTotal;
-
-        if (histogramTotal == 0) {
-          for (uint_fast16_t k = 0; k < HISTOGRAM_TEXTURE_AREA; ++k)
-            normalizedHistogram[k] = 0.0f;
-        } else {
-          for (uint_fast16_t k = 0; k < HISTOGRAM_TEXTURE_AREA; ++k)
-            normalizedHistogram[k] = resultHistogram[k] / histogramTotal;
+        for (size_t fboIndex = 0; fboIndex < fboCount; ++fboIndex) {
+          glBindFramebuffer(GL_FRAMEBUFFER, mHistogramFbos[fboIndex]);
+          accumulateHistogramFbo(binCounts->data() + fboIndex * fboBinCount);
         }
-      }
+      });
 
-      if (modelCount < 8)
-        return mResultSet;
+  vector<float> sampleWeights;
 
-      modelCount -= 8;
-    }
+  for (size_t modelNumber = 0; modelNumber < mModelCount; ++modelNumber) {
+    sampleWeights.push_back(mModelBboxes[modelNumber].sampleWeight);
+
+    mResultSet[std::to_string(modelNumber)] = LazyNumbers(batch,
+        [binCounts, modelNumber](vector<float>& normalizedHistogram) {
+          uint_fast32_t histogramTotal;
+          auto modelBinCounts = extractModelBinCounts(*binCounts, modelNumber,
+                                                      histogramTotal);
+          normalizedHistogram.assign(HISTOGRAM_TEXTURE_AREA, 0.0f);
+
+          if (histogramTotal == 0)
+            return;
+
+          for (uint_fast16_t k = 0; k < HISTOGRAM_TEXTURE_AREA; ++k) {
+            normalizedHistogram[k] = modelBinCounts[k] /
+                                     float(histogramTotal);
+          }
+        });
   }
 
+  // Sampled bins stand for sampleWeight pixels each
+  size_t maxModelCount = mMaxModelCount;
+  auto pixelCounts = [binCounts, sampleWeights, maxModelCount](vector<float>& counts) {
+    counts.assign(maxModelCount, 0.0f);
+
+    for (size_t modelNumber = 0; modelNumber < sampleWeights.size();
+         ++modelNumber)
+    {
+      uint_fast32_t histogramTotal;
+      extractModelBinCounts(*binCounts, modelNumber, histogramTotal);
+      counts[modelNumber] = histogramTotal * sampleWeights[modelNumber];
+    }
+  };
+  vector<double> modelAreas = mModelAreas;
+
+  mResultSet["total_pixel_counts"] = LazyNumbers(batch, pixelCounts);
+  mResultSet["histogram_coverage"] = LazyNumbers(batch,
+      [pixelCounts, modelAreas](vector<float>& coverage) {
+        pixelCounts(coverage);
+
+        for (size_t modelNumber = 0; modelNumber < modelAreas.size();
+             ++modelNumber)
+        {
+          coverage[modelNumber] /= modelAreas[modelNumber];
+        }
+      });
+
   return mResultSet;
 }
 
@@ -0,0 +1,167 @@
+#include <glipf/processors/frame-pyramid-processor.h>
+
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+#include <algorithm>
+#include <string>
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+FramePyramidProcessor::FramePyramidProcessor(const sources::FrameProperties& frameProperties,
+                                             size_t levelCount,
+                                             bool hasHsvInput)
+  : GlesProcessor(frameProperties)
+  , mLevelCount(levelCount)
+  , mHasHsvInput(hasHsvInput)
+  , mReductionGlslProgram(0)
+  , mHsvConversionGlslProgram(0)
+  , mInputTexture(0)
+{
+  assert(mLevelCount > 0);
+
+  mReductionGlslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString(hasHsvInput ? "#define HSV_INPUT\n"
+                                                    : "")
+                    .appendSourceFile("glsl/frame-pyramid/reduction.frag")
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(mReductionGlslProgram);
+  glUniform1i(glGetUniformLocation(mReductionGlslProgram, "tex"), 0);
+  mInputTexelSizeLocation = glGetUniformLocation(mReductionGlslProgram,
+                                                 "inputTexelSize");
+
+  mHsvConversionGlslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceFile("glsl/include/color-space.frag")
+                    .appendSourceFile("glsl/frame-pyramid/hsv-conversion.frag")
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(mHsvConversionGlslProgram);
+  glUniform1i(glGetUniformLocation(mHsvConversionGlslProgram, "tex"), 0);
+  assertNoGlError();
+
+  auto dimensions = frameProperties.dimensions();
+  mLevelDimensions.push_back(dimensions);
+
+  for (size_t i = 1; i <= mLevelCount; ++i) {
+    dimensions = std::make_pair((dimensions.first + 1) / 2,
+                                (dimensions.second + 1) / 2);
+    mLevelDimensions.push_back(dimensions);
+
+    mForegroundTextureFboPairs.push_back(generateTextureBackedFbo(dimensions));
+    mResultSet["pyramid_foreground_" + std::to_string(i)] =
+        mForegroundTextureFboPairs.back().first;
+
+    if (mHasHsvInput)
+      continue;
+
+    mHsvTextureFboPairs.push_back(generateTextureBackedFbo(dimensions));
+    mResultSet["pyramid_hsv_" + std::to_string(i)] =
+        mHsvTextureFboPairs.back().first;
+  }
+}
+
+
+FramePyramidProcessor::~FramePyramidProcessor() {
+  glDeleteProgram(mReductionGlslProgram);
+  glDeleteProgram(mHsvConversionGlslProgram);
+}
+
+
+size_t FramePyramidProcessor::levelCount() const {
+  return mLevelCount;
+}
+
+
+GLuint FramePyramidProcessor::foregroundTexture(size_t level) const {
+  if (level == 0)
+    return mInputTexture;
+
+  return mForegroundTextureFboPairs[std::min(level, mLevelCount) - 1].first;
+}
+
+
+GLuint FramePyramidProcessor::hsvTexture(size_t level) const {
+  if (mHasHsvInput)
+    return foregroundTexture(level);
+
+  level = std::max<size_t>(level, 1);
+
+  return mHsvTextureFboPairs[std::min(level, mLevelCount) - 1].first;
+}
+
+
+GLuint FramePyramidProcessor::textureFor(const GlesProcessor& processor,
+                                         bool isHsv) const
+{
+  size_t level = processor.inputPyramidLevel();
+
+  return isHsv ? hsvTexture(level) : foregroundTexture(level);
+}
+
+
+const ProcessingResultSet& FramePyramidProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "frame_pyramid.process");
+
+  mInputTexture = frameTexture;
+  GLuint inputTexture = frameTexture;
+
+  glActiveTexture(GL_TEXTURE0);
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  for (size_t i = 0; i < mLevelCount; ++i) {
+    const auto& inputDimensions = mLevelDimensions[i];
+    const auto& levelDimensions = mLevelDimensions[i + 1];
+    glViewport(0, 0, levelDimensions.first, levelDimensions.second);
+
+    // Reduce the previous level
+    glBindTexture(GL_TEXTURE_2D, inputTexture);
+    glBindFramebuffer(GL_FRAMEBUFFER, mForegroundTextureFboPairs[i].second);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(mReductionGlslProgram);
+    glUniform2f(mInputTexelSizeLocation, 1.0f / inputDimensions.first,
+                1.0f / inputDimensions.second);
+    drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+    inputTexture = mForegroundTextureFboPairs[i].first;
+
+    if (mHasHsvInput)
+      continue;
+
+    // Convert the new level to HSV
+    glBindTexture(GL_TEXTURE_2D, inputTexture);
+    glBindFramebuffer(GL_FRAMEBUFFER, mHsvTextureFboPairs[i].second);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(mHsvConversionGlslProgram);
+    drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  }
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+  assertNoGlError();
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -0,0 +1,124 @@
+#include <glipf/processors/fused-processor.h>
+
+#include <glipf/gles-utils/glsl-program-cache.h>
+
+#include <set>
+#include <stdexcept>
+#include <string>
+
+
+using std::string;
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+FusedProcessor::FusedProcessor(const sources::FrameProperties& frameProperties,
+                               const vector<const GlesProcessor*>& processors)
+  : GlesProcessor(frameProperties)
+  , mGlslProgram(0)
+{
+  if (!canFuse(processors))
+    throw std::invalid_argument("FusedProcessor: processors can't be fused");
+
+  string programKey;
+
+  for (auto processor : processors) {
+    gles_utils::FragmentStage stage;
+    processor->fragmentStage(stage);
+
+    programKey += stage.functionName + "\n" + stage.defines;
+    mStages.push_back(stage);
+  }
+
+  mGlslProgram = gles_utils::GlslProgramCache::defaultCache().get(
+      programKey, [this]() {
+        return buildFragmentStageGlslProgram(mStages,
+                                             VertexAttributeLocations::kPosition);
+      });
+
+  mResultTextureFboPair =
+      generateTextureBackedFbo(frameProperties.dimensions());
+  mResultSet["fused_texture"] = mResultTextureFboPair.first;
+  mResultSet[mStages.back().outputKey] = mResultTextureFboPair.first;
+}
+
+
+FusedProcessor::~FusedProcessor() {
+  // The program is owned by the cache and the render target by the pool
+}
+
+
+bool FusedProcessor::canFuse(const vector<const GlesProcessor*>& processors) {
+  std::set<string> functionNames;
+  bool isFirstStage = true;
+
+  for (auto processor : processors) {
+    gles_utils::FragmentStage stage;
+
+    if (!processor->fragmentStage(stage))
+      return false;
+
+    // Stages of the same kind would declare the same function and
+    // uniforms twice
+    if (!functionNames.insert(stage.functionName).second)
+      return false;
+
+    // Later stages would resample the frame, losing the work of the
+    // stages before them
+    if (stage.resamplesInput && !isFirstStage)
+      return false;
+
+    isFirstStage = false;
+  }
+
+  return !processors.empty();
+}
+
+
+const ProcessingResultSet& FusedProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "fused.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+
+  GLenum textureUnit = GL_TEXTURE1;
+
+  for (const auto& stage : mStages) {
+    for (const auto& samplerTexturePair : stage.textures) {
+      glActiveTexture(textureUnit++);
+      glBindTexture(GL_TEXTURE_2D, samplerTexturePair.second);
+    }
+  }
+
+  // The program may be shared with chains using other uniform values
+  glUseProgram(mGlslProgram);
+
+  for (const auto& stage : mStages) {
+    if (stage.setupUniforms)
+      stage.setupUniforms(mGlslProgram);
+  }
+
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mResultTextureFboPair.second);
+  glViewport(0, 0, mFrameProperties.dimensions().first,
+             mFrameProperties.dimensions().second);
+  glClear(GL_COLOR_BUFFER_BIT);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -1,6 +1,10 @@
 #include <glipf/processors/gles-processor.h>
 
-#include <opencv2/imgproc/imgproc.hpp>
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+#include <algorithm>
+#include <cmath>
 
 
 using std::vector;
@@ -13,6 +17,7 @@ namespace processors {
 GlesProcessor::GlesProcessor(const sources::FrameProperties& frameProperties)
   : mQuadVertexBuffer(0)
   , mFrameProperties(frameProperties)
+  , mProfiler(&utils::Profiler::defaultProfiler())
 {
   const GLfloat vertex_data[] = {
     -1.0, -1.0, 1.0, 1.0,
@@ -37,63 +42,130 @@ GlesProcessor::~GlesProcessor() {
 }
 
 
-GlesProcessor::TextureFboPair
-GlesProcessor::generateTextureBackedFbo(std::pair<size_t, size_t> dimensions) {
-  // Prepare a texture
-  GLuint texture;
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.first, dimensions.second,
-               0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
+void GlesProcessor::setProfiler(utils::Profiler& profiler) {
+  mProfiler = &profiler;
+}
 
-  // Prepare an FBO
-  GLuint fbo;
-  glGenFramebuffers(1, &fbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         texture, 0);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
 
-  return std::make_pair(texture, fbo);
+void GlesProcessor::setRegionsOfInterest(const vector<utils::RegionOfInterest>& regions) {
+  mRegionsOfInterest = regions;
 }
 
 
-vector<double> GlesProcessor::computeModelAreas(const std::vector<ModelData>& models,
-                                                const glm::mat4& mvpMatrix,
-                                                size_t viewportWidth,
-                                                size_t viewportHeight)
-{
-  glm::vec2 frameDimensions(mFrameProperties.dimensions().first,
-                            mFrameProperties.dimensions().second);
-  glm::vec2 viewportDimensions(viewportWidth, viewportHeight);
-  vector<double> modelAreas;
+size_t GlesProcessor::inputPyramidLevel() const {
+  return 0;
+}
 
-  for (auto& model : models) {
-    vector<cv::Point> points;
 
-    for (size_t i = 0; i < model.first.size(); i += 3) {
-      glm::vec4 vertexVector(model.first[i], model.first[i + 1],
-                             model.first[i + 2], 1.0);
-      glm::vec4 projectedPosition = mvpMatrix * vertexVector;
-      glm::vec2 normalizedPosition(projectedPosition.x / projectedPosition.z,
-                                   projectedPosition.y / projectedPosition.z);
-      normalizedPosition /= frameDimensions;
-      normalizedPosition *= viewportDimensions;
+bool GlesProcessor::fragmentStage(gles_utils::FragmentStage& /*stage*/) const {
+  return false;
+}
+
+
+bool GlesProcessor::setUpdateMask(GLuint /*updateMaskTexture*/) {
+  return false;
+}
+
 
-      points.emplace_back(normalizedPosition.x, normalizedPosition.y);
+GLuint GlesProcessor::buildFragmentStageGlslProgram(const vector<gles_utils::FragmentStage>& stages,
+                                                    GLuint vertexPositionAttribLoc)
+{
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendFragmentStages(stages)
+                    .compile())
+    .bindAttribLocation(vertexPositionAttribLoc, "vertex")
+    .link();
+
+  // The input is always on unit 0 and the stages' own textures follow
+  // in order
+  GLint textureUnit = 1;
+  glUseProgram(glslProgram);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+
+  for (const auto& stage : stages) {
+    for (const auto& samplerTexturePair : stage.textures) {
+      glUniform1i(glGetUniformLocation(glslProgram,
+                                       samplerTexturePair.first.c_str()),
+                  textureUnit++);
     }
 
-    cv::RotatedRect box = cv::minAreaRect(points);
-    modelAreas.push_back(box.size.width * box.size.height);
+    if (stage.setupUniforms)
+      stage.setupUniforms(glslProgram);
   }
 
+  assertNoGlError();
+
+  return glslProgram;
+}
+
+
+size_t GlesProcessor::pyramidLevelForWidth(size_t workingWidth) const {
+  size_t level = 0;
+
+  // Every level halves the frame; stop before dropping below the
+  // working width
+  while ((mFrameProperties.dimensions().first >> (level + 1)) >= workingWidth)
+    ++level;
+
+  return level;
+}
+
+
+std::pair<size_t, size_t> GlesProcessor::workingDimensions(float frameScale,
+                                                         float qualityScale,
+                                                         size_t gridSize) const
+{
+  assert(frameScale > 0.0f && qualityScale > 0.0f && gridSize > 0);
+
+  float scale = frameScale * qualityScale;
+  float width = mFrameProperties.dimensions().first * scale;
+  float height = mFrameProperties.dimensions().second * scale;
+
+  GLint maxTextureSize;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  float maxDimension = float(maxTextureSize) / gridSize;
+  float fitScale = std::min(1.0f, maxDimension / std::max(width, height));
+
+  // Multiples of 4 keep reductions over the working area exact; round
+  // down so that the grid still fits
+  size_t workingWidth = std::max(size_t(width * fitScale) / 4 * 4, size_t(4));
+  size_t workingHeight = std::max(size_t(height * fitScale) / 4 * 4, size_t(4));
+
+  return std::make_pair(workingWidth, workingHeight);
+}
+
+
+GlesProcessor::TextureFboPair
+GlesProcessor::generateTextureBackedFbo(std::pair<size_t, size_t> dimensions,
+                                        GLenum type, bool hasDepthBuffer)
+{
+  mRenderTargetLeases.push_back(
+      gles_utils::RenderTargetPool::defaultPool().acquire(
+          dimensions.first, dimensions.second, type, hasDepthBuffer));
+  const auto& lease = mRenderTargetLeases.back();
+
+  return std::make_pair(lease.texture(), lease.fbo());
+}
+
+
+vector<double> GlesProcessor::computeModelAreas(const vector<utils::ProjectedModel>& projectedModels,
+                                                size_t viewportWidth,
+                                                size_t viewportHeight)
+{
+  // Areas are projected in frame pixels; scaling them to the viewport is
+  // exact as long as it keeps the frame's aspect ratio
+  double areaScale =
+      double(viewportWidth) / mFrameProperties.dimensions().first *
+      viewportHeight / mFrameProperties.dimensions().second;
+  vector<double> modelAreas;
+
+  for (const auto& projectedModel : projectedModels)
+    modelAreas.push_back(projectedModel.area * areaScale);
+
   return modelAreas;
 }
 
@@ -107,5 +179,36 @@ void GlesProcessor::drawFullscreenQuad(GLuint vertexPositionAttribLoc) {
 }
 
 
+void GlesProcessor::drawRegionsOfInterest(GLuint vertexPositionAttribLoc) {
+  if (mRegionsOfInterest.empty()) {
+    drawFullscreenQuad(vertexPositionAttribLoc);
+    return;
+  }
+
+  // Regions are given in frame pixels, but the pass may render at a
+  // pyramid level's resolution
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glm::vec2 scale(float(viewport[2]) / mFrameProperties.dimensions().first,
+                  float(viewport[3]) / mFrameProperties.dimensions().second);
+
+  glEnable(GL_SCISSOR_TEST);
+
+  for (const auto& region : mRegionsOfInterest) {
+    GLint xMin = std::floor(region.x * scale.x);
+    GLint yMin = std::floor(region.y * scale.y);
+    GLint xMax = std::ceil((region.x + region.width) * scale.x);
+    GLint yMax = std::ceil((region.y + region.height) * scale.y);
+
+    glScissor(viewport[0] + xMin, viewport[1] + yMin, xMax - xMin,
+              yMax - yMin);
+    drawFullscreenQuad(vertexPositionAttribLoc);
+  }
+
+  glDisable(GL_SCISSOR_TEST);
+  assertNoGlError();
+}
+
+
 } // end namespace processors
 } // end namespace glipf
@@ -0,0 +1,120 @@
+#include <glipf/processors/mask-packing-processor.h>
+
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+
+#define PIXELS_PER_TEXEL 32
+
+
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+MaskPackingProcessor::MaskPackingProcessor(const sources::FrameProperties& frameProperties)
+  : GlesProcessor(frameProperties)
+  , mGlslProgram(0)
+{
+  size_t frameWidth = frameProperties.dimensions().first;
+  size_t frameHeight = frameProperties.dimensions().second;
+  mPackedWidth = (frameWidth + PIXELS_PER_TEXEL - 1) / PIXELS_PER_TEXEL;
+
+  mGlslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceFile("glsl/include/bitmask.frag")
+                    .appendSourceFile("glsl/mask-packing.frag")
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(mGlslProgram);
+  glUniform1i(glGetUniformLocation(mGlslProgram, "tex"), 0);
+  glUniform1f(glGetUniformLocation(mGlslProgram, "inputWidth"), frameWidth);
+  glUniform1f(glGetUniformLocation(mGlslProgram, "packedWidth"),
+              mPackedWidth);
+  glUniform1f(glGetUniformLocation(mGlslProgram, "maskBit"), -1.0f);
+  assertNoGlError();
+
+  mPackedTextureFboPair =
+      generateTextureBackedFbo(std::make_pair(mPackedWidth, frameHeight));
+  mPackedMask.resize(mPackedWidth * frameHeight * 4);
+
+  mResultSet["packed_mask_texture"] = mPackedTextureFboPair.first;
+}
+
+
+MaskPackingProcessor::~MaskPackingProcessor() {
+  glDeleteProgram(mGlslProgram);
+}
+
+
+void MaskPackingProcessor::setMaskBit(int bitIndex) {
+  glUseProgram(mGlslProgram);
+  glUniform1f(glGetUniformLocation(mGlslProgram, "maskBit"), bitIndex);
+  assertNoGlError();
+}
+
+
+const vector<GLubyte>& MaskPackingProcessor::packedMask() const {
+  return mPackedMask;
+}
+
+
+size_t MaskPackingProcessor::packedRowLength() const {
+  return mPackedWidth * 4;
+}
+
+
+void MaskPackingProcessor::unpackMask(cv::Mat& mask) const {
+  size_t frameWidth = mFrameProperties.dimensions().first;
+  size_t frameHeight = mFrameProperties.dimensions().second;
+  size_t rowLength = packedRowLength();
+
+  mask.create(frameHeight, frameWidth, CV_8UC1);
+
+  for (size_t i = 0; i < frameHeight; ++i) {
+    const GLubyte* packedRow = &mPackedMask[i * rowLength];
+    GLubyte* row = mask.ptr<GLubyte>(i);
+
+    for (size_t j = 0; j < frameWidth; ++j)
+      row[j] = (packedRow[j / 8] >> (j % 8) & 1) ? 255 : 0;
+  }
+}
+
+
+const ProcessingResultSet& MaskPackingProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "mask_packing.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mPackedTextureFboPair.second);
+  glViewport(0, 0, mPackedWidth, mFrameProperties.dimensions().second);
+  glUseProgram(mGlslProgram);
+  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  utils::Profiler::Span readbackSpan(*mProfiler, "mask_packing.readback");
+  glReadPixels(0, 0, mPackedWidth, mFrameProperties.dimensions().second,
+               GL_RGBA, GL_UNSIGNED_BYTE, mPackedMask.data());
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -63,44 +63,20 @@ ModelDebugProcessor::ModelDebugProcessor(const sources::FrameProperties& framePr
                      1, GL_FALSE, glm::value_ptr(mvpMatrix));
   assertNoGlError();
 
-  // Prepare a texture to store the model debug image
-  GLuint modelDebugTexture;
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &modelDebugTexture);
-  glBindTexture(GL_TEXTURE_2D, modelDebugTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frameProperties.dimensions().first,
-               frameProperties.dimensions().second, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
-
-  // Prepare an FBO to store the model debug image
-  GLuint modelDebugFbo;
-  glGenFramebuffers(1, &modelDebugFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, modelDebugFbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                         GL_TEXTURE_2D, modelDebugTexture, 0);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
-
-  mTextureFboPair = std::make_pair(modelDebugTexture, modelDebugFbo);
+  // Prepare a texture-backed FBO to store the model debug image
+  mTextureFboPair = generateTextureBackedFbo(frameProperties.dimensions());
 
   glGenBuffers(1, &mModelVertexBuffer);
   glGenBuffers(1, &mModelIndexBuffer);
   assertNoGlError();
 
-  mResultSet["model_debug"] = modelDebugTexture;
+  mResultSet["model_debug"] = std::get<0>(mTextureFboPair);
 }
 
 
 ModelDebugProcessor::~ModelDebugProcessor() {
   glDeleteProgram(mPassthroughGlslProgram);
   glDeleteProgram(mMainGlslProgram);
-  glDeleteFramebuffers(1, &std::get<1>(mTextureFboPair));
-  glDeleteTextures(1, &std::get<0>(mTextureFboPair));
   glDeleteBuffers(1, &mModelVertexBuffer);
   glDeleteBuffers(1, &mModelIndexBuffer);
 }
@@ -131,6 +107,8 @@ glm::vec4 ModelDebugProcessor::getGroupColor(uint_fast8_t groupId) {
 void ModelDebugProcessor::setModels(const std::vector<ModelData>& models,
                                     const std::vector<uint_fast8_t>& modelGroups)
 {
+  utils::Profiler::Span setModelsSpan(*mProfiler, "model_debug.set_models");
+
   size_t vertexCount = 0, indexCount = 0;
   ptrdiff_t vertexOffset = 0;
   ptrdiff_t indexOffset = 0;
@@ -187,6 +165,8 @@ void ModelDebugProcessor::setModels(const std::vector<ModelData>& models,
 
 
 const ProcessingResultSet& ModelDebugProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "model_debug.process");
+
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, frameTexture);
 
@@ -1,18 +1,27 @@
 #include <glipf/processors/model-occlusion-processor.h>
 
+#include <glipf/gles-utils/gles-context.h>
 #include <glipf/gles-utils/shader-builder.h>
 #include <glipf/gles-utils/glsl-program-builder.h>
 
+#ifdef GLIPF_GLES3
+#include <GLES3/gl3.h>
+#endif
+
 #include <boost/variant/get.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <cstring>
 
 
-#define BASE_TEXTURE_WIDTH 320
-#define BASE_TEXTURE_HEIGHT 240
-
-constexpr GLfloat kColorUnitValue = 1.0 / 256.0;
+// Occlusion is rendered at half the frame resolution at quality 1
+constexpr float kFrameScale = 0.5f;
+// Model numbers are stored as 8-bit normalised values on GLES 2
+constexpr GLfloat kModelNumberUnitValue = 1.0 / 255.0;
+// Depth range of the model transformation (see
+// glsl/model-occlusion/transformation.vert)
+constexpr float kDepthRange = 100000.0f;
 
 
 using std::vector;
@@ -24,29 +33,55 @@ namespace processors {
 
 enum VertexAttributeLocations : GLuint {
   kPosition = 0,
-  kColor = 1
+  kModelNumber = 1
 };
 
 
 ModelOcclusionProcessor::ModelOcclusionProcessor(const sources::FrameProperties& frameProperties,
-                                                 const glm::mat4& mvpMatrix)
+                                                 const glm::mat4& mvpMatrix,
+                                                 float qualityScale)
   : GlesProcessor(frameProperties)
+  , mWorkingDimensions(workingDimensions(kFrameScale, qualityScale))
   , mModelCount(0)
   , mMainGlslProgram(0)
   , mModelIndexCount(0)
   , mModelVertexBuffer(0)
   , mModelIndexBuffer(0)
+  , mHasIntegerModelNumbers(false)
+  , mModelNumberTexture(0)
 {
-  mMainGlslProgram = gles_utils::GlslProgramBuilder()
-    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
-                    .appendSourceFile("glsl/model-occlusion/transformation.vert")
-                    .compile())
-    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
-                    .appendSourceFile("glsl/model-occlusion/model-color.frag")
-                    .compile())
-    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
-    .bindAttribLocation(VertexAttributeLocations::kColor, "modelColor")
-    .link();
+#ifdef GLIPF_GLES3
+  mHasIntegerModelNumbers =
+      gles_utils::GlesContext::currentClientVersion() >= 3;
+#endif
+
+  if (mHasIntegerModelNumbers) {
+    mMainGlslProgram = gles_utils::GlslProgramBuilder()
+      .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                      .appendSourceString("#version 300 es\n")
+                      .appendSourceFile("glsl/model-occlusion/model-number.vert")
+                      .compile())
+      .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                      .appendSourceString("#version 300 es\n")
+                      .appendSourceFile("glsl/include/occlusion-depth.frag")
+                      .appendSourceFile("glsl/model-occlusion/model-number.frag")
+                      .compile())
+      .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+      .bindAttribLocation(VertexAttributeLocations::kModelNumber, "modelNumber")
+      .link();
+  } else {
+    mMainGlslProgram = gles_utils::GlslProgramBuilder()
+      .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                      .appendSourceFile("glsl/model-occlusion/transformation.vert")
+                      .compile())
+      .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                      .appendSourceFile("glsl/include/occlusion-depth.frag")
+                      .appendSourceFile("glsl/model-occlusion/model-color.frag")
+                      .compile())
+      .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+      .bindAttribLocation(VertexAttributeLocations::kModelNumber, "modelColor")
+      .link();
+  }
 
   glUseProgram(mMainGlslProgram);
   glUniform2f(glGetUniformLocation(mMainGlslProgram, "viewportDimensions"),
@@ -56,33 +91,16 @@ ModelOcclusionProcessor::ModelOcclusionProcessor(const sources::FrameProperties&
                      1, GL_FALSE, glm::value_ptr(mvpMatrix));
   assertNoGlError();
 
-  // Prepare a texture to store the model occlusion image
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &mTexture);
-  glBindTexture(GL_TEXTURE_2D, mTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, BASE_TEXTURE_WIDTH,
-               BASE_TEXTURE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
-
-  // Prepare a renderbuffer for depth testing
-  glGenRenderbuffers(1, &mRenderBuffer);
-  glBindRenderbuffer(GL_RENDERBUFFER, mRenderBuffer);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16,
-                        BASE_TEXTURE_WIDTH, BASE_TEXTURE_HEIGHT);
+  // Prepare a depth-tested FBO to store the model occlusion image
+  std::tie(mTexture, mFrameBuffer) = generateTextureBackedFbo(
+      mWorkingDimensions, GL_UNSIGNED_BYTE, true);
 
-  // Prepare an FBO to store the model occlusion image
-  glGenFramebuffers(1, &mFrameBuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                         GL_TEXTURE_2D, mTexture, 0);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, mRenderBuffer);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
+  if (mHasIntegerModelNumbers) {
+    setupModelNumberTarget();
+  } else {
+    mOcclusionData.resize(mWorkingDimensions.first *
+                          mWorkingDimensions.second * 4);
+  }
 
   glGenBuffers(1, &mModelVertexBuffer);
   glGenBuffers(1, &mModelIndexBuffer);
@@ -94,21 +112,130 @@ ModelOcclusionProcessor::ModelOcclusionProcessor(const sources::FrameProperties&
 
 
 ModelOcclusionProcessor::~ModelOcclusionProcessor() {
+#ifdef GLIPF_GLES3
+  if (mHasIntegerModelNumbers) {
+    // The FBO goes back to the render target pool as it was leased
+    const GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, 0, 0);
+    glDrawBuffers(1, &drawBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteTextures(1, &mModelNumberTexture);
+  }
+#endif
+
   glDeleteProgram(mMainGlslProgram);
-  glDeleteTextures(1, &mTexture);
-  glDeleteRenderbuffers(1, &mRenderBuffer);
-  glDeleteFramebuffers(1, &mFrameBuffer);
   glDeleteBuffers(1, &mModelVertexBuffer);
   glDeleteBuffers(1, &mModelIndexBuffer);
 }
 
 
+void ModelOcclusionProcessor::setupModelNumberTarget() {
+#ifdef GLIPF_GLES3
+  // Model numbers and depths are rendered into a second, integer target
+  // of the occlusion FBO, so that they're read back exactly and for any
+  // number of models
+  glGenTextures(1, &mModelNumberTexture);
+  glBindTexture(GL_TEXTURE_2D, mModelNumberTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16UI, mWorkingDimensions.first,
+                 mWorkingDimensions.second);
+
+  const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         mModelNumberTexture, 0);
+  glDrawBuffers(2, drawBuffers);
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  assertNoGlError();
+
+  mModelNumberData.resize(mWorkingDimensions.first *
+                          mWorkingDimensions.second * 4);
+#endif
+}
+
+
+void ModelOcclusionProcessor::readOccluder(size_t x, size_t y,
+                                           size_t& modelNumber,
+                                           float& depth) const
+{
+  size_t pixelOffset = (y * mWorkingDimensions.first + x) * 4;
+
+  if (mHasIntegerModelNumbers) {
+    const GLuint* pixel = mModelNumberData.data() + pixelOffset;
+    modelNumber = pixel[0];
+    depth = pixel[1] / 65535.0f;
+  } else {
+    const GLubyte* pixel = mOcclusionData.data() + pixelOffset;
+    modelNumber = pixel[0];
+    depth = (pixel[1] + pixel[2] / 255.0f) / 255.0f;
+  }
+}
+
+
+GLuint ModelOcclusionProcessor::occlusionTexture() const {
+  return mTexture;
+}
+
+
+bool ModelOcclusionProcessor::isModelHidden(const utils::ProjectedModel& projectedModel,
+                                            int ownModelIndex) const
+{
+  glm::vec2 frameDimensions(mFrameProperties.dimensions().first,
+                            mFrameProperties.dimensions().second);
+  glm::vec2 textureDimensions(mWorkingDimensions.first,
+                              mWorkingDimensions.second);
+  glm::vec2 bboxMin = projectedModel.bboxMin / frameDimensions *
+                      textureDimensions;
+  glm::vec2 bboxMax = projectedModel.bboxMax / frameDimensions *
+                      textureDimensions;
+  float nearestDepth = std::min(
+      1.0f, 0.5f * projectedModel.nearestDepth / kDepthRange + 0.5f);
+
+  bboxMin = glm::clamp(bboxMin, glm::vec2(0.0f), textureDimensions);
+  bboxMax = glm::clamp(bboxMax, glm::vec2(0.0f), textureDimensions);
+
+  int xMin = glm::floor(bboxMin.x);
+  int xMax = glm::ceil(bboxMax.x);
+  int yMin = glm::floor(bboxMin.y);
+  int yMax = glm::ceil(bboxMax.y);
+
+  // Models outside the frame aren't hidden, they're just not visible
+  if (xMin >= xMax || yMin >= yMax)
+    return false;
+
+  for (int y = yMin; y < yMax; ++y) {
+    for (int x = xMin; x < xMax; ++x) {
+      size_t occluderNumber;
+      float occluderDepth;
+      readOccluder(x, y, occluderNumber, occluderDepth);
+
+      if (occluderNumber == 0 || int(occluderNumber) - 1 == ownModelIndex ||
+          occluderDepth >= nearestDepth)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
 void ModelOcclusionProcessor::setModels(const vector<ModelData>& models,
                                         const glm::mat4& mvpMatrix)
 {
+  utils::Profiler::Span setModelsSpan(*mProfiler, "model_occlusion.set_models");
+
   mModelCount = models.size();
-  mModelAreas = computeModelAreas(models, mvpMatrix, BASE_TEXTURE_WIDTH,
-                                  BASE_TEXTURE_HEIGHT);
+  mModelAreas = computeModelAreas(mModelProjection.project(models, mvpMatrix),
+                                  mWorkingDimensions.first,
+                                  mWorkingDimensions.second);
   setupModelGeometry(models);
 
   vector<float>& occlusionValues =
@@ -132,7 +259,9 @@ void ModelOcclusionProcessor::setupModelGeometry(const std::vector<ModelData>& m
   GLushort indexData[indexCount];
 
   for (auto& model : models) {
-    GLfloat modelColor = (modelNumber + 1) * kColorUnitValue;
+    // Model numbers start at 1, as 0 is left for the background
+    GLfloat modelColor = mHasIntegerModelNumbers
+        ? modelNumber + 1 : (modelNumber + 1) * kModelNumberUnitValue;
 
     for (size_t i = 0; i < model.first.size(); i += 3) {
       memcpy(vertexData + vertexOffset + i * 2, model.first.data() + i,
@@ -168,21 +297,32 @@ void ModelOcclusionProcessor::setupModelGeometry(const std::vector<ModelData>& m
 
 
 const ProcessingResultSet& ModelOcclusionProcessor::process(GLuint /*frameTexture*/) {
+  utils::Profiler::Span processSpan(*mProfiler, "model_occlusion.process");
+
   glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
-  glEnableVertexAttribArray(VertexAttributeLocations::kColor);
+  glEnableVertexAttribArray(VertexAttributeLocations::kModelNumber);
 
-  glViewport(0, 0, BASE_TEXTURE_WIDTH, BASE_TEXTURE_HEIGHT);
+  glViewport(0, 0, mWorkingDimensions.first, mWorkingDimensions.second);
   glUseProgram(mMainGlslProgram);
   glBindBuffer(GL_ARRAY_BUFFER, mModelVertexBuffer);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mModelIndexBuffer);
   glVertexAttribPointer(VertexAttributeLocations::kPosition, 3, GL_FLOAT,
                         GL_FALSE, 6 * sizeof(GLfloat), 0);
-  glVertexAttribPointer(VertexAttributeLocations::kColor, 3, GL_FLOAT,
+  glVertexAttribPointer(VertexAttributeLocations::kModelNumber, 3, GL_FLOAT,
                         GL_FALSE, 6 * sizeof(GLfloat),
                         (GLvoid*)(3 * sizeof(GLfloat)));
 
   glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+#ifdef GLIPF_GLES3
+  // glClear() leaves integer targets undefined
+  if (mHasIntegerModelNumbers) {
+    const GLuint clearValue[] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 1, clearValue);
+  }
+#endif
+
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LEQUAL);
 
@@ -190,17 +330,38 @@ const ProcessingResultSet& ModelOcclusionProcessor::process(GLuint /*frameTextur
   assertNoGlError();
   glDisable(GL_DEPTH_TEST);
   glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
-  glDisableVertexAttribArray(VertexAttributeLocations::kColor);
+  glDisableVertexAttribArray(VertexAttributeLocations::kModelNumber);
+
+  // The readback is kept for isModelHidden()
+  utils::Profiler::Span readbackSpan(*mProfiler, "model_occlusion.readback");
+
+  if (mHasIntegerModelNumbers) {
+#ifdef GLIPF_GLES3
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, mWorkingDimensions.first, mWorkingDimensions.second,
+                 GL_RGBA_INTEGER, GL_UNSIGNED_INT, mModelNumberData.data());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+#endif
+  } else {
+    glReadPixels(0, 0, mWorkingDimensions.first, mWorkingDimensions.second,
+                 GL_RGBA, GL_UNSIGNED_BYTE, mOcclusionData.data());
+  }
 
-  GLubyte pixelData[BASE_TEXTURE_WIDTH * BASE_TEXTURE_HEIGHT * 4];
-  glReadPixels(0, 0, BASE_TEXTURE_WIDTH, BASE_TEXTURE_HEIGHT, GL_RGBA,
-               GL_UNSIGNED_BYTE, pixelData);
+  readbackSpan.finish();
 
-  vector<uint_fast16_t> modelPixelCounts(mModelCount);
+  utils::Profiler::Span extractionSpan(*mProfiler,
+                                       "model_occlusion.extraction");
+  vector<uint_fast32_t> modelPixelCounts(mModelCount);
 
-  for (size_t i = 0; i < sizeof(pixelData); i += 4) {
-    if (pixelData[i] > 0)
-      modelPixelCounts[pixelData[i] - 1]++;
+  for (size_t y = 0; y < mWorkingDimensions.second; ++y) {
+    for (size_t x = 0; x < mWorkingDimensions.first; ++x) {
+      size_t modelNumber;
+      float depth;
+      readOccluder(x, y, modelNumber, depth);
+
+      if (modelNumber > 0)
+        modelPixelCounts[modelNumber - 1]++;
+    }
   }
 
   vector<float>& occlusionValues =
@@ -0,0 +1,209 @@
+#include <glipf/processors/mog-bg-sub-processor.h>
+
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+#include <string>
+
+
+using std::string;
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+MogBgSubProcessor::MogBgSubProcessor(const sources::FrameProperties& frameProperties,
+                                     size_t gaussianCount, size_t historyLength,
+                                     float backgroundRatio,
+                                     bool hasHsvOutput)
+  : GlesProcessor(frameProperties)
+  , mGaussianCount(gaussianCount)
+  , mLearningRate(1.0f / historyLength)
+  , mBackgroundRatio(backgroundRatio)
+  , mSubtractionGlslProgram(0)
+  , mUpdateMaskTexture(0)
+  , mCurrentModelIndex(0)
+  , mIsModelInitialized(false)
+  , mResultTexture(0)
+  , mResultFbo(0)
+{
+  assert(mGaussianCount > 0 && mGaussianCount <= kMaxGaussianCount);
+  assert(historyLength > 0);
+
+  mSubtractionGlslProgram = buildGlslProgram("glsl/mog-bg-sub/subtraction.frag",
+                                             hasHsvOutput ? "#define HSV_OUTPUT\n"
+                                                          : "");
+  mInitializationGlslPrograms = buildUpdateGlslPrograms("#define INITIALIZE_MODEL\n");
+  mUpdateGlslPrograms = buildUpdateGlslPrograms("");
+
+  // Every model consists of a texture per Gaussian and a deviation
+  // texture. Models are updated by rendering alternately into one of
+  // them while reading from the other one.
+  for (auto& modelTextureFboPairs : mModelTextureFboPairs) {
+    for (size_t i = 0; i <= mGaussianCount; ++i) {
+      modelTextureFboPairs.push_back(
+          generateTextureBackedFbo(frameProperties.dimensions()));
+    }
+  }
+
+  std::tie(mResultTexture, mResultFbo) =
+      generateTextureBackedFbo(frameProperties.dimensions());
+  mResultSet["foreground_texture"] = mResultTexture;
+}
+
+
+MogBgSubProcessor::~MogBgSubProcessor() {
+  glDeleteProgram(mSubtractionGlslProgram);
+
+  for (auto glslPrograms : {&mInitializationGlslPrograms, &mUpdateGlslPrograms,
+                            &mMaskedUpdateGlslPrograms})
+  {
+    for (auto glslProgram : *glslPrograms)
+      glDeleteProgram(glslProgram);
+  }
+}
+
+
+GLuint MogBgSubProcessor::buildGlslProgram(const string& fragmentShaderPath,
+                                           const string& defines)
+{
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString("#define GAUSSIAN_COUNT " +
+                                        std::to_string(mGaussianCount) + "\n")
+                    .appendSourceString(defines)
+                    .appendSourceFile("glsl/include/color-space.frag")
+                    .appendSourceFile("glsl/include/running-average.frag")
+                    .appendSourceFile("glsl/include/mixture-of-gaussians.frag")
+                    .appendSourceFile(fragmentShaderPath)
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  // Texture units: the frame, one per Gaussian, the deviations and the
+  // update mask
+  GLint gaussianTextureUnits[kMaxGaussianCount];
+
+  for (size_t i = 0; i < mGaussianCount; ++i)
+    gaussianTextureUnits[i] = 1 + i;
+
+  glUseProgram(glslProgram);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+  glUniform1iv(glGetUniformLocation(glslProgram, "gaussianTextures"),
+               mGaussianCount, gaussianTextureUnits);
+  glUniform1i(glGetUniformLocation(glslProgram, "deviationTexture"),
+              1 + mGaussianCount);
+  glUniform1i(glGetUniformLocation(glslProgram, "updateMaskTexture"),
+              2 + mGaussianCount);
+  glUniform1f(glGetUniformLocation(glslProgram, "learningRate"),
+              mLearningRate);
+  glUniform1f(glGetUniformLocation(glslProgram, "backgroundRatio"),
+              mBackgroundRatio);
+  assertNoGlError();
+
+  return glslProgram;
+}
+
+
+vector<GLuint> MogBgSubProcessor::buildUpdateGlslPrograms(const string& defines) {
+  vector<GLuint> glslPrograms;
+
+  // GLES 2 has no multiple render targets, so every model texture is
+  // written by a separate program
+  for (size_t i = 0; i <= mGaussianCount; ++i) {
+    glslPrograms.push_back(buildGlslProgram(
+        "glsl/mog-bg-sub/update.frag",
+        defines + "#define OUTPUT_INDEX " + std::to_string(i) + "\n"));
+  }
+
+  return glslPrograms;
+}
+
+
+bool MogBgSubProcessor::setUpdateMask(GLuint updateMaskTexture) {
+  if (mMaskedUpdateGlslPrograms.empty())
+    mMaskedUpdateGlslPrograms = buildUpdateGlslPrograms("#define USE_UPDATE_MASK\n");
+
+  mUpdateMaskTexture = updateMaskTexture;
+  return true;
+}
+
+
+void MogBgSubProcessor::bindModelTextures(size_t modelIndex) {
+  const auto& modelTextureFboPairs = mModelTextureFboPairs[modelIndex];
+
+  for (size_t i = 0; i <= mGaussianCount; ++i) {
+    glActiveTexture(GL_TEXTURE1 + i);
+    glBindTexture(GL_TEXTURE_2D, modelTextureFboPairs[i].first);
+  }
+}
+
+
+void MogBgSubProcessor::renderModel(size_t modelIndex,
+                                    const vector<GLuint>& glslPrograms)
+{
+  const auto& modelTextureFboPairs = mModelTextureFboPairs[modelIndex];
+
+  for (size_t i = 0; i <= mGaussianCount; ++i) {
+    glBindFramebuffer(GL_FRAMEBUFFER, modelTextureFboPairs[i].second);
+    glUseProgram(glslPrograms[i]);
+    drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  }
+}
+
+
+const ProcessingResultSet& MogBgSubProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "mog_bg_sub.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+  glViewport(0, 0, mFrameProperties.dimensions().first,
+             mFrameProperties.dimensions().second);
+
+  // Step 1: start with a model fitted to the first frame
+  if (!mIsModelInitialized) {
+    renderModel(mCurrentModelIndex, mInitializationGlslPrograms);
+    mIsModelInitialized = true;
+  }
+
+  // Step 2: segment the frame against the model of the previous frames
+  bindModelTextures(mCurrentModelIndex);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mResultFbo);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glUseProgram(mSubtractionGlslProgram);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
+
+  // Step 3: update the model with the frame
+  size_t nextModelIndex = 1 - mCurrentModelIndex;
+
+  if (mUpdateMaskTexture != 0) {
+    glActiveTexture(GL_TEXTURE2 + mGaussianCount);
+    glBindTexture(GL_TEXTURE_2D, mUpdateMaskTexture);
+    renderModel(nextModelIndex, mMaskedUpdateGlslPrograms);
+  } else {
+    renderModel(nextModelIndex, mUpdateGlslPrograms);
+  }
+
+  mCurrentModelIndex = nextModelIndex;
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
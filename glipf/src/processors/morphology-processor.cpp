@@ -0,0 +1,149 @@
+#include <glipf/processors/morphology-processor.h>
+
+#include <glipf/gles-utils/shader-builder.h>
+#include <glipf/gles-utils/glsl-program-builder.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <string>
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+MorphologyProcessor::MorphologyProcessor(const sources::FrameProperties& frameProperties,
+                                         MorphologicalOperation operation,
+                                         size_t kernelRadius,
+                                         bool isBitmask)
+  : GlesProcessor(frameProperties)
+  , mKernelRadius(kernelRadius)
+  , mIsBitmask(isBitmask)
+  , mTextureFboPairs{{0, 0}, {0, 0}}
+{
+  assert(mKernelRadius > 0);
+
+  std::vector<bool> erosionSteps;
+
+  switch (operation) {
+    case MorphologicalOperation::kErode:
+      erosionSteps = {true};
+      break;
+    case MorphologicalOperation::kDilate:
+      erosionSteps = {false};
+      break;
+    case MorphologicalOperation::kOpen:
+      erosionSteps = {true, false};
+      break;
+    case MorphologicalOperation::kClose:
+      erosionSteps = {false, true};
+      break;
+  }
+
+  // Every step is split into a horizontal and a vertical pass
+  glm::vec2 horizontalTexelStep(1.0f / frameProperties.dimensions().first, 0.0f);
+  glm::vec2 verticalTexelStep(0.0f, 1.0f / frameProperties.dimensions().second);
+
+  for (size_t i = 0; i < erosionSteps.size(); ++i) {
+    bool isLastStep = (i == erosionSteps.size() - 1);
+
+    mPassGlslPrograms.push_back(
+        buildPassGlslProgram(erosionSteps[i], false, horizontalTexelStep));
+    mPassGlslPrograms.push_back(
+        buildPassGlslProgram(erosionSteps[i], isLastStep, verticalTexelStep));
+  }
+
+  for (auto& textureFboPair : mTextureFboPairs)
+    textureFboPair = generateTextureBackedFbo(frameProperties.dimensions());
+
+  // The pass count is even, so the last pass always renders into the
+  // second texture
+  mResultSet["morphology_texture"] = mTextureFboPairs[1].first;
+}
+
+
+MorphologyProcessor::~MorphologyProcessor() {
+  for (auto glslProgram : mPassGlslPrograms)
+    glDeleteProgram(glslProgram);
+}
+
+
+GLuint MorphologyProcessor::buildPassGlslProgram(bool isErosion,
+                                                 bool isLastPass,
+                                                 const glm::vec2& texelStep)
+{
+  std::string defines = "#define KERNEL_RADIUS " +
+                        std::to_string(mKernelRadius) + "\n";
+
+  if (isErosion)
+    defines += "#define ERODE\n";
+
+  if (isLastPass)
+    defines += "#define DISCARD_BACKGROUND\n";
+
+  // Alpha holds one bit per threshold, which has to be eroded and
+  // dilated separately
+  if (mIsBitmask)
+    defines += "#define BITMASK\n";
+
+  GLuint glslProgram = gles_utils::GlslProgramBuilder()
+    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
+                    .appendSourceFile("glsl/standard.vert")
+                    .compile())
+    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
+                    .appendSourceString(defines)
+                    .appendSourceFile("glsl/include/bitmask.frag")
+                    .appendSourceFile("glsl/morphology.frag")
+                    .compile())
+    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
+    .link();
+
+  glUseProgram(glslProgram);
+  glUniform1i(glGetUniformLocation(glslProgram, "tex"), 0);
+  glUniform2fv(glGetUniformLocation(glslProgram, "texelStep"), 1,
+               glm::value_ptr(texelStep));
+  assertNoGlError();
+
+  return glslProgram;
+}
+
+
+const ProcessingResultSet& MorphologyProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "morphology.process");
+
+  GLuint inputTexture = frameTexture;
+
+  glActiveTexture(GL_TEXTURE0);
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+  glViewport(0, 0, mFrameProperties.dimensions().first,
+             mFrameProperties.dimensions().second);
+
+  for (size_t i = 0; i < mPassGlslPrograms.size(); ++i) {
+    const auto& textureFboPair = mTextureFboPairs[i % 2];
+
+    glBindTexture(GL_TEXTURE_2D, inputTexture);
+    glBindFramebuffer(GL_FRAMEBUFFER, textureFboPair.second);
+
+    // Only the last pass discards fragments
+    if (i == mPassGlslPrograms.size() - 1)
+      glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(mPassGlslPrograms[i]);
+    drawFullscreenQuad(VertexAttributeLocations::kPosition);
+
+    inputTexture = textureFboPair.first;
+  }
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -0,0 +1,105 @@
+#include <glipf/processors/multi-threshold-processor.h>
+
+#include <stdexcept>
+#include <string>
+
+
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+MultiThresholdProcessor::MultiThresholdProcessor(const sources::FrameProperties& frameProperties,
+                                                 const vector<HsvRange>& hsvRanges)
+  : GlesProcessor(frameProperties)
+  , mThresholdCount(hsvRanges.size())
+  , mGlslProgram(0)
+{
+  // The uniform arrays and the alpha mask have room for a fixed number
+  // of ranges only
+  if (mThresholdCount == 0 || mThresholdCount > kMaxThresholdCount) {
+    throw std::invalid_argument("MultiThresholdProcessor supports 1 to " +
+                                std::to_string(kMaxThresholdCount) +
+                                " HSV ranges");
+  }
+
+  for (const auto& hsvRange : hsvRanges) {
+    for (size_t i = 0; i < 3; ++i) {
+      mLowerThresholdData.push_back(hsvRange.first[i]);
+      mUpperThresholdData.push_back(hsvRange.second[i]);
+    }
+  }
+
+  gles_utils::FragmentStage stage;
+  fragmentStage(stage);
+  mGlslProgram = buildFragmentStageGlslProgram({stage},
+                                               VertexAttributeLocations::kPosition);
+
+  mResultTextureFboPair =
+      generateTextureBackedFbo(frameProperties.dimensions());
+  mResultSet["thresholded_texture"] = mResultTextureFboPair.first;
+}
+
+
+MultiThresholdProcessor::~MultiThresholdProcessor() {
+  glDeleteProgram(mGlslProgram);
+}
+
+
+size_t MultiThresholdProcessor::thresholdCount() const {
+  return mThresholdCount;
+}
+
+
+bool MultiThresholdProcessor::fragmentStage(gles_utils::FragmentStage& stage) const {
+  size_t thresholdCount = mThresholdCount;
+  vector<GLfloat> lowerThresholdData = mLowerThresholdData;
+  vector<GLfloat> upperThresholdData = mUpperThresholdData;
+
+  stage.functionName = "multiThreshold";
+  stage.sourceFile = "glsl/stages/multi-threshold.frag";
+  stage.includeFiles = {"glsl/include/color-space.frag"};
+  stage.defines = "#define THRESHOLD_COUNT " +
+                  std::to_string(mThresholdCount) + "\n";
+  stage.outputKey = "thresholded_texture";
+  stage.setupUniforms = [=](GLuint glslProgram) {
+    glUniform3fv(glGetUniformLocation(glslProgram, "lowerHsvThresholds"),
+                 thresholdCount, lowerThresholdData.data());
+    glUniform3fv(glGetUniformLocation(glslProgram, "upperHsvThresholds"),
+                 thresholdCount, upperThresholdData.data());
+  };
+
+  return true;
+}
+
+
+const ProcessingResultSet& MultiThresholdProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "multi_threshold.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mResultTextureFboPair.second);
+  glViewport(0, 0, mFrameProperties.dimensions().first,
+             mFrameProperties.dimensions().second);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glUseProgram(mGlslProgram);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
+
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -3,10 +3,10 @@
 #include <glipf/gles-utils/shader-builder.h>
 #include <glipf/gles-utils/glsl-program-builder.h>
 
-#include <glm/gtx/color_space_YCoCg.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <cstring>
+#include <algorithm>
+#include <cmath>
 
 
 using std::vector;
@@ -23,6 +23,7 @@ enum VertexAttributeLocations : GLuint {
 
 NormDistBgSubProcessor::NormDistBgSubProcessor(const sources::FrameProperties& frameProperties)
   : GlesProcessor(frameProperties)
+  , mBackgroundSampleCount(0)
   , mGlslProgram(0)
   , mReferenceFrameTexture(0)
   , mMeanTexture(0)
@@ -46,98 +47,94 @@ NormDistBgSubProcessor::NormDistBgSubProcessor(const sources::FrameProperties& f
   glUniform1i(glGetUniformLocation(mGlslProgram, "meanTexture"), 1);
   glUniform1i(glGetUniformLocation(mGlslProgram, "stdDevTexture"), 2);
 
+  size_t pixelCount = frameProperties.dimensions().first *
+      frameProperties.dimensions().second;
+
+  for (size_t i = 0; i < 3; ++i) {
+    mSampleMeans[i].assign(pixelCount, 0.0f);
+    mSampleSquaredDeviations[i].assign(pixelCount, 0.0f);
+  }
+
   setupResultFbo();
 }
 
 
 NormDistBgSubProcessor::~NormDistBgSubProcessor() {
   glDeleteProgram(mGlslProgram);
-  glDeleteFramebuffers(1, &mResultFbo);
-  glDeleteTextures(1, &mResultTexture);
   glDeleteTextures(1, &mReferenceFrameTexture);
   glDeleteTextures(1, &mMeanTexture);
   glDeleteTextures(1, &mStdDevTexture);
-
-  for (auto sampleData : mBackgroundSamples)
-    delete[] sampleData;
 }
 
 
 void NormDistBgSubProcessor::setupResultFbo()
 {
-  // Prepare a texture to store the background-subtracted image
-  glActiveTexture(GL_TEXTURE3);
-  glGenTextures(1, &mResultTexture);
-  glBindTexture(GL_TEXTURE_2D, mResultTexture);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mFrameProperties.dimensions().first,
-               mFrameProperties.dimensions().second, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, 0);
-  assertNoGlError();
-
-  // Prepare an FBO to store the background-subtracted image image
-  glGenFramebuffers(1, &mResultFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, mResultFbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         mResultTexture, 0);
-  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
-  assertNoGlError();
+  // Prepare a texture-backed FBO to store the background-subtracted
+  // image
+  std::tie(mResultTexture, mResultFbo) =
+      generateTextureBackedFbo(mFrameProperties.dimensions());
 }
 
 
 void NormDistBgSubProcessor::addBackgroundSample(const void* frameData) {
-  size_t dataLen = mFrameProperties.dimensions().first *
-      mFrameProperties.dimensions().second * 3;
-  uint8_t* sampleData = new uint8_t[dataLen];
-  memcpy(sampleData, frameData, dataLen);
-
-  mBackgroundSamples.push_back(sampleData);
+  size_t pixelCount = mSampleMeans[0].size();
+  const uint8_t* sampleData = static_cast<const uint8_t*>(frameData);
+  float sampleWeight = 1.0f / ++mBackgroundSampleCount;
+
+  float* yMeans = mSampleMeans[0].data();
+  float* coMeans = mSampleMeans[1].data();
+  float* cgMeans = mSampleMeans[2].data();
+  float* ySquaredDeviations = mSampleSquaredDeviations[0].data();
+  float* coSquaredDeviations = mSampleSquaredDeviations[1].data();
+  float* cgSquaredDeviations = mSampleSquaredDeviations[2].data();
+
+  // Kept free of branches and calls so that the compiler can vectorise it
+  for (size_t i = 0; i < pixelCount; ++i) {
+    float b = sampleData[3 * i] * (1.0f / 255.0f);
+    float g = sampleData[3 * i + 1] * (1.0f / 255.0f);
+    float r = sampleData[3 * i + 2] * (1.0f / 255.0f);
+
+    // Same conversion as glm::rgb2YCoCg()
+    float y = 0.25f * r + 0.5f * g + 0.25f * b;
+    float co = 0.5f * r - 0.5f * b;
+    float cg = -0.25f * r + 0.5f * g - 0.25f * b;
+
+    float yDelta = y - yMeans[i];
+    float coDelta = co - coMeans[i];
+    float cgDelta = cg - cgMeans[i];
+
+    yMeans[i] += yDelta * sampleWeight;
+    coMeans[i] += coDelta * sampleWeight;
+    cgMeans[i] += cgDelta * sampleWeight;
+
+    ySquaredDeviations[i] += yDelta * (y - yMeans[i]);
+    coSquaredDeviations[i] += coDelta * (co - coMeans[i]);
+    cgSquaredDeviations[i] += cgDelta * (cg - cgMeans[i]);
+  }
 }
 
 
 void NormDistBgSubProcessor::setupBackgroundModel() {
-  size_t pixelCount = mFrameProperties.dimensions().first *
-      mFrameProperties.dimensions().second;
-  uint8_t meanTextureData[pixelCount * 3];
-  uint8_t stdDevTextureData[pixelCount * 3];
-  ptrdiff_t textureDataOffset = 0;
-  float sampleCount = mBackgroundSamples.size();
-
-  for (size_t i = 0; i < pixelCount * 3; i += 3) {
-    vector<glm::vec3> samples;
-    glm::vec3 yCoCgPixelColorSum(0, 0, 0);
-
-    for (auto sampleData : mBackgroundSamples) {
-      glm::vec3 rgbPixelColor(*(sampleData + i + 2) / 255.0f,
-                              *(sampleData + i + 1) / 255.0f,
-                              *(sampleData + i) / 255.0f);
-      samples.push_back(glm::rgb2YCoCg(rgbPixelColor));
-      yCoCgPixelColorSum += samples.back();
-    }
+  size_t pixelCount = mSampleMeans[0].size();
+  vector<uint8_t> meanTextureData(pixelCount * 3);
+  vector<uint8_t> stdDevTextureData(pixelCount * 3);
+  float varianceDivisor = std::max<float>(mBackgroundSampleCount - 1, 1.0f);
 
-    glm::vec3 yCoCgPixelColorMean = yCoCgPixelColorSum / sampleCount;
-    glm::mat3 covarianceMatrix(0);
+  // Co and Cg are offset so that they fit into an unsigned texture
+  const float meanOffsets[] = {0.0f, 0.5f, 0.5f};
 
-    for (const auto& sample : samples) {
-      glm::vec3 colorDelta = sample - yCoCgPixelColorMean;
-      covarianceMatrix += glm::outerProduct(colorDelta, colorDelta);
-    }
-
-    covarianceMatrix /= sampleCount - 1;
+  for (size_t i = 0; i < 3; ++i) {
+    const auto& means = mSampleMeans[i];
+    const auto& squaredDeviations = mSampleSquaredDeviations[i];
 
-    yCoCgPixelColorMean[1] = 0.5f + yCoCgPixelColorMean[1];
-    yCoCgPixelColorMean[2] = 0.5f + yCoCgPixelColorMean[2];
+    for (size_t j = 0; j < pixelCount; ++j) {
+      float stdDev = std::sqrt(squaredDeviations[j] / varianceDivisor);
 
-    for (size_t i = 0; i < 3; ++i) {
-      meanTextureData[textureDataOffset + i] = static_cast<uint8_t>(yCoCgPixelColorMean[i] * 255.0f);
-      stdDevTextureData[textureDataOffset + i] = static_cast<uint8_t>(
-          1.0f / std::max(std::sqrt(covarianceMatrix[i][i]), 1.0f / 255.0f));
+      meanTextureData[3 * j + i] = static_cast<uint8_t>(
+          (means[j] + meanOffsets[i]) * 255.0f);
+      stdDevTextureData[3 * j + i] = static_cast<uint8_t>(
+          1.0f / std::max(stdDev, 1.0f / 255.0f));
     }
-
-    textureDataOffset += 3;
   }
 
   // Prepare a texture image storing mean color channel values
@@ -150,7 +147,7 @@ void NormDistBgSubProcessor::setupBackgroundModel() {
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, mFrameProperties.dimensions().first,
                mFrameProperties.dimensions().second, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, meanTextureData);
+               GL_UNSIGNED_BYTE, meanTextureData.data());
   assertNoGlError();
 
   // Prepare a texture image storing standard deviations of color
@@ -164,18 +161,22 @@ void NormDistBgSubProcessor::setupBackgroundModel() {
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, mFrameProperties.dimensions().first,
                mFrameProperties.dimensions().second, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, stdDevTextureData);
+               GL_UNSIGNED_BYTE, stdDevTextureData.data());
   assertNoGlError();
 
-  for (auto sampleData : mBackgroundSamples)
-    delete[] sampleData;
+  // The accumulators aren't needed once the model has been uploaded
+  for (size_t i = 0; i < 3; ++i) {
+    vector<float>().swap(mSampleMeans[i]);
+    vector<float>().swap(mSampleSquaredDeviations[i]);
+  }
 
-  mBackgroundSamples.clear();
   mResultSet["foreground_texture"] = mResultTexture;
 }
 
 
 const ProcessingResultSet& NormDistBgSubProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "norm_dist_bg_sub.process");
+
   if (mMeanTexture == 0)
     setupBackgroundModel();
 
@@ -194,7 +195,7 @@ const ProcessingResultSet& NormDistBgSubProcessor::process(GLuint frameTexture)
   glUseProgram(mGlslProgram);
 
   glClear(GL_COLOR_BUFFER_BIT);
-  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
   assertNoGlError();
 
   glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
@@ -0,0 +1,56 @@
+#include <glipf/processors/processing-result.h>
+
+#include <boost/variant/get.hpp>
+
+#include <cassert>
+
+
+namespace glipf {
+namespace processors {
+
+
+LazyNumbers::Batch::Batch(std::function<void()> fetch)
+  : mFetch(std::move(fetch))
+  , mIsFetched(false)
+{}
+
+
+void LazyNumbers::Batch::fetch() {
+  if (mIsFetched)
+    return;
+
+  mFetch();
+  mIsFetched = true;
+}
+
+
+LazyNumbers::LazyNumbers(std::shared_ptr<Batch> batch,
+                         std::function<void(std::vector<float>&)> compute)
+  : mState(new State{std::move(batch), std::move(compute), false, {}})
+{}
+
+
+const std::vector<float>& LazyNumbers::get() const {
+  if (!mState->isComputed) {
+    mState->batch->fetch();
+    mState->compute(mState->numbers);
+    mState->isComputed = true;
+  }
+
+  return mState->numbers;
+}
+
+
+const std::vector<float>& getNumbers(const ProcessingResult& result) {
+  assert(result.which() != ProcessingResultType::kTexture &&
+         "getNumbers() called on a texture result");
+
+  if (result.which() == ProcessingResultType::kLazyNumbers)
+    return boost::get<LazyNumbers>(result).get();
+
+  return boost::get<std::vector<float>>(result);
+}
+
+
+} // end namespace processors
+} // end namespace glipf
@@ -2,9 +2,6 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <glipf/gles-utils/shader-builder.h>
-#include <glipf/gles-utils/glsl-program-builder.h>
-
 
 namespace glipf {
 namespace processors {
@@ -19,26 +16,14 @@ ThresholdProcessor::ThresholdProcessor(const sources::FrameProperties& frameProp
                                        glm::vec3 lowerHsvThreshold,
                                        glm::vec3 upperHsvThreshold)
   : GlesProcessor(frameProperties)
+  , mLowerHsvThreshold(lowerHsvThreshold)
+  , mUpperHsvThreshold(upperHsvThreshold)
   , mGlslProgram(0)
 {
-  mGlslProgram = gles_utils::GlslProgramBuilder()
-    .attachShader(gles_utils::ShaderBuilder(GL_VERTEX_SHADER)
-                    .appendSourceFile("glsl/standard.vert")
-                    .compile())
-    .attachShader(gles_utils::ShaderBuilder(GL_FRAGMENT_SHADER)
-                    .appendSourceFile("glsl/include/color-space.frag")
-                    .appendSourceFile("glsl/threshold.frag")
-                    .compile())
-    .bindAttribLocation(VertexAttributeLocations::kPosition, "vertex")
-    .link();
-
-  glUseProgram(mGlslProgram);
-  glUniform1i(glGetUniformLocation(mGlslProgram, "tex"), 0);
-  glUniform3fv(glGetUniformLocation(mGlslProgram, "lowerHsvThreshold"),
-               1, glm::value_ptr(lowerHsvThreshold));
-  glUniform3fv(glGetUniformLocation(mGlslProgram, "upperHsvThreshold"),
-               1, glm::value_ptr(upperHsvThreshold));
-  assertNoGlError();
+  gles_utils::FragmentStage stage;
+  fragmentStage(stage);
+  mGlslProgram = buildFragmentStageGlslProgram({stage},
+                                               VertexAttributeLocations::kPosition);
 
   std::tie(mResultTexture, mResultFbo) =
       generateTextureBackedFbo(frameProperties.dimensions());
@@ -48,12 +33,31 @@ ThresholdProcessor::ThresholdProcessor(const sources::FrameProperties& frameProp
 
 ThresholdProcessor::~ThresholdProcessor() {
   glDeleteProgram(mGlslProgram);
-  glDeleteFramebuffers(1, &mResultFbo);
-  glDeleteTextures(1, &mResultTexture);
+}
+
+
+bool ThresholdProcessor::fragmentStage(gles_utils::FragmentStage& stage) const {
+  glm::vec3 lowerHsvThreshold = mLowerHsvThreshold;
+  glm::vec3 upperHsvThreshold = mUpperHsvThreshold;
+
+  stage.functionName = "threshold";
+  stage.sourceFile = "glsl/stages/threshold.frag";
+  stage.includeFiles = {"glsl/include/color-space.frag"};
+  stage.outputKey = "thresholded_texture";
+  stage.setupUniforms = [=](GLuint glslProgram) {
+    glUniform3fv(glGetUniformLocation(glslProgram, "lowerHsvThreshold"),
+                 1, glm::value_ptr(lowerHsvThreshold));
+    glUniform3fv(glGetUniformLocation(glslProgram, "upperHsvThreshold"),
+                 1, glm::value_ptr(upperHsvThreshold));
+  };
+
+  return true;
 }
 
 
 const ProcessingResultSet& ThresholdProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "threshold.process");
+
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, frameTexture);
 
@@ -64,7 +68,7 @@ const ProcessingResultSet& ThresholdProcessor::process(GLuint frameTexture) {
              mFrameProperties.dimensions().second);
   glClear(GL_COLOR_BUFFER_BIT);
   glUseProgram(mGlslProgram);
-  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  drawRegionsOfInterest(VertexAttributeLocations::kPosition);
 
   glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
 
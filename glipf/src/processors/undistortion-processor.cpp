@@ -0,0 +1,129 @@
+#include <glipf/processors/undistortion-processor.h>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+
+using std::vector;
+
+
+namespace glipf {
+namespace processors {
+
+
+enum VertexAttributeLocations : GLuint {
+  kPosition = 0
+};
+
+
+UndistortionProcessor::UndistortionProcessor(const sources::FrameProperties& frameProperties,
+                                             const glm::vec2& focalLength,
+                                             const glm::vec2& principalPoint,
+                                             const vector<float>& distortionCoefficients)
+  : GlesProcessor(frameProperties)
+  , mGlslProgram(0)
+  , mRemapTexture(0)
+{
+  setupRemapTexture(focalLength, principalPoint, distortionCoefficients);
+
+  gles_utils::FragmentStage stage;
+  fragmentStage(stage);
+  mGlslProgram = buildFragmentStageGlslProgram({stage},
+                                               VertexAttributeLocations::kPosition);
+
+  std::tie(mResultTexture, mResultFbo) =
+      generateTextureBackedFbo(frameProperties.dimensions());
+  mResultSet["undistorted_texture"] = mResultTexture;
+}
+
+
+UndistortionProcessor::~UndistortionProcessor() {
+  glDeleteProgram(mGlslProgram);
+  glDeleteTextures(1, &mRemapTexture);
+}
+
+
+void UndistortionProcessor::setupRemapTexture(const glm::vec2& focalLength,
+                                              const glm::vec2& principalPoint,
+                                              const vector<float>& distortionCoefficients)
+{
+  size_t width = mFrameProperties.dimensions().first;
+  size_t height = mFrameProperties.dimensions().second;
+  cv::Matx33d cameraMatrix(focalLength.x, 0.0, principalPoint.x,
+                           0.0, focalLength.y, principalPoint.y,
+                           0.0, 0.0, 1.0);
+  cv::Mat mapX, mapY;
+
+  // Frame rows are uploaded top to bottom, so image and texture rows
+  // have the same order
+  cv::initUndistortRectifyMap(cameraMatrix, distortionCoefficients,
+                              cv::Mat(), cameraMatrix,
+                              cv::Size(width, height), CV_32FC1, mapX, mapY);
+
+  vector<GLubyte> remapData(width * height * 4);
+
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      // Sample source texel centres; positions outside the frame are
+      // clamped to its edge
+      float sourceX = (mapX.at<float>(y, x) + 0.5f) / width;
+      float sourceY = (mapY.at<float>(y, x) + 0.5f) / height;
+      auto fixedX = GLuint(std::min(std::max(sourceX, 0.0f), 1.0f) * 65535.0f + 0.5f);
+      auto fixedY = GLuint(std::min(std::max(sourceY, 0.0f), 1.0f) * 65535.0f + 0.5f);
+      GLubyte* texel = remapData.data() + (y * width + x) * 4;
+
+      texel[0] = fixedX >> 8;
+      texel[1] = fixedX & 0xFF;
+      texel[2] = fixedY >> 8;
+      texel[3] = fixedY & 0xFF;
+    }
+  }
+
+  glActiveTexture(GL_TEXTURE1);
+  glGenTextures(1, &mRemapTexture);
+  glBindTexture(GL_TEXTURE_2D, mRemapTexture);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, remapData.data());
+  assertNoGlError();
+}
+
+
+bool UndistortionProcessor::fragmentStage(gles_utils::FragmentStage& stage) const {
+  stage.functionName = "undistortion";
+  stage.sourceFile = "glsl/stages/undistortion.frag";
+  stage.outputKey = "undistorted_texture";
+  stage.textures = {{"remapTexture", mRemapTexture}};
+  stage.resamplesInput = true;
+
+  return true;
+}
+
+
+const ProcessingResultSet& UndistortionProcessor::process(GLuint frameTexture) {
+  utils::Profiler::Span processSpan(*mProfiler, "undistortion.process");
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, mRemapTexture);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mResultFbo);
+  glViewport(0, 0, mFrameProperties.dimensions().first,
+             mFrameProperties.dimensions().second);
+  glUseProgram(mGlslProgram);
+
+  glEnableVertexAttribArray(VertexAttributeLocations::kPosition);
+  drawFullscreenQuad(VertexAttributeLocations::kPosition);
+  glDisableVertexAttribArray(VertexAttributeLocations::kPosition);
+
+  return mResultSet;
+}
+
+
+} // end namespace processors
+} // end namespace glipf
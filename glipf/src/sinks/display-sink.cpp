@@ -111,9 +111,10 @@ void DisplaySink::send(const processors::ProcessingResultSet& resultSet) {
         textureResultCount++;
         break;
       case processors::ProcessingResultType::kNumbers:
+      case processors::ProcessingResultType::kLazyNumbers:
         std::cout << entry.first << ": " << std::fixed << std::setprecision(2);
 
-        for (auto number : boost::get<std::vector<float>>(entry.second)) {
+        for (auto number : processors::getNumbers(entry.second)) {
           std::cout << number << ", ";
         }
 
@@ -0,0 +1,192 @@
+#include <glipf/utils/model-projection.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+using std::vector;
+
+
+namespace glipf {
+namespace utils {
+
+
+namespace {
+
+float cross(const glm::vec2& origin, const glm::vec2& a, const glm::vec2& b) {
+  return (a.x - origin.x) * (b.y - origin.y) -
+         (a.y - origin.y) * (b.x - origin.x);
+}
+
+} // end namespace
+
+
+const vector<ProjectedModel>& ModelProjection::project(const vector<ModelData>& models,
+                                                       const glm::mat4& mvpMatrix)
+{
+  size_t vertexCount = 0;
+  mModelOffsets.clear();
+
+  for (const auto& model : models) {
+    mModelOffsets.push_back(vertexCount);
+    vertexCount += model.first.size() / 3;
+  }
+
+  mModelOffsets.push_back(vertexCount);
+  mVertexX.resize(vertexCount);
+  mVertexY.resize(vertexCount);
+  mVertexZ.resize(vertexCount);
+  mImageX.resize(vertexCount);
+  mImageY.resize(vertexCount);
+  mDepth.resize(vertexCount);
+
+  // Step 1: gather the interleaved model vertices into separate
+  // coordinate arrays
+  size_t vertexIndex = 0;
+
+  for (const auto& model : models) {
+    for (size_t i = 0; i < model.first.size(); i += 3) {
+      mVertexX[vertexIndex] = model.first[i];
+      mVertexY[vertexIndex] = model.first[i + 1];
+      mVertexZ[vertexIndex] = model.first[i + 2];
+      ++vertexIndex;
+    }
+  }
+
+  // Step 2: project all vertices in one pass; the loop has no
+  // dependencies between iterations, so it's vectorised by the compiler
+  const GLfloat* __restrict vertexX = mVertexX.data();
+  const GLfloat* __restrict vertexY = mVertexY.data();
+  const GLfloat* __restrict vertexZ = mVertexZ.data();
+  GLfloat* __restrict imageX = mImageX.data();
+  GLfloat* __restrict imageY = mImageY.data();
+  GLfloat* __restrict depth = mDepth.data();
+  const glm::mat4& m = mvpMatrix;
+
+  for (size_t i = 0; i < vertexCount; ++i) {
+    GLfloat x = vertexX[i], y = vertexY[i], z = vertexZ[i];
+    GLfloat projectedX = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+    GLfloat projectedY = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+    GLfloat projectedZ = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+
+    imageX[i] = projectedX / projectedZ;
+    imageY[i] = projectedY / projectedZ;
+    depth[i] = projectedZ;
+  }
+
+  // Step 3: reduce the projected vertices of every model to its extent
+  mProjectedModels.resize(models.size());
+
+  for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex) {
+    size_t firstVertex = mModelOffsets[modelIndex];
+    size_t lastVertex = mModelOffsets[modelIndex + 1];
+    ProjectedModel& projectedModel = mProjectedModels[modelIndex];
+
+    projectedModel.bboxMin = glm::vec2(std::numeric_limits<float>::max());
+    projectedModel.bboxMax = glm::vec2(std::numeric_limits<float>::lowest());
+    projectedModel.nearestDepth = std::numeric_limits<float>::max();
+
+    for (size_t i = firstVertex; i < lastVertex; ++i) {
+      projectedModel.bboxMin.x = std::min(projectedModel.bboxMin.x, imageX[i]);
+      projectedModel.bboxMin.y = std::min(projectedModel.bboxMin.y, imageY[i]);
+      projectedModel.bboxMax.x = std::max(projectedModel.bboxMax.x, imageX[i]);
+      projectedModel.bboxMax.y = std::max(projectedModel.bboxMax.y, imageY[i]);
+      projectedModel.nearestDepth = std::min(projectedModel.nearestDepth,
+                                             depth[i]);
+    }
+
+    computeMinAreaRect(firstVertex, lastVertex - firstVertex, projectedModel);
+  }
+
+  return mProjectedModels;
+}
+
+
+const vector<ProjectedModel>& ModelProjection::projectedModels() const {
+  return mProjectedModels;
+}
+
+
+void ModelProjection::computeMinAreaRect(size_t firstVertex,
+                                         size_t vertexCount,
+                                         ProjectedModel& projectedModel)
+{
+  projectedModel.area = 0.0f;
+
+  if (vertexCount < 3)
+    return;
+
+  // Build the convex hull of the projected vertices (monotone chain)
+  auto& points = mHullPoints;
+  points.clear();
+
+  for (size_t i = firstVertex; i < firstVertex + vertexCount; ++i)
+    points.emplace_back(mImageX[i], mImageY[i]);
+
+  std::sort(std::begin(points), std::end(points),
+            [](const glm::vec2& a, const glm::vec2& b) {
+              return a.x < b.x || (a.x == b.x && a.y < b.y);
+            });
+
+  mHull.resize(2 * points.size());
+  size_t hullSize = 0;
+
+  for (size_t i = 0; i < points.size(); ++i) {
+    while (hullSize >= 2 &&
+           cross(mHull[hullSize - 2], mHull[hullSize - 1], points[i]) <= 0.0f)
+    {
+      --hullSize;
+    }
+
+    mHull[hullSize++] = points[i];
+  }
+
+  for (size_t i = points.size() - 1, lowerHullSize = hullSize + 1; i > 0; --i) {
+    while (hullSize >= lowerHullSize &&
+           cross(mHull[hullSize - 2], mHull[hullSize - 1], points[i - 1]) <= 0.0f)
+    {
+      --hullSize;
+    }
+
+    mHull[hullSize++] = points[i - 1];
+  }
+
+  // The last point repeats the first one
+  --hullSize;
+
+  if (hullSize < 3)
+    return;
+
+  // The smallest enclosing rectangle has a side on one of the hull's
+  // edges; try them all, which is cheap for the few vertices of a model
+  float minArea = std::numeric_limits<float>::max();
+
+  for (size_t i = 0; i < hullSize; ++i) {
+    glm::vec2 edge = mHull[(i + 1) % hullSize] - mHull[i];
+    float edgeLength = glm::length(edge);
+
+    if (edgeLength == 0.0f)
+      continue;
+
+    glm::vec2 direction = edge / edgeLength;
+    glm::vec2 normal(-direction.y, direction.x);
+    float minAlong = 0.0f, maxAlong = 0.0f, maxAcross = 0.0f;
+
+    for (size_t j = 0; j < hullSize; ++j) {
+      glm::vec2 offset = mHull[j] - mHull[i];
+      float along = glm::dot(offset, direction);
+      minAlong = std::min(minAlong, along);
+      maxAlong = std::max(maxAlong, along);
+      maxAcross = std::max(maxAcross, std::abs(glm::dot(offset, normal)));
+    }
+
+    minArea = std::min(minArea, (maxAlong - minAlong) * maxAcross);
+  }
+
+  projectedModel.area = minArea;
+}
+
+
+} // end namespace utils
+} // end namespace glipf
@@ -0,0 +1,327 @@
+#include <glipf/utils/profiler.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+
+
+namespace glipf {
+namespace utils {
+
+
+namespace {
+
+// Entry points of GL_EXT_disjoint_timer_query, resolved at run-time as
+// the extension is missing from the Raspberry Pi's GLES headers
+typedef void (GL_APIENTRYP GenQueriesProc)(GLsizei n, GLuint* ids);
+typedef void (GL_APIENTRYP DeleteQueriesProc)(GLsizei n, const GLuint* ids);
+typedef void (GL_APIENTRYP BeginQueryProc)(GLenum target, GLuint id);
+typedef void (GL_APIENTRYP EndQueryProc)(GLenum target);
+typedef void (GL_APIENTRYP GetQueryObjectuivProc)(GLuint id, GLenum pname,
+                                                  GLuint* params);
+typedef void (GL_APIENTRYP GetQueryObjectui64vProc)(GLuint id, GLenum pname,
+                                                    uint64_t* params);
+
+GenQueriesProc genQueries = nullptr;
+DeleteQueriesProc deleteQueries = nullptr;
+BeginQueryProc beginQuery = nullptr;
+EndQueryProc endQuery = nullptr;
+GetQueryObjectuivProc getQueryObjectuiv = nullptr;
+GetQueryObjectui64vProc getQueryObjectui64v = nullptr;
+
+
+float secondsSince(const timespec& startTime) {
+  timespec endTime;
+  clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+  float duration = endTime.tv_sec - startTime.tv_sec;
+  duration += (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+  return duration;
+}
+
+} // end anonymous namespace
+
+
+DurationHistogram::DurationHistogram()
+  : mCount(0)
+  , mTotalDuration(0.0)
+  , mMinDuration(std::numeric_limits<float>::max())
+  , mMaxDuration(0.0f)
+{
+  mBuckets.fill(0);
+}
+
+
+void DurationHistogram::record(float duration) {
+  float microseconds = duration * 1e6f;
+  size_t bucketIndex = 0;
+
+  if (microseconds >= 1.0f) {
+    bucketIndex = std::min<size_t>(std::floor(std::log2(microseconds)),
+                                   kBucketCount - 1);
+  }
+
+  mBuckets[bucketIndex]++;
+  mCount++;
+  mTotalDuration += duration;
+  mMinDuration = std::min(mMinDuration, duration);
+  mMaxDuration = std::max(mMaxDuration, duration);
+}
+
+
+size_t DurationHistogram::count() const {
+  return mCount;
+}
+
+
+float DurationHistogram::meanDuration() const {
+  if (mCount == 0)
+    return 0.0f;
+
+  return mTotalDuration / mCount;
+}
+
+
+float DurationHistogram::minDuration() const {
+  if (mCount == 0)
+    return 0.0f;
+
+  return mMinDuration;
+}
+
+
+float DurationHistogram::maxDuration() const {
+  return mMaxDuration;
+}
+
+
+const DurationHistogram::Buckets& DurationHistogram::buckets() const {
+  return mBuckets;
+}
+
+
+Profiler::Span::Span(Profiler& profiler, const std::string& stageName)
+  : mProfiler(profiler)
+  , mStageName(stageName)
+  , mGpuQuery(0)
+  , mIsFinished(false)
+{
+  mGpuQuery = mProfiler.beginGpuQuery();
+  clock_gettime(CLOCK_MONOTONIC, &mStartTime);
+}
+
+
+Profiler::Span::~Span() {
+  finish();
+}
+
+
+void Profiler::Span::finish() {
+  if (mIsFinished)
+    return;
+
+  mIsFinished = true;
+  mProfiler.record(mStageName, secondsSince(mStartTime));
+
+  if (mGpuQuery != 0)
+    mProfiler.endGpuQuery(mGpuQuery, mStageName + ".gpu");
+}
+
+
+Profiler::Profiler()
+  : mIsGpuTimerInitialized(false)
+  , mHasGpuTimer(false)
+  , mActiveGpuQuery(0)
+{
+}
+
+
+Profiler::~Profiler() {
+  if (!mHasGpuTimer)
+    return;
+
+  for (const auto& pendingQuery : mPendingGpuQueries)
+    mFreeGpuQueries.push_back(pendingQuery.first);
+
+  if (mFreeGpuQueries.size() > 0)
+    deleteQueries(mFreeGpuQueries.size(), mFreeGpuQueries.data());
+}
+
+
+namespace {
+
+// GL queries belong to a context, so every context gets a profiler of
+// its own
+std::mutex defaultProfilersMutex;
+std::map<EGLContext, std::unique_ptr<Profiler>> defaultProfilers;
+
+} // end namespace
+
+
+Profiler& Profiler::defaultProfiler() {
+  std::lock_guard<std::mutex> lock(defaultProfilersMutex);
+  std::unique_ptr<Profiler>& profiler =
+      defaultProfilers[eglGetCurrentContext()];
+
+  if (!profiler)
+    profiler.reset(new Profiler());
+
+  return *profiler;
+}
+
+
+void Profiler::releaseDefaultProfiler() {
+  std::lock_guard<std::mutex> lock(defaultProfilersMutex);
+  defaultProfilers.erase(eglGetCurrentContext());
+}
+
+
+void Profiler::record(const std::string& stageName, float duration) {
+  mHistograms[stageName].record(duration);
+}
+
+
+const Profiler::HistogramMap& Profiler::histograms() {
+  collectGpuTimings();
+  return mHistograms;
+}
+
+
+void Profiler::reset() {
+  collectGpuTimings();
+  mHistograms.clear();
+}
+
+
+bool Profiler::hasGpuTimer() {
+  initializeGpuTimer();
+  return mHasGpuTimer;
+}
+
+
+void Profiler::initializeGpuTimer() {
+  if (mIsGpuTimerInitialized)
+    return;
+
+  const GLubyte* extensions = glGetString(GL_EXTENSIONS);
+
+  // No context is current yet; try again with the next span
+  if (extensions == nullptr)
+    return;
+
+  mIsGpuTimerInitialized = true;
+
+  if (!std::strstr(reinterpret_cast<const char*>(extensions),
+                   "GL_EXT_disjoint_timer_query"))
+    return;
+
+  genQueries = reinterpret_cast<GenQueriesProc>(
+      eglGetProcAddress("glGenQueriesEXT"));
+  deleteQueries = reinterpret_cast<DeleteQueriesProc>(
+      eglGetProcAddress("glDeleteQueriesEXT"));
+  beginQuery = reinterpret_cast<BeginQueryProc>(
+      eglGetProcAddress("glBeginQueryEXT"));
+  endQuery = reinterpret_cast<EndQueryProc>(
+      eglGetProcAddress("glEndQueryEXT"));
+  getQueryObjectuiv = reinterpret_cast<GetQueryObjectuivProc>(
+      eglGetProcAddress("glGetQueryObjectuivEXT"));
+  getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64vProc>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+
+  mHasGpuTimer = genQueries && deleteQueries && beginQuery && endQuery &&
+                 getQueryObjectuiv && getQueryObjectui64v;
+}
+
+
+GLuint Profiler::beginGpuQuery() {
+  initializeGpuTimer();
+
+  if (!mHasGpuTimer)
+    return 0;
+
+  collectGpuTimings();
+
+  // Timer queries can't be nested, so only the outermost span is timed
+  // on the GPU
+  if (mActiveGpuQuery != 0)
+    return 0;
+
+  if (mFreeGpuQueries.empty()) {
+    GLuint query;
+    genQueries(1, &query);
+    mFreeGpuQueries.push_back(query);
+  }
+
+  mActiveGpuQuery = mFreeGpuQueries.back();
+  mFreeGpuQueries.pop_back();
+  beginQuery(GL_TIME_ELAPSED_EXT, mActiveGpuQuery);
+
+  return mActiveGpuQuery;
+}
+
+
+void Profiler::endGpuQuery(GLuint query, const std::string& stageName) {
+  endQuery(GL_TIME_ELAPSED_EXT);
+  mActiveGpuQuery = 0;
+  mPendingGpuQueries.push_back(std::make_pair(query, stageName));
+}
+
+
+void Profiler::collectGpuTimings() {
+  if (!mHasGpuTimer || mPendingGpuQueries.empty())
+    return;
+
+  GLint isDisjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &isDisjoint);
+  size_t collectedQueryCount = 0;
+
+  // Queries complete in submission order, so stop at the first one
+  // whose result isn't available yet
+  for (const auto& pendingQuery : mPendingGpuQueries) {
+    GLuint isAvailable = GL_FALSE;
+    getQueryObjectuiv(pendingQuery.first, GL_QUERY_RESULT_AVAILABLE_EXT,
+                      &isAvailable);
+
+    if (!isAvailable)
+      break;
+
+    // Results are meaningless if the GPU was reset or its clock changed
+    if (!isDisjoint) {
+      uint64_t elapsedNanoseconds = 0;
+      getQueryObjectui64v(pendingQuery.first, GL_QUERY_RESULT_EXT,
+                          &elapsedNanoseconds);
+      record(pendingQuery.second, elapsedNanoseconds / 1e9);
+    }
+
+    mFreeGpuQueries.push_back(pendingQuery.first);
+    collectedQueryCount++;
+  }
+
+  mPendingGpuQueries.erase(mPendingGpuQueries.begin(),
+                           mPendingGpuQueries.begin() + collectedQueryCount);
+}
+
+
+} // end namespace utils
+} // end namespace glipf
@@ -0,0 +1,158 @@
+#include <glipf/utils/roi-scheduler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+
+namespace glipf {
+namespace utils {
+
+
+namespace {
+
+RegionOfInterest unite(const RegionOfInterest& a, const RegionOfInterest& b) {
+  int xMin = std::min(a.x, b.x);
+  int yMin = std::min(a.y, b.y);
+  int xMax = std::max(a.x + a.width, b.x + b.width);
+  int yMax = std::max(a.y + a.height, b.y + b.height);
+
+  return {xMin, yMin, xMax - xMin, yMax - yMin};
+}
+
+
+bool intersect(const RegionOfInterest& a, const RegionOfInterest& b) {
+  return a.x <= b.x + b.width && b.x <= a.x + a.width &&
+         a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+
+long area(const RegionOfInterest& region) {
+  return static_cast<long>(region.width) * region.height;
+}
+
+
+void mergeOverlapping(std::vector<RegionOfInterest>& regions) {
+  bool hasMerged = true;
+
+  // A grown region may overlap regions it was already compared with, so
+  // passes are repeated until one merges nothing
+  while (hasMerged) {
+    hasMerged = false;
+
+    for (size_t i = 0; i < regions.size(); ++i) {
+      for (size_t j = i + 1; j < regions.size(); ++j) {
+        if (intersect(regions[i], regions[j])) {
+          regions[i] = unite(regions[i], regions[j]);
+          regions.erase(regions.begin() + j);
+          --j;
+          hasMerged = true;
+        }
+      }
+    }
+  }
+}
+
+} // end namespace
+
+
+RoiScheduler::RoiScheduler(std::pair<size_t, size_t> frameDimensions,
+                           const glm::mat4& mvpMatrix, size_t margin,
+                           size_t maxRegionCount)
+  : mFrameDimensions(frameDimensions)
+  , mMvpMatrix(mvpMatrix)
+  , mMargin(margin)
+  , mMaxRegionCount(maxRegionCount)
+{
+  assert(mMaxRegionCount > 0);
+}
+
+
+void RoiScheduler::clear() {
+  mRegions.clear();
+}
+
+
+void RoiScheduler::addModels(const std::vector<ModelProjection::ModelData>& models) {
+  glm::vec2 frameDimensions(mFrameDimensions.first, mFrameDimensions.second);
+
+  for (const auto& projectedModel : mModelProjection.project(models, mMvpMatrix)) {
+    // Models crossing the camera plane may cover any part of the frame
+    if (projectedModel.nearestDepth <= 0.0f) {
+      addRegion({0, 0, int(mFrameDimensions.first),
+                 int(mFrameDimensions.second)});
+      continue;
+    }
+
+    // Keep far-off models from overflowing the integer coordinates
+    glm::vec2 minPosition = glm::clamp(projectedModel.bboxMin,
+                                       glm::vec2(-1.0f), frameDimensions);
+    glm::vec2 maxPosition = glm::clamp(projectedModel.bboxMax,
+                                       glm::vec2(-1.0f), frameDimensions);
+
+    int xMin = std::floor(minPosition.x) - mMargin;
+    int yMin = std::floor(minPosition.y) - mMargin;
+    int xMax = std::ceil(maxPosition.x) + mMargin;
+    int yMax = std::ceil(maxPosition.y) + mMargin;
+
+    addRegion({xMin, yMin, xMax - xMin, yMax - yMin});
+  }
+}
+
+
+void RoiScheduler::addRegion(const RegionOfInterest& region) {
+  mRegions.push_back(region);
+}
+
+
+std::vector<RegionOfInterest> RoiScheduler::regions() const {
+  RegionOfInterest frameRegion = {0, 0, int(mFrameDimensions.first),
+                                  int(mFrameDimensions.second)};
+  std::vector<RegionOfInterest> regions;
+
+  // Clip the regions to the frame, dropping the ones outside it
+  for (const auto& region : mRegions) {
+    int xMin = std::max(region.x, 0);
+    int yMin = std::max(region.y, 0);
+    int xMax = std::min(region.x + region.width, frameRegion.width);
+    int yMax = std::min(region.y + region.height, frameRegion.height);
+
+    if (xMin < xMax && yMin < yMax)
+      regions.push_back({xMin, yMin, xMax - xMin, yMax - yMin});
+  }
+
+  mergeOverlapping(regions);
+
+  // Merge the pairs whose union adds the least area until few enough
+  // regions are left
+  while (regions.size() > mMaxRegionCount) {
+    size_t bestI = 0, bestJ = 1;
+    long bestGrowth = std::numeric_limits<long>::max();
+
+    for (size_t i = 0; i < regions.size(); ++i) {
+      for (size_t j = i + 1; j < regions.size(); ++j) {
+        long growth = area(unite(regions[i], regions[j])) -
+                      area(regions[i]) - area(regions[j]);
+
+        if (growth < bestGrowth) {
+          bestGrowth = growth;
+          bestI = i;
+          bestJ = j;
+        }
+      }
+    }
+
+    regions[bestI] = unite(regions[bestI], regions[bestJ]);
+    regions.erase(regions.begin() + bestJ);
+
+    // The union may now overlap other regions
+    mergeOverlapping(regions);
+  }
+
+  return regions;
+}
+
+
+} // end namespace utils
+} // end namespace glipf
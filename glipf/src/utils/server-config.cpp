@@ -0,0 +1,56 @@
+#include <glipf/utils/server-config.h>
+
+#include <string>
+#include <vector>
+
+
+using glipf::processors::MorphologicalOperation;
+
+using std::string;
+using std::vector;
+
+
+namespace glipf {
+namespace utils {
+
+
+MorphologyConfig readMorphologyConfig(const boost::property_tree::ptree& config) {
+  MorphologyConfig morphologyConfig;
+  string operation = config.get<string>("morphology.operation", "none");
+
+  morphologyConfig.isEnabled = true;
+  morphologyConfig.kernelRadius = config.get<size_t>("morphology.kernelRadius", 1);
+
+  if (operation == "erode") {
+    morphologyConfig.operation = MorphologicalOperation::kErode;
+  } else if (operation == "dilate") {
+    morphologyConfig.operation = MorphologicalOperation::kDilate;
+  } else if (operation == "open") {
+    morphologyConfig.operation = MorphologicalOperation::kOpen;
+  } else if (operation == "close") {
+    morphologyConfig.operation = MorphologicalOperation::kClose;
+  } else {
+    morphologyConfig.isEnabled = false;
+  }
+
+  return morphologyConfig;
+}
+
+
+std::pair<size_t, size_t> readCaptureResolution(const boost::property_tree::ptree& config) {
+  vector<size_t> resolution;
+
+  if (auto resolutionConfig = config.get_child_optional("captureResolution")) {
+    for (auto& val : *resolutionConfig)
+      resolution.push_back(val.second.get_value<size_t>());
+  }
+
+  if (resolution.size() != 2)
+    return std::make_pair(640, 480);
+
+  return std::make_pair(resolution[0], resolution[1]);
+}
+
+
+} // end namespace utils
+} // end namespace glipf
@@ -72,10 +72,11 @@ Application::~Application()
 
 void Application::run()
 {
+    bool isScanFrame=detectionTimer.elapsed()>config.detection_interval;
 
     for(size_t i=0;i<clients.size();++i)
     {
-        clients[i]->send_grabFrame();
+        clients[i]->send_grabFrame(isScanFrame);
     }
 
     for(size_t i=0;i<clients.size();++i)
@@ -85,7 +86,7 @@ void Application::run()
 
     frame_id++;
 
-    if(detectionTimer.elapsed()>config.detection_interval)
+    if(isScanFrame)
     {
         std::cout << "Running detection" << std::endl;
         std::vector<target::Target > detections;
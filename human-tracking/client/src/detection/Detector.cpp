@@ -118,9 +118,11 @@ void Detector::initDetector()
         clients[i]->send_initForegroundCoverageProcessor(modelCenters, modelDims);
     }
 
+    visibleModelIndices.resize(nCams);
+
     for(size_t i=0;i<nCams;++i)
     {
-        clients[i]->recv_initForegroundCoverageProcessor();
+        clients[i]->recv_initForegroundCoverageProcessor(visibleModelIndices[i]);
     }
 
     if(x_count>0&&y_count>0)
@@ -153,12 +155,21 @@ bool Detector::detect(std::vector<target::Target >& targets_old, std::vector<tar
         clients[i]->send_scanForeground();
     }
 
+    /* cameras only scan the cells they see; cells outside their view
+       count as uncovered */
     std::vector<std::vector<double> > resultVectors;
-    resultVectors.resize(nCams);
+    resultVectors.resize(nCams, std::vector<double>(modelCenters.size(), 0.0));
+    std::vector<double> visibleResults;
 
     for(size_t i=0;i<nCams;++i)
     {
-        clients[i]->recv_scanForeground(resultVectors[i]);
+        visibleResults.clear();
+        clients[i]->recv_scanForeground(visibleResults);
+
+        for(size_t k=0;k<visibleResults.size();++k)
+        {
+            resultVectors[i][visibleModelIndices[i][k]]=visibleResults[k];
+        }
     }
 
     size_t vectors_size;
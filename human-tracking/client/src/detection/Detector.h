@@ -64,6 +64,9 @@ private:
 
     std::vector<glipf::Point3d> modelCenters;
 
+    /* indices of the model centers visible to each camera */
+    std::vector<std::vector<int32_t> > visibleModelIndices;
+
     cv::Mat debugImg;
 
     int x_count;
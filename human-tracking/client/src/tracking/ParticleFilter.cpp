@@ -44,6 +44,7 @@ void ParticleFilterParams::parse(std::string filename)
     DYNAMICS_B0 = iniFile.value("DYNAMICS_B0", "100").toFloat();
 
     DYNAMIC_MODEL_CV = iniFile.value("DYNAMIC_MODEL_CV", "false").toBool();
+    PARTICLE_LOD = iniFile.value("PARTICLE_LOD", "false").toBool();
     LAMBDA = iniFile.value("LAMBDA", "20.0").toFloat();
 
     std::cout << "PARTICLE_FILTER " << std::endl;
@@ -55,6 +56,7 @@ void ParticleFilterParams::parse(std::string filename)
     std::cout << "DYNAMICS_A2 " << DYNAMICS_A2 << std::endl;
     std::cout << "DYNAMICS_B0 " << DYNAMICS_B0 << std::endl;
     std::cout << "DYNAMIC_MODEL_CV " << (int)DYNAMIC_MODEL_CV << std::endl;
+    std::cout << "PARTICLE_LOD " << (int)PARTICLE_LOD << std::endl;
     std::cout << "LAMBDA       " << LAMBDA << std::endl;
 
 
@@ -121,6 +123,7 @@ void ParticleFilter::initialize(const cv::Vec3d& initPose)
         mParticles[i].y_velocity = 0.0f;
         mParticles[i].z_velocity = 0.0f;
         mParticles[i].w  = 0.0f;
+        mParticles[i].lod = 0;
     }
 }
 
@@ -140,6 +143,7 @@ void ParticleFilter::resizeParticleSet(int n)
         newParticles[i].y_velocity = mParticles[0].y_velocity;
         newParticles[i].z_velocity = mParticles[0].z_velocity;
         newParticles[i].w  = mParticles[0].w;
+        newParticles[i].lod = 0;
     }
 
     mParams.NUMBER_OF_PARTICLES = n;
@@ -338,7 +342,10 @@ void ParticleFilter::resample()
         np = cvRound( mParticles[i].w * mParams.NUMBER_OF_PARTICLES);
         for(int j = 0; j<np; ++j)
         {
-            new_particles[k++] = mParticles[i];
+            /* copies beyond the first are near-duplicates and, if enabled,
+               are evaluated at a coarser level of detail */
+            new_particles[k] = mParticles[i];
+            new_particles[k++].lod = (!mParams.PARTICLE_LOD || j == 0) ? 0 : ((j < 4) ? 1 : 2);
             if( k == mParams.NUMBER_OF_PARTICLES )
             {
                 goto exit;
@@ -347,7 +354,10 @@ void ParticleFilter::resample()
         }
     }
     while( k < mParams.NUMBER_OF_PARTICLES )
-        new_particles[k++] = mParticles[0];
+    {
+        new_particles[k] = mParticles[0];
+        new_particles[k++].lod = mParams.PARTICLE_LOD ? 1 : 0;
+    }
 
 exit:
     delete[] mParticles;
@@ -405,6 +415,11 @@ void ParticleFilter::getOutputVelocity(cv::Vec3d& vel)
     vel(2) = mParticles[0].z;
 }
 
+int ParticleFilter::getParticleLod(int id)
+{
+    return mParticles[id].lod;
+}
+
 uint ParticleFilter::getFilterId()
 {
     return filterId;
@@ -43,6 +43,9 @@ public:
 
     bool DYNAMIC_MODEL_CV;
 
+    /* evaluate near-duplicate particles at a coarser level of detail */
+    bool PARTICLE_LOD;
+
     float LAMBDA;
 };
 
@@ -62,6 +65,7 @@ struct Particle
     float z_velocity; /**< current z_velocity coordinate */
 
     float w;          /**< weight */
+    int lod;          /**< level of detail of the likelihood evaluation */
 };
 
 class ParticleFilter
@@ -106,6 +110,8 @@ public:
 
     void getParticlePose(int id, cv::Vec3d& pose);
 
+    int getParticleLod(int id);
+
     void getOutputPose(cv::Vec3d& pose);
 
     void getOutputVelocity(cv::Vec3d& vel);
@@ -84,6 +84,10 @@ void Tracker::track()
             particles.back().pose.x=particle_pose(0);
             particles.back().pose.y=particle_pose(1);
             particles.back().pose.z=particle_pose(2);
+            /* servers evaluate particles without a hint at full detail */
+            int lod = trackers[i]->getParticleLod(n);
+            if(lod != 0)
+                particles.back().__set_lod(lod);
 //            std::cout << "Particle " << n << " " <<
 //                         particles.back().pose.x << " " <<
 //                         particles.back().pose.y << " " <<
@@ -19,18 +19,34 @@ struct Target {
 struct Particle {
   1: i32 id,
   2: Point3d pose,
+  // Level of detail of the histogram evaluation: every 2^lod-th pixel
+  // of the particle is sampled. 0 evaluates every pixel.
+  3: optional i32 lod
+}
+
+struct StageTiming {
+  1: i64 count,
+  2: double meanDuration,
+  3: double minDuration,
+  4: double maxDuration,
+  5: list<i64> histogram
 }
 
 
 service GlipfServer {
 
-  void initForegroundCoverageProcessor(1: list<Point3d> modelCenters,
-                                       2: Dims modelDims)
+  // Returns the indices of the models that project into the camera's
+  // image; scanForeground() only covers these, in the same order
+  list<i32> initForegroundCoverageProcessor(1: list<Point3d> modelCenters,
+                                            2: Dims modelDims)
   list<double> scanForeground()
   void initTarget(1: Target targetData, 2: bool computeRef)
   bool isVisible(1: list<Target> targets, 2: Target newTarget)
   void targetUpdate(1: list<Target> targets)
   list<double> computeDistance(1: list<Particle> particles)
   void drawDebugOutput(1: list<Target> targets, 2: bool drawParticles)
-  void grabFrame()
+  // Scan frames also prepare the foreground for scanForeground(); other
+  // frames only where targets and particles were last seen
+  void grabFrame(1: bool isScanFrame)
+  map<string, StageTiming> getStageTimings()
 }
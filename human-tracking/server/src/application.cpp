@@ -17,8 +17,10 @@
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TTransportUtils.h>
 
+#include <glipf/gles-utils/render-target-pool.h>
 #include <glipf/sources/v4l2-camera.h>
 #include <glipf/sources/opencv-video-source.h>
+#include <glipf/utils/server-config.h>
 
 #include "glipf-server-handler.h"
 
@@ -26,6 +28,8 @@
 using glipf::sources::FrameSource;
 using glipf::sources::OpenCvVideoSource;
 using glipf::sources::V4L2Camera;
+using glipf::utils::readCaptureResolution;
+using glipf::utils::readMorphologyConfig;
 
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
@@ -36,6 +40,28 @@ using std::string;
 using std::vector;
 
 
+GlipfServerHandler::UndistortionConfig readUndistortionConfig(const boost::property_tree::ptree& config,
+                                                              const vector<GLfloat>& intrinsicsData)
+{
+  GlipfServerHandler::UndistortionConfig undistortionConfig;
+
+  if (auto distortion = config.get_child_optional("distortion")) {
+    for (auto& val : *distortion)
+      undistortionConfig.coefficients.push_back(val.second.get_value<float>());
+  }
+
+  undistortionConfig.isEnabled = !undistortionConfig.coefficients.empty();
+
+  // Intrinsics are a row-major 3x4 matrix
+  undistortionConfig.focalLength = glm::vec2(intrinsicsData[0],
+                                             intrinsicsData[5]);
+  undistortionConfig.principalPoint = glm::vec2(intrinsicsData[2],
+                                                intrinsicsData[6]);
+
+  return undistortionConfig;
+}
+
+
 int main() {
   bcm_host_init();
 
@@ -47,12 +73,33 @@ int main() {
   vector<GLfloat> intrinsicsData, extrinsicsData;
   boost::optional<string> videoFileName = config.get_optional<string>("videoFile");
   float visibilityThreshold = config.get<float>("visibilityThreshold");
+  GlipfServerHandler::BackgroundModelConfig backgroundModelConfig;
+  string backgroundModel = config.get<string>("backgroundModel", "reference");
+
+  if (backgroundModel == "mog") {
+    backgroundModelConfig.model =
+        GlipfServerHandler::BackgroundModel::kMixtureOfGaussians;
+  } else {
+    backgroundModelConfig.model =
+        GlipfServerHandler::BackgroundModel::kReferenceFrame;
+  }
+
+  backgroundModelConfig.adaptationRate =
+      config.get<float>("backgroundAdaptationRate", 0.0f);
+  backgroundModelConfig.gaussianCount =
+      config.get<size_t>("mog.gaussianCount", 3);
+  backgroundModelConfig.historyLength =
+      config.get<size_t>("mog.historyLength", 200);
+  backgroundModelConfig.backgroundRatio =
+      config.get<float>("mog.backgroundRatio", 0.7f);
+  backgroundModelConfig.hasHsvOutput =
+      config.get<string>("foregroundColorSpace", "rgb") == "hsv";
   std::unique_ptr<FrameSource> frameSource;
 
   if (videoFileName)
     frameSource.reset(new OpenCvVideoSource(*videoFileName));
   else
-    frameSource.reset(new V4L2Camera(std::make_pair(640, 480)));
+    frameSource.reset(new V4L2Camera(readCaptureResolution(config)));
 
   for (auto& val : config.get_child("intrinsics"))
     intrinsicsData.push_back(val.second.get_value<GLfloat>());
@@ -74,7 +121,21 @@ int main() {
   // Configure and start Thrift RPC server
   boost::shared_ptr<GlipfServerHandler> handler(new GlipfServerHandler(std::move(frameSource),
                                                                        expandedProjectionMatrix,
-                                                                       visibilityThreshold));
+                                                                       visibilityThreshold,
+                                                                       backgroundModelConfig,
+                                                                       readMorphologyConfig(config),
+                                                                       readUndistortionConfig(config, intrinsicsData),
+                                                                       config.get<size_t>("framePyramidLevels", 0),
+                                                                       config.get<bool>("occlusionCulling", false),
+                                                                       config.get<bool>("regionOfInterestScheduling", false),
+                                                                       config.get<float>("processingQuality", 1.0f)));
+
+  // Render targets are shared by all processors of the handler's GL
+  // context, which is current from here on; warn when they take more of
+  // the GPU memory split than configured
+  glipf::gles_utils::RenderTargetPool::defaultPool().setMemoryBudget(
+      config.get<size_t>("renderTargetMemoryBudget", 0) * 1024 * 1024);
+
   boost::shared_ptr<TProcessor> processor(new glipf::GlipfServerProcessor(handler));
   boost::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
 
@@ -4,12 +4,20 @@
 #include <opencv2/opencv.hpp>
 
 
+
 using glipf::processors::BackgroundSubtractionProcessor;
 using glipf::processors::ForegroundCoverageProcessor;
 using glipf::processors::ForegroundHistogramProcessor;
+using glipf::processors::FramePyramidProcessor;
+using glipf::processors::FusedProcessor;
 using glipf::processors::GlesProcessor;
 using glipf::processors::ModelDebugProcessor;
 using glipf::processors::ModelOcclusionProcessor;
+using glipf::processors::MogBgSubProcessor;
+using glipf::processors::MorphologyProcessor;
+using glipf::processors::ProcessingResultSet;
+using glipf::processors::UndistortionProcessor;
+using glipf::processors::getNumbers;
 using glipf::sinks::DisplaySink;
 using glipf::sources::FrameSource;
 
@@ -17,6 +25,11 @@ using std::vector;
 using std::unique_ptr;
 
 
+// Margin, in pixels, around regions of interest to allow for the motion
+// of targets since their last update
+static const size_t kRegionOfInterestMargin = 16;
+
+
 GlesProcessor::ModelData generateCuboidData(float cx, float cy, float cz,
                                             const glipf::Dims& modelDims)
 {
@@ -44,6 +57,35 @@ GlesProcessor::ModelData generateCuboidData(float cx, float cy, float cz,
 }
 
 
+vector<GlesProcessor::ModelData> generateTargetModels(const vector<glipf::Target>& targets,
+                                                      const glipf::Dims& modelDims)
+{
+  vector<GlesProcessor::ModelData> models;
+
+  for (auto& target : targets) {
+    models.push_back(generateCuboidData(target.pose.x, target.pose.y,
+                                        target.pose.z, modelDims));
+  }
+
+  return models;
+}
+
+
+bool isModelInFrame(const glipf::utils::ProjectedModel& projectedModel,
+                    std::pair<size_t, size_t> frameDimensions)
+{
+  // Models crossing the camera plane can't be bounded by their
+  // projection; keep them
+  if (projectedModel.nearestDepth <= 0.0f)
+    return true;
+
+  return projectedModel.bboxMax.x >= 0.0f &&
+         projectedModel.bboxMax.y >= 0.0f &&
+         projectedModel.bboxMin.x < frameDimensions.first &&
+         projectedModel.bboxMin.y < frameDimensions.second;
+}
+
+
 GlesProcessor::ModelData generateWireframeModel(float cx, float cy, float cz,
                                                 const glipf::Dims& modelDims)
 {
@@ -79,35 +121,162 @@ GlesProcessor::ModelData generateWireframeModel(float cx, float cy, float cz,
 
 GlipfServerHandler::GlipfServerHandler(unique_ptr<FrameSource> frameSource,
                                        const glm::mat4& mvpMatrix,
-                                       float visibilityThreshold)
+                                       float visibilityThreshold,
+                                       const BackgroundModelConfig& backgroundModelConfig,
+                                       const MorphologyConfig& morphologyConfig,
+                                       const UndistortionConfig& undistortionConfig,
+                                       size_t framePyramidLevelCount,
+                                       bool isOcclusionCullingEnabled,
+                                       bool isRoiSchedulingEnabled,
+                                       float processingQuality)
   : mProjectionMatrix(mvpMatrix)
   , mFrameSource(std::move(frameSource))
   , mVisibilityThreshold(visibilityThreshold)
+  , mBackgroundModelConfig(backgroundModelConfig)
+  , mMorphologyConfig(morphologyConfig)
+  , mFramePyramidLevelCount(framePyramidLevelCount)
+  , mIsOcclusionCullingEnabled(isOcclusionCullingEnabled)
+  , mIsRoiSchedulingEnabled(isRoiSchedulingEnabled)
+  , mProcessingQuality(processingQuality)
+  , mRoiScheduler(mFrameSource->getFrameProperties().dimensions(), mvpMatrix,
+                  kRegionOfInterestMargin)
   , mFrameTextureContainer(mFrameSource->getFrameProperties().dimensions())
+  , mFrameTexture(0)
+  , mIsFrameUndistorted(false)
   , mForegroundTexture(0)
   , mLastFrameNumber(0)
 {
+  if (undistortionConfig.isEnabled) {
+    mUndistortionProcessor.reset(
+        new UndistortionProcessor(mFrameSource->getFrameProperties(),
+                                  undistortionConfig.focalLength,
+                                  undistortionConfig.principalPoint,
+                                  undistortionConfig.coefficients));
+  }
+}
+
+
+void GlipfServerHandler::uploadFrame(const void* frameData) {
+  mFrameTextureContainer.uploadData(frameData);
+  mFrameTexture = mFrameTextureContainer.getTexture();
+  mIsFrameUndistorted = !mUndistortionProcessor;
+}
+
+
+GLuint GlipfServerHandler::frameTexture() {
+  // Undistort on first use, so that frames only consumed by the fused
+  // foreground pass are never undistorted on their own
+  if (!mIsFrameUndistorted) {
+    const auto& resultSet = mUndistortionProcessor->process(mFrameTexture);
+    mFrameTexture = boost::get<GLuint>(resultSet.at("undistorted_texture"));
+    mIsFrameUndistorted = true;
+  }
+
+  return mFrameTexture;
+}
+
+
+void GlipfServerHandler::scheduleRegionsOfInterest(bool isScanFrame) {
+  mRoiScheduler.clear();
+
+  if (isScanFrame) {
+    for (const auto& region : mDetectionRegions)
+      mRoiScheduler.addRegion(region);
+  }
+
+  vector<GlesProcessor::ModelData> models;
+
+  for (const auto& target : mLastTargets) {
+    models.push_back(generateCuboidData(target.pose.x, target.pose.y,
+                                        target.pose.z, mModelDims));
+  }
+
+  for (const auto& particle : mLastParticles) {
+    models.push_back(generateCuboidData(particle.pose.x, particle.pose.y,
+                                        particle.pose.z, mModelDims));
+  }
+
+  mRoiScheduler.addModels(models);
+
+  // With nothing to track or scan, the whole frame is kept up to date
+  // for the next detection
+  mBackgroundSubtractionProcessor->setRegionsOfInterest(
+      mRoiScheduler.regions());
+
+  if (mFusedForegroundProcessor)
+    mFusedForegroundProcessor->setRegionsOfInterest(mRoiScheduler.regions());
 }
 
 
-void GlipfServerHandler::grabFrame() {
-  mFrameTextureContainer.uploadData(mFrameSource->grabFrame());
+void GlipfServerHandler::grabFrame(const bool isScanFrame) {
+  uploadFrame(mFrameSource->grabFrame());
   ++mLastFrameNumber;
 
-  const auto& resultSet =
-      mBackgroundSubtractionProcessor->process(mFrameTextureContainer.getTexture());
+  // Subtract the background only where later stages will look
+  if (mIsRoiSchedulingEnabled)
+    scheduleRegionsOfInterest(isScanFrame);
+
+  const auto& resultSet = mFusedForegroundProcessor ?
+      mFusedForegroundProcessor->process(mFrameTextureContainer.getTexture()) :
+      mBackgroundSubtractionProcessor->process(frameTexture());
   mForegroundTexture = boost::get<GLuint>(resultSet.at("foreground_texture"));
+
+  if (mMorphologyProcessor) {
+    const auto& morphologyResultSet =
+        mMorphologyProcessor->process(mForegroundTexture);
+    mForegroundTexture =
+        boost::get<GLuint>(morphologyResultSet.at("morphology_texture"));
+  }
+
+  // Reduce the foreground once for all processors working at a lower
+  // resolution
+  if (mFramePyramidProcessor)
+    mFramePyramidProcessor->process(mForegroundTexture);
+}
+
+
+GLuint GlipfServerHandler::foregroundTextureFor(const GlesProcessor& processor,
+                                                bool isHsv) const
+{
+  if (!mFramePyramidProcessor)
+    return mForegroundTexture;
+
+  return mFramePyramidProcessor->textureFor(processor, isHsv);
+}
+
+
+void GlipfServerHandler::setOccluderTargets(const vector<glipf::Target>& targets) {
+  mTargetOccluderIndices.clear();
+
+  for (size_t i = 0; i < targets.size(); ++i)
+    mTargetOccluderIndices[targets[i].id] = i;
 }
 
 
-void GlipfServerHandler::initForegroundCoverageProcessor(const vector<glipf::Point3d>& modelCenters,
+void GlipfServerHandler::initForegroundCoverageProcessor(vector<int32_t>& result,
+                                                         const vector<glipf::Point3d>& modelCenters,
                                                          const glipf::Dims& modelDims)
 {
-  std::vector<GlesProcessor::ModelData> models;
+  std::vector<GlesProcessor::ModelData> gridModels, models;
 
-  for (auto& modelCenter : modelCenters) {
-    models.push_back(generateCuboidData(modelCenter.x, modelCenter.y,
-                                        modelCenter.z, modelDims));
+  for (const auto& modelCenter : modelCenters) {
+    gridModels.push_back(generateCuboidData(modelCenter.x, modelCenter.y,
+                                            modelCenter.z, modelDims));
+  }
+
+  // Only models the camera sees are scanned; the client maps their
+  // coverage back to the grid through the returned indices
+  glipf::utils::ModelProjection gridProjection;
+  const auto& projectedModels = gridProjection.project(gridModels,
+                                                       mProjectionMatrix);
+
+  for (size_t i = 0; i < gridModels.size(); ++i) {
+    if (isModelInFrame(projectedModels[i],
+                       mFrameSource->getFrameProperties().dimensions()))
+    {
+      models.push_back(std::move(gridModels[i]));
+      result.push_back(i);
+    }
   }
 
   const void* frameData;
@@ -117,20 +286,86 @@ void GlipfServerHandler::initForegroundCoverageProcessor(const vector<glipf::Poi
 
   mModelDims = modelDims;
   mLastFrameNumber = 3;
-  mFrameTextureContainer.uploadData(frameData);
 
-  mBackgroundSubtractionProcessor.reset(
-      new BackgroundSubtractionProcessor(mFrameSource->getFrameProperties(),
-                                         frameData));
+  mRoiScheduler.addModels(models);
+  mDetectionRegions = mRoiScheduler.regions();
+  mRoiScheduler.clear();
+  uploadFrame(frameData);
+
+  switch (mBackgroundModelConfig.model) {
+    case BackgroundModel::kReferenceFrame: {
+      auto referenceFrameProcessor =
+          new BackgroundSubtractionProcessor(mFrameSource->getFrameProperties(),
+                                             frameData,
+                                             mBackgroundModelConfig.adaptationRate,
+                                             mBackgroundModelConfig.hasHsvOutput);
+
+      // The raw frame data is still distorted
+      if (mUndistortionProcessor)
+        referenceFrameProcessor->setReferenceFrame(frameTexture());
+
+      mBackgroundSubtractionProcessor.reset(referenceFrameProcessor);
+      break;
+    }
+    case BackgroundModel::kMixtureOfGaussians:
+      mBackgroundSubtractionProcessor.reset(
+          new MogBgSubProcessor(mFrameSource->getFrameProperties(),
+                                mBackgroundModelConfig.gaussianCount,
+                                mBackgroundModelConfig.historyLength,
+                                mBackgroundModelConfig.backgroundRatio,
+                                mBackgroundModelConfig.hasHsvOutput));
+      break;
+  }
+
+  // A static reference frame is subtracted pixel by pixel, so frames can
+  // be undistorted in the same pass
+  mFusedForegroundProcessor.reset();
+
+  if (mUndistortionProcessor) {
+    vector<const GlesProcessor*> foregroundChain = {
+      mUndistortionProcessor.get(), mBackgroundSubtractionProcessor.get()
+    };
+
+    if (FusedProcessor::canFuse(foregroundChain)) {
+      mFusedForegroundProcessor.reset(
+          new FusedProcessor(mFrameSource->getFrameProperties(),
+                             foregroundChain));
+    }
+  }
+
+  if (mMorphologyConfig.isEnabled) {
+    mMorphologyProcessor.reset(
+        new MorphologyProcessor(mFrameSource->getFrameProperties(),
+                                mMorphologyConfig.operation,
+                                mMorphologyConfig.kernelRadius));
+  }
+
+  if (mFramePyramidLevelCount > 0) {
+    mFramePyramidProcessor.reset(
+        new FramePyramidProcessor(mFrameSource->getFrameProperties(),
+                                  mFramePyramidLevelCount,
+                                  mBackgroundModelConfig.hasHsvOutput));
+  }
+
   mForegroundCoverageProcessor.reset(
       new ForegroundCoverageProcessor(mFrameSource->getFrameProperties(),
-                                      models, mProjectionMatrix));
+                                      models, mProjectionMatrix,
+                                      mProcessingQuality));
+
+  // Histograms are computed from HSV when the foreground or the frame
+  // pyramid provides it
   mForegroundHistogramProcessor.reset(
       new ForegroundHistogramProcessor(mFrameSource->getFrameProperties(),
-                                       96, mProjectionMatrix));
+                                       96, mProjectionMatrix,
+                                       mBackgroundModelConfig.hasHsvOutput ||
+                                           mFramePyramidProcessor != nullptr,
+                                       mProcessingQuality));
   mModelOcclusionProcessor.reset(
       new ModelOcclusionProcessor(mFrameSource->getFrameProperties(),
-                                  mProjectionMatrix));
+                                  mProjectionMatrix, mProcessingQuality));
+  mProbeOcclusionProcessor.reset(
+      new ModelOcclusionProcessor(mFrameSource->getFrameProperties(),
+                                  mProjectionMatrix, mProcessingQuality));
   mModelDebugProcessor.reset(
       new ModelDebugProcessor(mFrameSource->getFrameProperties(),
                               mProjectionMatrix));
@@ -139,7 +374,7 @@ void GlipfServerHandler::initForegroundCoverageProcessor(const vector<glipf::Poi
 
   mModelDebugProcessor->setModels(models);
   const auto& debugResultSet =
-      mModelDebugProcessor->process(mFrameTextureContainer.getTexture());
+      mModelDebugProcessor->process(frameTexture());
 
   mDisplaySink->send(debugResultSet);
   mGlesContext.swapBuffers();
@@ -148,9 +383,10 @@ void GlipfServerHandler::initForegroundCoverageProcessor(const vector<glipf::Poi
 
 void GlipfServerHandler::scanForeground(std::vector<double>& result) {
   const auto& resultSet =
-      mForegroundCoverageProcessor->process(mForegroundTexture);
+      mForegroundCoverageProcessor->process(
+          foregroundTextureFor(*mForegroundCoverageProcessor));
   const auto& foregroundCoverage =
-      boost::get<vector<float>>(resultSet.at("model_coverage"));
+      getNumbers(resultSet.at("model_coverage"));
 
   for (auto number : foregroundCoverage)
     result.push_back(number);
@@ -172,16 +408,16 @@ void GlipfServerHandler::initTarget(const glipf::Target& targetData,
   if (computeRef) {
     mForegroundHistogramProcessor->setModels(models, mProjectionMatrix);
     const auto& resultSet =
-        mForegroundHistogramProcessor->process(mForegroundTexture);
+        mForegroundHistogramProcessor->process(
+            foregroundTextureFor(*mForegroundHistogramProcessor, true));
 
-    mTargetHistograms[targetData.id] =
-        boost::get<vector<float>>(resultSet.at("0"));
+    mTargetHistograms[targetData.id] = getNumbers(resultSet.at("0"));
     mTargetCoverage[targetData.id] =
-        boost::get<vector<float>>(resultSet.at("histogram_coverage"))[0];
+        getNumbers(resultSet.at("histogram_coverage"))[0];
   }
 
   mModelDebugProcessor->setModels(models);
-  mModelDebugProcessor->process(mFrameTextureContainer.getTexture());
+  mModelDebugProcessor->process(frameTexture());
 
   GLubyte pixelData[fboWidth * fboHeight * 4];
   glReadPixels(0, 0, fboWidth, fboHeight, GL_RGBA, GL_UNSIGNED_BYTE,
@@ -196,23 +432,18 @@ void GlipfServerHandler::initTarget(const glipf::Target& targetData,
 bool GlipfServerHandler::isVisible(const vector<glipf::Target>& targets,
                                    const glipf::Target& newTarget)
 {
-  vector<GlesProcessor::ModelData> models;
-
-  for (auto& target : targets) {
-    models.push_back(generateCuboidData(target.pose.x,
-                                        target.pose.y,
-                                        target.pose.z, mModelDims));
-  }
-
-  models.push_back(generateCuboidData(newTarget.pose.x, newTarget.pose.y,
-                                      newTarget.pose.z, mModelDims));
-
-  mModelOcclusionProcessor->setModels(models, mProjectionMatrix);
-  const auto& resultSet =
-      mModelOcclusionProcessor->process(mFrameTextureContainer.getTexture());
-
+  vector<glipf::Target> probeTargets = targets;
+  probeTargets.push_back(newTarget);
+
+  // The candidate is only a probe, rendered by a processor of its own so
+  // that the occluders of the tracked targets stay in place for culling
+  // and the background update mask
+  mProbeOcclusionProcessor->setModels(generateTargetModels(probeTargets,
+                                                           mModelDims),
+                                      mProjectionMatrix);
+  const auto& resultSet = mProbeOcclusionProcessor->process(mFrameTexture);
   const auto& occlusionValues =
-      boost::get<vector<float>>(resultSet.at("model_occlusion"));
+      getNumbers(resultSet.at("model_occlusion"));
 
   bool result = occlusionValues.back() > mVisibilityThreshold;
   mTargetOcclusionMap[newTarget.id] = !result;
@@ -221,21 +452,32 @@ bool GlipfServerHandler::isVisible(const vector<glipf::Target>& targets,
 }
 
 
-void GlipfServerHandler::targetUpdate(const vector<glipf::Target>& targets) {
-  std::vector<GlesProcessor::ModelData> models;
+const ProcessingResultSet& GlipfServerHandler::renderOccluders(const vector<glipf::Target>& targets) {
+  mModelOcclusionProcessor->setModels(generateTargetModels(targets, mModelDims),
+                                      mProjectionMatrix);
+  const auto& resultSet =
+      mModelOcclusionProcessor->process(mFrameTexture);
+  setOccluderTargets(targets);
 
-  for (auto& target : targets) {
-    models.push_back(generateCuboidData(target.pose.x,
-                                        target.pose.y,
-                                        target.pose.z, mModelDims));
-  }
+  return resultSet;
+}
 
-  mModelOcclusionProcessor->setModels(models, mProjectionMatrix);
-  const auto& resultSet =
-      mModelOcclusionProcessor->process(mFrameTextureContainer.getTexture());
+
+void GlipfServerHandler::targetUpdate(const vector<glipf::Target>& targets) {
+  const auto& resultSet = renderOccluders(targets);
+  mLastTargets = targets;
+
+  // Keep the tracked targets from being blended into the background;
+  // without targets, the whole background learns again
+  if (targets.empty()) {
+    setBackgroundUpdateMask(0);
+  } else {
+    setBackgroundUpdateMask(
+        boost::get<GLuint>(resultSet.at("model_occlusion_texture")));
+  }
 
   const auto& occlusionValues =
-      boost::get<vector<float>>(resultSet.at("model_occlusion"));
+      getNumbers(resultSet.at("model_occlusion"));
 
   for (size_t i = 0; i < targets.size(); ++i) {
     if (occlusionValues[i] < mVisibilityThreshold) {
@@ -254,12 +496,12 @@ void GlipfServerHandler::targetUpdate(const vector<glipf::Target>& targets) {
       mForegroundHistogramProcessor->setModels(targetModels,
                                                mProjectionMatrix);
       const auto& resultSet =
-          mForegroundHistogramProcessor->process(mForegroundTexture);
+          mForegroundHistogramProcessor->process(
+              foregroundTextureFor(*mForegroundHistogramProcessor, true));
 
-      mTargetHistograms[targets[i].id] =
-          boost::get<vector<float>>(resultSet.at("0"));
+      mTargetHistograms[targets[i].id] = getNumbers(resultSet.at("0"));
       mTargetCoverage[targets[i].id] =
-          boost::get<vector<float>>(resultSet.at("histogram_coverage"))[0];
+          getNumbers(resultSet.at("histogram_coverage"))[0];
     }
   }
 }
@@ -283,21 +525,47 @@ double GlipfServerHandler::computeBhattDist(const vector<float>& refHist,
 }
 
 
+void GlipfServerHandler::setBackgroundUpdateMask(GLuint updateMaskTexture) {
+  mBackgroundSubtractionProcessor->setUpdateMask(updateMaskTexture);
+}
+
+
 void GlipfServerHandler::computeDistance(vector<double>& result,
                                          const vector<glipf::Particle>& particles)
 {
   std::vector<GlesProcessor::ModelData> models;
+  std::vector<int> ownOccluderIndices;
+  std::vector<size_t> levelsOfDetail;
 
   for (auto& particle : particles) {
     models.push_back(generateCuboidData(particle.pose.x, particle.pose.y,
                                         particle.pose.z, mModelDims));
+
+    // A particle is never hidden by the target it's a hypothesis of
+    auto occluderIndexIter = mTargetOccluderIndices.find(particle.id);
+    ownOccluderIndices.push_back(
+        occluderIndexIter != mTargetOccluderIndices.end()
+            ? occluderIndexIter->second : -1);
+
+    // Clients may ask for low-priority particles to be sampled sparsely
+    int lod = particle.__isset.lod ? particle.lod : 0;
+    lod = std::min(lod, int(ForegroundHistogramProcessor::kMaxLevelOfDetail));
+    levelsOfDetail.push_back(std::max(lod, 0));
   }
 
-  mForegroundHistogramProcessor->setModels(models, mProjectionMatrix);
-  const auto& resultSet = mForegroundHistogramProcessor->process(mForegroundTexture);
+  // Particles hidden behind other targets only get histograms of their
+  // visible pixels, and none at all if hidden entirely
+  if (mIsOcclusionCullingEnabled)
+    mForegroundHistogramProcessor->setOccluders(mModelOcclusionProcessor.get());
+
+  mForegroundHistogramProcessor->setModels(models, mProjectionMatrix,
+                                           ownOccluderIndices, levelsOfDetail);
+  const auto& resultSet = mForegroundHistogramProcessor->process(
+      foregroundTextureFor(*mForegroundHistogramProcessor, true));
+  mForegroundHistogramProcessor->setOccluders(nullptr);
   size_t i = 0;
   const auto& histogramCoverage =
-      boost::get<vector<float>>(resultSet.at("histogram_coverage"));
+      getNumbers(resultSet.at("histogram_coverage"));
 
   for (auto& particle : particles) {
     if (!mTargetHistograms.count(particle.id) || mTargetOcclusionMap[particle.id]) {
@@ -308,7 +576,7 @@ void GlipfServerHandler::computeDistance(vector<double>& result,
 
     auto histKey = std::to_string(i);
     auto& refHist = mTargetHistograms.at(particle.id);
-    auto& hist = boost::get<vector<float>>(resultSet.at(histKey));
+    auto& hist = getNumbers(resultSet.at(histKey));
     auto bhattDist = computeBhattDist(refHist, hist);
 
     float coverageDiffPercentage = std::abs(
@@ -347,8 +615,26 @@ void GlipfServerHandler::drawDebugOutput(const vector<glipf::Target>& targets,
 
   mModelDebugProcessor->setModels(models, modelGroups);
   const auto& resultSet =
-      mModelDebugProcessor->process(mFrameTextureContainer.getTexture());
+      mModelDebugProcessor->process(frameTexture());
 
   mDisplaySink->send(resultSet);
   mGlesContext.swapBuffers();
 }
+
+
+void GlipfServerHandler::getStageTimings(std::map<std::string, glipf::StageTiming>& result) {
+  const auto& histograms =
+      glipf::utils::Profiler::defaultProfiler().histograms();
+
+  for (const auto& stageHistogram : histograms) {
+    const auto& histogram = stageHistogram.second;
+    glipf::StageTiming& timing = result[stageHistogram.first];
+
+    timing.count = histogram.count();
+    timing.meanDuration = histogram.meanDuration();
+    timing.minDuration = histogram.minDuration();
+    timing.maxDuration = histogram.maxDuration();
+    timing.histogram.assign(std::begin(histogram.buckets()),
+                            std::end(histogram.buckets()));
+  }
+}
@@ -8,10 +8,17 @@
 #include <glipf/processors/background-subtraction-processor.h>
 #include <glipf/processors/foreground-coverage-processor.h>
 #include <glipf/processors/foreground-histogram-processor.h>
+#include <glipf/processors/frame-pyramid-processor.h>
+#include <glipf/processors/fused-processor.h>
 #include <glipf/processors/model-occlusion-processor.h>
 #include <glipf/processors/model-debug-processor.h>
+#include <glipf/processors/mog-bg-sub-processor.h>
+#include <glipf/processors/morphology-processor.h>
+#include <glipf/processors/undistortion-processor.h>
 #include <glipf/sinks/display-sink.h>
 #include <glipf/sources/frame-source.h>
+#include <glipf/utils/roi-scheduler.h>
+#include <glipf/utils/server-config.h>
 
 #include <glm/glm.hpp>
 
@@ -20,9 +27,40 @@
 
 class GlipfServerHandler : public glipf::GlipfServerIf {
 public:
+  enum class BackgroundModel {
+    kReferenceFrame,
+    kMixtureOfGaussians
+  };
+
+  struct BackgroundModelConfig {
+    BackgroundModel model;
+    float adaptationRate;
+    size_t gaussianCount;
+    size_t historyLength;
+    float backgroundRatio;
+    bool hasHsvOutput;
+  };
+
+  using MorphologyConfig = glipf::utils::MorphologyConfig;
+
+  struct UndistortionConfig {
+    bool isEnabled;
+    glm::vec2 focalLength;
+    glm::vec2 principalPoint;
+    std::vector<float> coefficients;
+  };
+
   GlipfServerHandler(std::unique_ptr<glipf::sources::FrameSource> frameSource,
-                     const glm::mat4& mvpMatrix, float visibilityThreshold);
-  void initForegroundCoverageProcessor(const std::vector<glipf::Point3d>& modelCenters,
+                     const glm::mat4& mvpMatrix, float visibilityThreshold,
+                     const BackgroundModelConfig& backgroundModelConfig,
+                     const MorphologyConfig& morphologyConfig,
+                     const UndistortionConfig& undistortionConfig,
+                     size_t framePyramidLevelCount,
+                     bool isOcclusionCullingEnabled,
+                     bool isRoiSchedulingEnabled,
+                     float processingQuality);
+  void initForegroundCoverageProcessor(std::vector<int32_t>& result,
+                                       const std::vector<glipf::Point3d>& modelCenters,
                                        const glipf::Dims& modelDims) override;
   void scanForeground(std::vector<double>& result) override;
   void initTarget(const glipf::Target& targetData,
@@ -34,30 +72,61 @@ public:
                        const std::vector<glipf::Particle>& particles) override;
   void drawDebugOutput(const std::vector<glipf::Target>& targets,
                        const bool drawParticles) override;
-  void grabFrame() override;
+  void grabFrame(const bool isScanFrame) override;
+  void getStageTimings(std::map<std::string, glipf::StageTiming>& result) override;
 
 private:
   double computeBhattDist(const std::vector<float>& refHist,
                           const std::vector<float>& hist);
+  void setBackgroundUpdateMask(GLuint updateMaskTexture);
+  GLuint foregroundTextureFor(const glipf::processors::GlesProcessor& processor,
+                              bool isHsv = false) const;
+  void setOccluderTargets(const std::vector<glipf::Target>& targets);
+  /// Render targets as the occluders of the following histogram passes.
+  const glipf::processors::ProcessingResultSet& renderOccluders(const std::vector<glipf::Target>& targets);
+  void scheduleRegionsOfInterest(bool isScanFrame);
+  void uploadFrame(const void* frameData);
+  GLuint frameTexture();
 
   glipf::gles_utils::GlesContext mGlesContext;
   glm::mat4 mProjectionMatrix;
   std::unique_ptr<glipf::sources::FrameSource> mFrameSource;
   float mVisibilityThreshold;
+  BackgroundModelConfig mBackgroundModelConfig;
+  MorphologyConfig mMorphologyConfig;
+  size_t mFramePyramidLevelCount;
+  bool mIsOcclusionCullingEnabled;
+  bool mIsRoiSchedulingEnabled;
+  float mProcessingQuality;
+  glipf::utils::RoiScheduler mRoiScheduler;
+  std::vector<glipf::utils::RegionOfInterest> mDetectionRegions;
+  std::unique_ptr<glipf::processors::UndistortionProcessor> mUndistortionProcessor;
   std::unique_ptr<glipf::processors::ModelOcclusionProcessor> mModelOcclusionProcessor;
+  /// Renders the candidates of visibility checks
+  std::unique_ptr<glipf::processors::ModelOcclusionProcessor> mProbeOcclusionProcessor;
   std::unique_ptr<glipf::processors::ModelDebugProcessor> mModelDebugProcessor;
   std::unique_ptr<glipf::processors::ForegroundCoverageProcessor> mForegroundCoverageProcessor;
   std::unique_ptr<glipf::processors::ForegroundHistogramProcessor> mForegroundHistogramProcessor;
-  std::unique_ptr<glipf::processors::BackgroundSubtractionProcessor> mBackgroundSubtractionProcessor;
+  std::unique_ptr<glipf::processors::GlesProcessor> mBackgroundSubtractionProcessor;
+  /// Undistortion and background subtraction as a single pass, if both
+  /// can be fused
+  std::unique_ptr<glipf::processors::FusedProcessor> mFusedForegroundProcessor;
+  std::unique_ptr<glipf::processors::MorphologyProcessor> mMorphologyProcessor;
+  std::unique_ptr<glipf::processors::FramePyramidProcessor> mFramePyramidProcessor;
   std::unique_ptr<glipf::sinks::DisplaySink> mDisplaySink;
   glipf::Dims mModelDims;
   glipf::gles_utils::TextureContainer mFrameTextureContainer;
+  /// Last uploaded frame, undistorted if enabled and mIsFrameUndistorted
+  GLuint mFrameTexture;
+  bool mIsFrameUndistorted;
   GLuint mForegroundTexture;
   size_t mLastFrameNumber;
   std::map<int32_t, std::vector<float>> mTargetHistograms;
   std::map<int32_t, bool> mTargetOcclusionMap;
   std::map<int32_t, float> mTargetCoverage;
+  std::map<int32_t, int> mTargetOccluderIndices;
   std::vector<glipf::Particle> mLastParticles;
+  std::vector<glipf::Target> mLastTargets;
 };
 
 #endif // glipf_server_handler_h